@@ -0,0 +1,381 @@
+// core cpp library
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <sstream>
+
+// dependencies
+#include <tclap/CmdLine.h>
+
+// the class we want to measure, and the machine it talks to
+#include "AModeUSConnection.h"
+#include "AModeSimulator.h"
+#include "ConnectionManager.h"
+
+// function for parsing arguments
+void commandLineOptions(const int& argc, char** argv,
+						std::string& port, int& amodemode, int& amodesamples, int& amodeprobes,
+						double& framerate, long& framecount, std::string& outputdir, int& queuepolicy, int& recordformat, int& compressthreads, long& skipevery, std::string& statsfile, int& devices, int& loops, int& subscribers, std::string& sharedname, bool& envelope, int& depththreads, double& restart, int& latencyprofile, std::string& cores, int& priority,
+						std::string& roiprobes, std::string& roifirst, int& roilength, int& decimation, double& pretrigger, double& triggerafter, double& stopafter, int& tiffthreads) {
+
+	// see TCLAP (Templatized C++ Command Line Parser Manual) documentation
+	// can be found in: http://tclap.sourceforge.net/manual.html
+	try {
+		TCLAP::CmdLine cmd("Streams from the A-mode simulator over loopback and measures AModeUSConnection", ' ', "1.0");
+
+		TCLAP::ValueArg<std::string> nameargPort("", "port", "Loopback port used between simulator and connection", false, "6340", "string");
+		TCLAP::ValueArg<int> nameargAModeMode("m", "mode", "A-Mode data mode. Specify 0 for raw, 1 for depth.", false, 0, "int");
+		TCLAP::ValueArg<int> nameargAModeSamples("n", "samples", "Number of samples of A-Mode Signal (raw only).", false, 1500, "int");
+		TCLAP::ValueArg<int> nameargAModeProbes("p", "probes", "Number of probes of A-Mode Signal (raw only).", false, 30, "int");
+		TCLAP::ValueArg<double> nameargFrameRate("r", "rate", "Frames per second, 0 means as fast as possible.", false, 0.0, "double");
+		TCLAP::ValueArg<long> nameargFrameCount("c", "count", "Number of frames to stream.", false, 20000, "long");
+		TCLAP::ValueArg<std::string> nameargOutputdir("o", "outputdir", "Record to this directory, nothing is recorded if empty.", false, "", "string");
+		TCLAP::ValueArg<int> nameargRecordFormat("f", "format", "Record format, 0 binary .amode, 1 tiff (raw), 2 csv (depth), 3 columns .amodedepth (depth), -1 default of the mode.", false, -1, "int");
+		TCLAP::ValueArg<int> nameargCompress("z", "compress", "Threads compressing the raw frames, 0 for no compression.", false, 0, "int");
+		TCLAP::ValueArg<std::string> nameargStats("t", "stats", "File for the latency statistics (needs AMODE_ENABLE_STATS), one json line per second.", false, "", "string");
+		TCLAP::ValueArg<long> nameargSkip("s", "skip", "The simulator skips one index after every this many frames, 0 never.", false, 0, "long");
+		TCLAP::ValueArg<int> nameargDevices("d", "devices", "Number of simulated machines, on port, port+1, ...", false, 1, "int");
+		TCLAP::ValueArg<int> nameargLoops("l", "loops", "Event loops of the ConnectionManager, 0 for one thread per connection.", false, 0, "int");
+		TCLAP::ValueArg<int> nameargSubscribers("u", "subscribers", "Subscribers per connection, each sums the values of every frame in its own thread.", false, 0, "int");
+		TCLAP::SwitchArg nameargEnvelope("e", "envelope", "Compute the envelope of every raw frame while streaming, for one more subscriber.", false);
+		TCLAP::ValueArg<int> nameargDepth("x", "depth", "Estimate the depths of the raw frames while streaming with this many threads, 0 for none.", false, 0, "int");
+		TCLAP::ValueArg<std::string> nameargShared("k", "shared", "Publish the frames in a shared memory ring with this name (device d gets <name>d).", false, "", "string");
+		TCLAP::ValueArg<double> nameargRestart("a", "restart", "Switch the simulators off halfway and on again after this many milliseconds, the connections reconnect. 0 never.", false, 0.0, "double");
+		TCLAP::ValueArg<int> nameargLatency("y", "latency", "Receive profile, 0 default, 1 low latency (receive buffer, TCP_NODELAY, TCP_QUICKACK), 2 low latency with busy polling.", false, 0, "int");
+		TCLAP::ValueArg<std::string> nameargCores("", "cores", "Pin the threads, <receive core>,<writer core> (device d receives on core + d), empty for no pinning.", false, "", "string");
+		TCLAP::ValueArg<int> nameargPriority("", "fifo", "Run the receiving and the writer thread with this SCHED_FIFO priority, 0 normal scheduling.", false, 0, "int");
+		TCLAP::ValueArg<std::string> nameargRoiProbes("", "roiprobes", "Keep only these probes of the raw frames, e.g. 0-9,12 (region of interest).", false, "", "string");
+		TCLAP::ValueArg<std::string> nameargRoiFirst("", "roifirst", "First sample of the window, one for all probes or one per kept probe, e.g. 300 or 300,310,...", false, "", "string");
+		TCLAP::ValueArg<int> nameargRoiLength("", "roilength", "Samples of the window, -1 up to the end of the line.", false, -1, "int");
+		TCLAP::ValueArg<int> nameargDecimation("", "decimate", "Keep every n-th sample of the window, after the anti-alias filter.", false, 1, "int");
+		TCLAP::ValueArg<double> nameargPreTrigger("", "pretrigger", "Record only from this many seconds before the trigger on (event recording), 0 records everything.", false, 0.0, "double");
+		TCLAP::ValueArg<double> nameargTrigger("", "trigger", "Trigger the event recording this many milliseconds after the streaming started.", false, 0.0, "double");
+		TCLAP::ValueArg<double> nameargStop("", "stop", "Stop the connections from another thread after this many milliseconds, 0 never.", false, 0.0, "double");
+		TCLAP::ValueArg<int> nameargTiffThreads("", "tiffthreads", "Threads writing the .tiff files (format 1), 0 only the writer thread.", false, 0, "int");
+		TCLAP::ValueArg<int> nameargQueuePolicy("q", "queuepolicy", "Recorder queue policy, 0 block, 1 drop oldest, 2 drop newest.", false, QUEUE_BLOCK, "int");
+
+		cmd.add(nameargPort);
+		cmd.add(nameargAModeMode);
+		cmd.add(nameargAModeSamples);
+		cmd.add(nameargAModeProbes);
+		cmd.add(nameargFrameRate);
+		cmd.add(nameargFrameCount);
+		cmd.add(nameargOutputdir);
+		cmd.add(nameargQueuePolicy);
+		cmd.add(nameargRecordFormat);
+		cmd.add(nameargCompress);
+		cmd.add(nameargSkip);
+		cmd.add(nameargStats);
+		cmd.add(nameargDevices);
+		cmd.add(nameargLoops);
+		cmd.add(nameargSubscribers);
+		cmd.add(nameargShared);
+		cmd.add(nameargEnvelope);
+		cmd.add(nameargDepth);
+		cmd.add(nameargRestart);
+		cmd.add(nameargLatency);
+		cmd.add(nameargCores);
+		cmd.add(nameargPriority);
+		cmd.add(nameargRoiProbes);
+		cmd.add(nameargRoiFirst);
+		cmd.add(nameargRoiLength);
+		cmd.add(nameargDecimation);
+		cmd.add(nameargPreTrigger);
+		cmd.add(nameargTrigger);
+		cmd.add(nameargStop);
+		cmd.add(nameargTiffThreads);
+
+		cmd.parse(argc, argv);
+
+		port = nameargPort.getValue();
+		amodemode = nameargAModeMode.getValue();
+		amodesamples = nameargAModeSamples.getValue();
+		amodeprobes = nameargAModeProbes.getValue();
+		framerate = nameargFrameRate.getValue();
+		framecount = nameargFrameCount.getValue();
+		outputdir = nameargOutputdir.getValue();
+		queuepolicy = nameargQueuePolicy.getValue();
+		recordformat = nameargRecordFormat.getValue();
+		compressthreads = nameargCompress.getValue();
+		skipevery = nameargSkip.getValue();
+		statsfile = nameargStats.getValue();
+		devices = nameargDevices.getValue();
+		loops = nameargLoops.getValue();
+		subscribers = nameargSubscribers.getValue();
+		sharedname = nameargShared.getValue();
+		envelope = nameargEnvelope.getValue();
+		depththreads = nameargDepth.getValue();
+		restart = nameargRestart.getValue();
+		latencyprofile = nameargLatency.getValue();
+		cores = nameargCores.getValue();
+		priority = nameargPriority.getValue();
+		roiprobes = nameargRoiProbes.getValue();
+		roifirst = nameargRoiFirst.getValue();
+		roilength = nameargRoiLength.getValue();
+		decimation = nameargDecimation.getValue();
+		pretrigger = nameargPreTrigger.getValue();
+		triggerafter = nameargTrigger.getValue();
+		stopafter = nameargStop.getValue();
+		tiffthreads = nameargTiffThreads.getValue();
+	}
+	catch (TCLAP::ArgException& e)  // catch exceptions
+	{
+		std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
+	}
+
+}
+
+// a list of numbers with ranges, "0-3,7" is 0,1,2,3,7
+std::vector<int> parseList(const std::string& text) {
+	std::vector<int> values;
+	std::stringstream stream(text);
+	std::string item;
+	while (std::getline(stream, item, ',')) {
+		int first = 0;
+		int last = 0;
+		int fields = sscanf(item.c_str(), "%d-%d", &first, &last);
+		if (fields < 1) continue;
+		if (fields == 1) last = first;
+		for (int v = first; v <= last; v++) values.push_back(v);
+	}
+	return values;
+}
+
+int main(int argc, char** argv)
+{
+	std::string port = "6340";
+	int amodemode = 0;
+	int amodesamples = 1500;
+	int amodeprobes = 30;
+	double framerate = 0.0;
+	long framecount = 20000;
+	std::string outputdir = "";
+	int queuepolicy = QUEUE_BLOCK;
+	int recordformat = -1;
+	int compressthreads = 0;
+	long skipevery = 0;
+	std::string statsfile;
+	int devices = 1;
+	int loops = 0;
+	int subscribers = 0;
+	std::string sharedname;
+	bool envelope = false;
+	int depththreads = 0;
+	double restart = 0.0;
+	int latencyprofile = 0;
+	std::string cores;
+	int priority = 0;
+	std::string roiprobes;
+	std::string roifirst;
+	int roilength = -1;
+	int decimation = 1;
+	double pretrigger = 0.0;
+	double triggerafter = 0.0;
+	double stopafter = 0.0;
+	int tiffthreads = 0;
+
+	commandLineOptions(argc, argv, port, amodemode, amodesamples, amodeprobes, framerate, framecount, outputdir, queuepolicy, recordformat, compressthreads, skipevery, statsfile, devices, loops, subscribers, sharedname, envelope, depththreads, restart, latencyprofile, cores, priority, roiprobes, roifirst, roilength, decimation, pretrigger, triggerafter, stopafter, tiffthreads);
+	bool roi = !roiprobes.empty() || !roifirst.empty() || roilength > 0 || decimation > 1;
+	int receivecore = -1;
+	int writercore = -1;
+	if (!cores.empty()) sscanf(cores.c_str(), "%d,%d", &receivecore, &writercore);
+	if (amodemode == DATA_DEPTH) {
+		amodesamples = 2;
+		amodeprobes = 30;
+	}
+	if (devices < 1) devices = 1;
+	if (stopafter > 0.0 && loops > 0) {
+		std::cout << "the event loops are stopped by the manager, --stop is ignored\n";
+		stopafter = 0.0;
+	}
+	if (restart > 0.0 && loops > 0) {
+		std::cout << "the event loops don't reconnect, the simulators are not restarted\n";
+		restart = 0.0;
+	}
+
+	// the simulators have to listen before the connections are constructed, since they connect in the constructor
+	std::vector<AModeSimulator*> simulators;
+	std::vector<std::thread> threadSimulators;
+	std::vector<long> sentbefore(devices, 0);
+	std::vector<std::chrono::steady_clock::time_point> finished(devices);
+	for (int d = 0; d < devices; d++) {
+		AModeSimulator* simulator = new AModeSimulator(std::to_string(std::stoi(port) + d), amodesamples, amodeprobes, amodemode);
+		simulator->setFrameRate(framerate);
+		simulator->setFrameCount(restart > 0.0 ? framecount / 2 : framecount);
+		simulator->setIndexSkip(skipevery);
+		if (simulator->listenTCP() != 0) return -1;
+		simulators.push_back(simulator);
+
+		// switched off halfway, the machine keeps counting while it is off, then it streams the other half
+		threadSimulators.push_back(std::thread([simulator, restart, framerate, framecount, &sentbefore, &finished, d] {
+			(*simulator)();
+			finished[d] = std::chrono::steady_clock::now();
+			if (restart <= 0.0) return;
+			sentbefore[d] = simulator->getFrameSent();
+			simulator->closeTCP();
+			std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(restart));
+			simulator->advanceIndex((long)(restart * 1e-3 * framerate));
+			simulator->setFrameCount(framecount - framecount / 2);
+			if (simulator->listenTCP() == 0) (*simulator)();
+			finished[d] = std::chrono::steady_clock::now();
+			simulator->closeTCP();
+		}));
+	}
+
+	// same configuration as main.cpp, recording only if an output directory is given
+	std::vector<AModeUSConnection*> connections;
+	for (int d = 0; d < devices; d++) {
+		AModeUSConnection* amodeUSConnection;
+		std::string deviceport = std::to_string(std::stoi(port) + d);
+		if (amodemode == DATA_DEPTH) amodeUSConnection = new AModeUSConnection("127.0.0.1", deviceport, DATA_DEPTH);
+		else amodeUSConnection = new AModeUSConnection("127.0.0.1", deviceport, amodesamples, amodeprobes);
+		amodeUSConnection->useDataIndex(true);
+		if (latencyprofile > 0) amodeUSConnection->setLowLatency(latencyprofile == 2);
+		if (roi && amodeUSConnection->setRegionOfInterest(parseList(roiprobes), parseList(roifirst), roilength, decimation) != 0) return -1;
+		if (receivecore >= 0 || writercore >= 0 || priority > 0) amodeUSConnection->setThreads(receivecore >= 0 ? receivecore + d : -1, writercore, priority);
+		if (restart > 0.0) {
+			// until a bit after the simulator is back, afterwards the end of the stream ends the connection
+			amodeUSConnection->setConnectTimeout(1.0, 1.0);
+			amodeUSConnection->setReconnect(restart * 1e-3 + 1.0);
+		}
+		amodeUSConnection->setRecord(!outputdir.empty());
+		if (!statsfile.empty()) amodeUSConnection->setStatsOutput(statsfile, 1.0);
+		if (!sharedname.empty()) amodeUSConnection->setSharedRing(devices > 1 ? sharedname + std::to_string(d) : sharedname);
+		if (!outputdir.empty()) {
+			amodeUSConnection->setRecordQueue(256, queuepolicy);
+			if (recordformat >= 0) amodeUSConnection->setRecordFormat(recordformat);
+			amodeUSConnection->setRecordCompression(compressthreads);
+			amodeUSConnection->setRecordTiffThreads(tiffthreads);
+			amodeUSConnection->setDirectory(outputdir);
+			if (pretrigger > 0.0) amodeUSConnection->setPreTrigger(pretrigger, framerate > 0.0 ? framerate : 1000.0);
+		}
+
+		// live processing next to the recording, a sum stands for whatever would be computed
+		for (int u = 0; u < subscribers; u++) {
+			amodeUSConnection->subscribe([](const FrameSlot& frame) {
+				volatile uint64_t sum = 0;
+				const uint16_t* values = (const uint16_t*)frame.data;
+				for (size_t i = 0; i < frame.datasize / sizeof(uint16_t); i++) sum = sum + values[i];
+			});
+		}
+
+		// the envelope frames, looking for the brightest sample stands for the tracking of the bone
+		if (envelope && amodemode == DATA_RAW) {
+			amodeUSConnection->subscribeEnvelope([](const FrameSlot& frame) {
+				volatile uint16_t brightest = 0;
+				const uint16_t* values = (const uint16_t*)frame.data;
+				for (size_t i = 0; i < frame.datasize / sizeof(uint16_t); i++) if (values[i] > brightest) brightest = values[i];
+			});
+		}
+
+		// the depths of the raw frames, within one frame of the simulator (1 ms at 1000 frames/s)
+		if (depththreads > 0 && amodemode == DATA_RAW) {
+			amodeUSConnection->setDepthEstimation(100, -1, -40.0);
+			amodeUSConnection->setDepthThreads(depththreads, 1000.0);
+			amodeUSConnection->subscribeDepth([](const FrameSlot& frame) {
+				volatile double deepest = 0.0;
+				const double* values = (const double*)frame.data;
+				for (size_t i = 0; i < frame.datasize / sizeof(double); i += DEPTH_VALUES) if (values[i] > deepest) deepest = values[i];
+			});
+		}
+		connections.push_back(amodeUSConnection);
+	}
+
+	// the connections return when the simulators close them after framecount frames,
+	// either every connection in its own thread, or all of them in the event loops of the manager
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	// the event, for every connection at the same time
+	std::thread threadTrigger;
+	if (pretrigger > 0.0 && triggerafter > 0.0) {
+		threadTrigger = std::thread([&connections, triggerafter] {
+			std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(triggerafter));
+			for (AModeUSConnection* connection : connections) connection->trigger();
+		});
+	}
+
+	// like ctrl+c in main.cpp, the connections are in recv() and maybe nothing comes
+	std::thread threadStop;
+	std::chrono::steady_clock::time_point stopped;
+	if (stopafter > 0.0) {
+		threadStop = std::thread([&connections, &stopped, stopafter] {
+			std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(stopafter));
+			stopped = std::chrono::steady_clock::now();
+			for (AModeUSConnection* connection : connections) connection->stop();
+		});
+	}
+
+	if (loops > 0) {
+		ConnectionManager manager(loops);
+		for (AModeUSConnection* connection : connections) manager.add(connection);
+		manager();
+		std::cout << "event loops    : " << loops << " for " << devices << " devices, " << manager.getWakeupCount() << " wakeups\n";
+	}
+	else {
+		std::vector<std::thread> threadConnections;
+		for (AModeUSConnection* connection : connections) threadConnections.push_back(std::thread(std::ref(*connection)));
+		for (std::thread& thread : threadConnections) thread.join();
+	}
+	std::chrono::steady_clock::time_point joined = std::chrono::steady_clock::now();
+	if (threadStop.joinable()) {
+		threadStop.join();
+
+		// the simulators are still sending, nobody reads anymore
+		for (AModeSimulator* simulator : simulators) simulator->stop();
+	}
+	for (std::thread& thread : threadSimulators) thread.join();
+	if (threadTrigger.joinable()) threadTrigger.join();
+	std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+
+	// the connections try a while longer after the simulators are off for good, that is not streaming
+	if (restart > 0.0) stop = *std::max_element(finished.begin(), finished.end());
+
+	double elapsed = std::chrono::duration<double>(stop - start).count();
+	long sent = 0;
+	long received = 0;
+	long resyncs = 0;
+	long missing = 0;
+	long gaps = 0;
+	long reconnects = 0;
+	double firstframe = 0.0;
+	for (int d = 0; d < devices; d++) {
+		sent += sentbefore[d] + simulators[d]->getFrameSent();
+		reconnects += connections[d]->getReconnectCount();
+		firstframe = std::max(firstframe, connections[d]->getReconnectTime());
+		received += connections[d]->getFrameCount();
+		resyncs += connections[d]->getResyncCount();
+		missing += connections[d]->getIndexTracker()->getMissingCount();
+		gaps += connections[d]->getIndexTracker()->getGapCount();
+	}
+	double megabytes = (double)received * simulators[0]->getPacketSize() / 1e6;
+
+	std::cout << "\n==== A-mode loopback benchmark ====\n"
+		<< "mode           : " << (amodemode == DATA_DEPTH ? "DATA_DEPTH" : "DATA_RAW") << "\n"
+		<< "geometry       : " << amodeprobes << " probes x " << amodesamples << " samples\n"
+		<< "devices        : " << devices << (loops > 0 ? " (event loops)" : " (thread per device)") << "\n"
+		<< "target rate    : " << (framerate > 0.0 ? std::to_string(framerate) : std::string("unlimited")) << " per device\n"
+		<< "frames sent    : " << sent << "\n"
+		<< "frames received: " << received << "\n"
+		<< "frames dropped : " << sent - received << "\n"
+		<< "resyncs        : " << resyncs << "\n"
+		<< "index missing  : " << missing << " in " << gaps << " gaps\n"
+		<< "elapsed (s)    : " << elapsed << "\n"
+		<< "frames/s       : " << received / elapsed << "\n"
+		<< "MB/s           : " << megabytes / elapsed << "\n";
+	if (stopafter > 0.0) {
+		std::cout << "stop           : " << std::chrono::duration<double, std::milli>(joined - stopped).count() << " ms until the connections returned\n";
+	}
+	if (restart > 0.0) {
+		std::cout << "reconnects     : " << reconnects << " (simulators off for " << restart << " ms)\n"
+			<< "first frame    : " << 1e3 * firstframe << " ms after the loss (worst device)\n";
+	}
+
+	for (int d = 0; d < devices; d++) {
+		delete connections[d];
+		delete simulators[d];
+	}
+	return 0;
+}
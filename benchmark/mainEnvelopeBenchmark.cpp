@@ -0,0 +1,162 @@
+// core cpp library
+#define _USE_MATH_DEFINES
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <random>
+#include <math.h>
+#include <stdlib.h>
+
+// dependencies
+#include <tclap/CmdLine.h>
+
+// the kernels we want to measure
+#include "EnvelopeDetector.h"
+#include "DepthEstimator.h"
+
+// function for parsing arguments
+void commandLineOptions(const int& argc, char** argv, int& amodesamples, int& amodeprobes, long& framecount, int& taps, int& depththreads) {
+
+	// see TCLAP (Templatized C++ Command Line Parser Manual) documentation
+	// can be found in: http://tclap.sourceforge.net/manual.html
+	try {
+		TCLAP::CmdLine cmd("Measures the envelope detection of raw A-mode frames, AVX2 against the scalar reference", ' ', "1.0");
+
+		TCLAP::ValueArg<int> nameargAModeSamples("n", "samples", "Number of samples of A-Mode Signal.", false, 1500, "int");
+		TCLAP::ValueArg<int> nameargAModeProbes("p", "probes", "Number of probes of A-Mode Signal.", false, 30, "int");
+		TCLAP::ValueArg<long> nameargFrameCount("c", "count", "Number of frames for every implementation.", false, 2000, "long");
+		TCLAP::ValueArg<int> nameargTaps("t", "taps", "Length of the filters.", false, 31, "int");
+		TCLAP::ValueArg<int> nameargDepth("x", "depth", "Also measure the depth estimation with 1 to this many threads.", false, 1, "int");
+
+		cmd.add(nameargAModeSamples);
+		cmd.add(nameargAModeProbes);
+		cmd.add(nameargFrameCount);
+		cmd.add(nameargTaps);
+		cmd.add(nameargDepth);
+
+		cmd.parse(argc, argv);
+
+		amodesamples = nameargAModeSamples.getValue();
+		amodeprobes = nameargAModeProbes.getValue();
+		framecount = nameargFrameCount.getValue();
+		taps = nameargTaps.getValue();
+		depththreads = nameargDepth.getValue();
+	}
+	catch (TCLAP::ArgException& e)  // catch exceptions
+	{
+		std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
+	}
+
+}
+
+// runs the detector over the frames again and again, returns microseconds per frame
+double measure(EnvelopeDetector& detector, const std::vector<std::vector<uint16_t>>& frames, std::vector<uint16_t>& envelope, long framecount) {
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (long f = 0; f < framecount; f++) detector.process(frames[f % frames.size()].data(), envelope.data());
+	std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+
+	return std::chrono::duration<double, std::micro>(stop - start).count() / framecount;
+}
+
+int main(int argc, char** argv)
+{
+	int amodesamples = 1500;
+	int amodeprobes = 30;
+	long framecount = 2000;
+	int taps = 31;
+	int depththreads = 1;
+
+	commandLineOptions(argc, argv, amodesamples, amodeprobes, framecount, taps, depththreads);
+
+	// the same frames as the simulator sends, an echo in every probe line on top of noise
+	std::mt19937 rng(1);
+	std::normal_distribution<double> noise(0.0, 20.0);
+	std::vector<std::vector<uint16_t>> frames(16, std::vector<uint16_t>((size_t)amodesamples * amodeprobes));
+	std::vector<double> echoes;
+	for (size_t f = 0; f < frames.size(); f++) {
+		for (int p = 0; p < amodeprobes; p++) {
+			double center = (0.35 + 0.1 * p / amodeprobes + 0.05 * sin(0.1 * f + p)) * amodesamples;
+			double width = amodesamples / 150.0 + 1.0;
+			if (f == 0) echoes.push_back(center);
+			for (int s = 0; s < amodesamples; s++) {
+				double d = (s - center) / width;
+				double value = 2048.0 + 1500.0 * exp(-d * d) * sin(2.0 * M_PI * 0.12 * s) + noise(rng);
+				frames[f][(size_t)p * amodesamples + s] = (uint16_t)(value < 0.0 ? 0.0 : (value > 4095.0 ? 4095.0 : value));
+			}
+		}
+	}
+
+	EnvelopeDetector detector(amodesamples, amodeprobes);
+	detector.setFilter(0.12, 0.08, taps);
+	std::vector<uint16_t> reference((size_t)amodesamples * amodeprobes);
+	std::vector<uint16_t> envelope((size_t)amodesamples * amodeprobes);
+
+	// the reference first, it is also the result the others are compared with
+	detector.setImplementation(ENVELOPE_SCALAR);
+	double scalartime = measure(detector, frames, envelope, framecount);
+	detector.process(frames[0].data(), reference.data());
+
+	// the echo has to be the brightest part of the envelope, a few samples off is the width of the burst
+	int maxoffset = 0;
+	for (int p = 0; p < amodeprobes; p++) {
+		int brightest = 0;
+		for (int s = 1; s < amodesamples; s++) {
+			if (reference[(size_t)p * amodesamples + s] > reference[(size_t)p * amodesamples + brightest]) brightest = s;
+		}
+		if (abs(brightest - (int)(echoes[p] + 0.5)) > maxoffset) maxoffset = abs(brightest - (int)(echoes[p] + 0.5));
+	}
+
+	std::cout << "\n==== A-mode envelope benchmark ====\n"
+		<< "geometry       : " << amodeprobes << " probes x " << amodesamples << " samples, " << detector.getTaps() << " taps\n"
+		<< "echo offset    : " << maxoffset << " samples at most\n"
+		<< "scalar         : " << scalartime << " us/frame (" << 1e6 / scalartime << " frames/s)\n";
+
+	if (detector.setImplementation(ENVELOPE_AVX2) != 0) {
+		std::cout << "avx2           : not available on this CPU\n";
+	}
+	else {
+		double avx2time = measure(detector, frames, envelope, framecount);
+		detector.process(frames[0].data(), envelope.data());
+		int maxdifference = 0;
+		for (size_t i = 0; i < envelope.size(); i++) {
+			int difference = abs((int)envelope[i] - (int)reference[i]);
+			if (difference > maxdifference) maxdifference = difference;
+		}
+
+		std::cout << "avx2           : " << avx2time << " us/frame (" << 1e6 / avx2time << " frames/s)\n"
+			<< "speedup        : " << scalartime / avx2time << "\n"
+			<< "max difference : " << maxdifference << " of 65535\n";
+	}
+
+	// the depths, the error against the center of the simulated echo and the time with more and more threads
+	std::vector<double> depth((size_t)amodeprobes * DEPTH_VALUES);
+	for (int threads = 1; threads <= depththreads; threads++) {
+		DepthEstimator estimator(amodesamples, amodeprobes, threads);
+		estimator.setEnvelope(0.12, 0.08, 60.0);
+		estimator.setWindow(100, amodesamples - 1);
+
+		estimator.estimate(frames[0].data(), depth.data());
+		double maxerror = 0.0;
+		for (int p = 0; p < amodeprobes; p++) {
+			double error = fabs(depth[(size_t)p * DEPTH_VALUES] - echoes[p]);
+			if (depth[(size_t)p * DEPTH_VALUES] == DEPTH_NOECHO) error = amodesamples;
+			if (error > maxerror) maxerror = error;
+		}
+
+		double maxtime = 0.0;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (long f = 0; f < framecount; f++) {
+			std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+			estimator.estimate(frames[f % frames.size()].data(), depth.data());
+			double time = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+			if (time > maxtime) maxtime = time;
+		}
+		double depthtime = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / framecount;
+
+		std::cout << "depth, " << threads << " thread" << (threads > 1 ? "s" : " ") << " : " << depthtime << " us/frame (max " << maxtime << " us), "
+			<< "error " << maxerror << " samples at most\n";
+	}
+
+	return 0;
+}
@@ -0,0 +1,104 @@
+// core cpp library
+#define _USE_MATH_DEFINES
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <random>
+#include <math.h>
+
+// dependencies
+#include <tclap/CmdLine.h>
+
+// the code generated per layout, and the code it replaces
+#include "FrameLayout.h"
+#include "FrameCodec.h"
+
+// function for parsing arguments
+void commandLineOptions(const int& argc, char** argv, long& framecount) {
+
+	// see TCLAP (Templatized C++ Command Line Parser Manual) documentation
+	// can be found in: http://tclap.sourceforge.net/manual.html
+	try {
+		TCLAP::CmdLine cmd("Measures the code generated for the standard 30x1500 layout against the code for any geometry", ' ', "1.0");
+
+		TCLAP::ValueArg<long> nameargFrameCount("c", "count", "Number of frames for every measurement.", false, 2000, "long");
+
+		cmd.add(nameargFrameCount);
+
+		cmd.parse(argc, argv);
+
+		framecount = nameargFrameCount.getValue();
+	}
+	catch (TCLAP::ArgException& e)  // catch exceptions
+	{
+		std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
+	}
+
+}
+
+// encodes and decodes every frame, returns microseconds per frame for both, and if everything came back the same
+bool measure(FrameCodec& codec, const std::vector<std::vector<uint16_t>>& frames, long framecount, double& encodetime, double& decodetime) {
+
+	std::vector<std::vector<char>> encoded(frames.size(), std::vector<char>(codec.getMaxEncodedSize()));
+	std::vector<size_t> encodedsize(frames.size());
+	std::vector<std::vector<uint16_t>> decoded(frames.size(), std::vector<uint16_t>(frames[0].size()));
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (long f = 0; f < framecount; f++) {
+		size_t i = f % frames.size();
+		encodedsize[i] = codec.encode(frames[i].data(), (i > 0) ? frames[i - 1].data() : nullptr, encoded[i].data());
+	}
+	encodetime = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / framecount;
+
+	start = std::chrono::steady_clock::now();
+	for (long f = 0; f < framecount; f++) {
+		size_t i = f % frames.size();
+		codec.decode(encoded[i].data(), encodedsize[i], (i > 0) ? decoded[i - 1].data() : nullptr, decoded[i].data());
+	}
+	decodetime = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / framecount;
+
+	return decoded == frames;
+}
+
+int main(int argc, char** argv)
+{
+	long framecount = 2000;
+
+	commandLineOptions(argc, argv, framecount);
+
+	// the frames of the simulator, the echo moves a bit from frame to frame
+	std::mt19937 rng(1);
+	std::normal_distribution<double> noise(0.0, 20.0);
+	std::vector<std::vector<uint16_t>> frames(64, std::vector<uint16_t>(RawLayout::samples() * RawLayout::probes()));
+	for (size_t f = 0; f < frames.size(); f++) {
+		for (int p = 0; p < RawLayout::probes(); p++) {
+			double center = (0.35 + 0.1 * p / RawLayout::probes() + 0.05 * sin(0.01 * f + p)) * RawLayout::samples();
+			double width = RawLayout::samples() / 150.0 + 1.0;
+			for (int s = 0; s < RawLayout::samples(); s++) {
+				double d = (s - center) / width;
+				double value = 2048.0 + 1500.0 * exp(-d * d) * sin(2.0 * M_PI * 0.12 * s) + noise(rng);
+				frames[f][(size_t)p * RawLayout::samples() + s] = (uint16_t)(value < 0.0 ? 0.0 : (value > 4095.0 ? 4095.0 : value));
+			}
+		}
+	}
+
+	FrameCodec codec(RawLayout::samples(), RawLayout::probes());
+
+	codec.setFixedLayout(false);
+	double runtimeencode, runtimedecode;
+	bool runtimeok = measure(codec, frames, framecount, runtimeencode, runtimedecode);
+
+	codec.setFixedLayout(true);
+	double fixedencode, fixeddecode;
+	bool fixedok = measure(codec, frames, framecount, fixedencode, fixeddecode);
+
+	std::cout << "\n==== A-mode layout benchmark ====\n"
+		<< "geometry       : " << RawLayout::probes() << " probes x " << RawLayout::samples() << " samples\n"
+		<< "encode runtime : " << runtimeencode << " us/frame\n"
+		<< "encode layout  : " << fixedencode << " us/frame (" << runtimeencode / fixedencode << "x)\n"
+		<< "decode runtime : " << runtimedecode << " us/frame\n"
+		<< "decode layout  : " << fixeddecode << " us/frame (" << runtimedecode / fixeddecode << "x)\n"
+		<< "lossless       : " << ((runtimeok && fixedok) ? "yes" : "NO") << "\n";
+
+	return 0;
+}
@@ -0,0 +1,405 @@
+// core cpp library
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <cstring>
+#include <iterator>
+#include <algorithm>
+#include <random>
+#include <atomic>
+#include <ctime>
+
+// dependencies
+#include <tclap/CmdLine.h>
+#include <boost/filesystem.hpp>
+
+// every path of a frame, from the socket to the disk
+#include "AModeUSConnection.h"
+#include "AModeSimulator.h"
+#include "FrameDecoder.h"
+#include "FramePool.h"
+#include "SpscQueue.h"
+#include "FrameRecorder.h"
+#include "CsvFormatter.h"
+#include "DepthLogWriter.h"
+
+// function for parsing arguments
+void commandLineOptions(const int& argc, char** argv, std::string& benchmarks, std::string& geometries, long& framecount,
+						std::string& outputdir, std::string& resultfile, std::string& port, std::string& label) {
+
+	// see TCLAP (Templatized C++ Command Line Parser Manual) documentation
+	// can be found in: http://tclap.sourceforge.net/manual.html
+	try {
+		TCLAP::CmdLine cmd("Runs the benchmarks of the decoding, the csv formatting, the recording, the queue and the loopback streaming, and appends the results as json lines", ' ', "1.0");
+
+		TCLAP::ValueArg<std::string> nameargBenchmarks("b", "benchmarks", "Comma separated: decode, csv, record, queue, loopback.", false, "decode,csv,record,queue,loopback", "string");
+		TCLAP::ValueArg<std::string> nameargGeometries("g", "geometries", "Comma separated raw geometries, probes x samples.", false, "30x1500,30x3000,64x1500", "string");
+		TCLAP::ValueArg<long> nameargFrameCount("c", "count", "Frames for every benchmark and geometry.", false, 5000, "long");
+		TCLAP::ValueArg<std::string> nameargOutputDir("o", "output", "Directory for the recordings, they are removed afterwards.", false, ".", "string");
+		TCLAP::ValueArg<std::string> nameargResult("j", "json", "File the results are appended to, one json line per result.", false, "amode_benchmark.jsonl", "string");
+		TCLAP::ValueArg<std::string> nameargPort("", "port", "First loopback port, every geometry takes the next one.", false, "6350", "string");
+		TCLAP::ValueArg<std::string> nameargLabel("l", "label", "Stored with every result, e.g. the version or the commit.", false, "", "string");
+
+		cmd.add(nameargBenchmarks);
+		cmd.add(nameargGeometries);
+		cmd.add(nameargFrameCount);
+		cmd.add(nameargOutputDir);
+		cmd.add(nameargResult);
+		cmd.add(nameargPort);
+		cmd.add(nameargLabel);
+
+		cmd.parse(argc, argv);
+
+		benchmarks = nameargBenchmarks.getValue();
+		geometries = nameargGeometries.getValue();
+		framecount = nameargFrameCount.getValue();
+		outputdir = nameargOutputDir.getValue();
+		resultfile = nameargResult.getValue();
+		port = nameargPort.getValue();
+		label = nameargLabel.getValue();
+	}
+	catch (TCLAP::ArgException& e)  // catch exceptions
+	{
+		std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
+	}
+
+}
+
+// a raw geometry, named like on the command line
+struct Geometry
+{
+	int probes;
+	int samples;
+	std::string name;
+};
+
+std::vector<std::string> splitList(const std::string& list) {
+	std::vector<std::string> items;
+	std::stringstream stream(list);
+	std::string item;
+	while (std::getline(stream, item, ',')) if (!item.empty()) items.push_back(item);
+	return items;
+}
+
+// every result is one json line, the same for every release so the lines of two releases can be compared,
+// a run is identified by its time and label
+class Results
+{
+
+private:
+	FILE* file_ = nullptr;
+	long long time_;
+	std::string label_;
+
+public:
+	Results(const std::string& path, const std::string& label) : label_(label) {
+		time_ = (long long)std::time(nullptr);
+		if (!path.empty()) file_ = fopen(path.c_str(), "ab");
+		if (!path.empty() && file_ == nullptr) std::cerr << "Unable to open " << path << ", the results are only printed" << std::endl;
+	}
+
+	~Results() {
+		if (file_ != nullptr) fclose(file_);
+	}
+
+	void add(const char* benchmark, const char* variant, const std::string& geometry, long frames, double value, const char* unit) {
+		char line[512];
+		snprintf(line, sizeof(line), "{\"time\":%lld,\"label\":\"%s\",\"benchmark\":\"%s\",\"variant\":\"%s\",\"geometry\":\"%s\",\"frames\":%ld,\"value\":%.6g,\"unit\":\"%s\"}\n",
+			time_, label_.c_str(), benchmark, variant, geometry.c_str(), frames, value, unit);
+		if (file_ != nullptr) fputs(line, file_);
+		printf("%-9s %-16s %-9s %14.3f %s\n", benchmark, variant, geometry.c_str(), value, unit);
+	}
+};
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// the packets like the machine sends them in DATA_RAW, 4 bytes of size, 2 bytes of index and the 12 bit samples
+std::vector<char> makeStream(const Geometry& geometry, int packets) {
+	int datasize = geometry.probes * geometry.samples * (int)sizeof(uint16_t);
+	uint32_t bodysize = 2 + datasize;
+	std::vector<char> stream((size_t)packets * (4 + bodysize));
+
+	std::mt19937 rng(6340);
+	for (int p = 0; p < packets; p++) {
+		char* packet = stream.data() + (size_t)p * (4 + bodysize);
+		memcpy(packet, &bodysize, sizeof(uint32_t));
+		uint16_t index = (uint16_t)p;
+		memcpy(packet + 4, &index, sizeof(uint16_t));
+		uint16_t* values = (uint16_t*)(packet + 6);
+		for (int v = 0; v < datasize / 2; v++) values[v] = (uint16_t)(rng() & 0xfff);
+	}
+	return stream;
+}
+
+// the receive path without the socket: the stream comes in pieces of a recv() and is reassembled by the decoder,
+// either in its own buffer and then copied out (how it was before the pool), or directly in the slots of the pool
+void benchmarkDecode(Results& results, const Geometry& geometry, long framecount) {
+
+	const int packets = 64;
+	const int recvsize = 64 * 1024;         // what one recv() typically returns on loopback
+	std::vector<char> stream = makeStream(geometry, packets);
+	int datasize = geometry.probes * geometry.samples * (int)sizeof(uint16_t);
+
+	for (int pooled = 0; pooled < 2; pooled++) {
+		FrameDecoder decoder(4, 2, datasize);
+		FramePool pool(8, 4, 2, datasize);
+		std::vector<char> copy(decoder.frameSize());
+		FrameRef current;
+		if (pooled) {
+			current = pool.acquire();
+			decoder.setBuffer(current->packet);
+		}
+
+		volatile uint64_t indexsum = 0;
+		long frames = 0;
+		size_t position = 0;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		while (frames < framecount) {
+			int bytes = std::min(decoder.writeSize(), recvsize);
+			bytes = (int)std::min((size_t)bytes, stream.size() - position);
+			memcpy(decoder.writePointer(), stream.data() + position, bytes);
+			position = (position + bytes) % stream.size();
+
+			if (decoder.commit(bytes)) {
+				uint64_t index = 0;
+				memcpy(&index, decoder.frame() + 4, 2);
+				indexsum = indexsum + index;
+				if (pooled) {
+					current = pool.acquire();
+					decoder.setBuffer(current->packet);
+				}
+				else {
+					memcpy(copy.data(), decoder.frame(), decoder.frameSize());
+				}
+				frames++;
+			}
+		}
+		double seconds = secondsSince(start);
+
+		if (decoder.getResyncCount() != 0) std::cerr << "decode: the stream was misaligned" << std::endl;
+		results.add("decode", pooled ? "pool" : "copy", geometry.name, frames, seconds * 1e9 / frames, "ns/frame");
+		results.add("decode", pooled ? "pool" : "copy", geometry.name, frames, (double)frames * decoder.frameSize() / seconds / 1e6, "MB/s");
+	}
+}
+
+// DATA_DEPTH frames (30 probes x 2 values) as text with the stream the recorder had before, with CsvFormatter,
+// and into the columns of the depth log, every variant writes a file
+void benchmarkCsv(Results& results, const std::string& outputdir, long framecount) {
+
+	const int probes = 30;
+	const int values = 2;
+	std::vector<double> depth(probes * values);
+	std::mt19937 rng(6340);
+	std::uniform_real_distribution<double> distribution(10.0, 60.0);
+	std::string geometry = std::to_string(probes) + "x" + std::to_string(values);
+	boost::filesystem::path path = boost::filesystem::path(outputdir) / "suitebenchmark.csv";
+
+	// the ofstream and the ostream_iterator, like the recorder did it
+	{
+		std::ofstream file(path.string());
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (long f = 0; f < framecount; f++) {
+			for (double& value : depth) value = distribution(rng);
+			file << std::to_string(f * 1e-3) << ",";
+			std::copy(depth.begin(), depth.end(), std::ostream_iterator<double>(file, ","));
+			file << "\n";
+		}
+		file.close();
+		results.add("csv", "ostream", geometry, framecount, secondsSince(start) * 1e9 / framecount, "ns/frame");
+	}
+
+	{
+		CsvFormatter csv;
+		csv.open(path.string());
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (long f = 0; f < framecount; f++) {
+			for (double& value : depth) value = distribution(rng);
+			csv.addTime(f * 1000000);
+			for (double value : depth) csv.addDouble(value);
+			csv.endLine();
+		}
+		csv.close();
+		results.add("csv", "formatter", geometry, framecount, secondsSince(start) * 1e9 / framecount, "ns/frame");
+	}
+	boost::filesystem::remove(path);
+
+	{
+		DepthLogWriter depthlog;
+		depthlog.open(outputdir, "suitebenchmark", probes, values, RECORDING_CLOCK_MONOTONIC, 0, 0);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (long f = 0; f < framecount; f++) {
+			for (double& value : depth) value = distribution(rng);
+			depthlog.write(f * 1000000, f, depth.data());
+		}
+		depthlog.close();
+		results.add("csv", "columns", geometry, framecount, secondsSince(start) * 1e9 / framecount, "ns/frame");
+	}
+	boost::filesystem::remove(boost::filesystem::path(outputdir) / ("suitebenchmark" + std::string(DEPTHLOG_EXTENSION)));
+}
+
+// the recorder as fast as the disk takes it, the frames are pushed from the pool like the connection does,
+// measured until stop() returned, so everything is written
+void benchmarkRecord(Results& results, const Geometry& geometry, const std::string& outputdir, long framecount) {
+
+	boost::filesystem::path directory = boost::filesystem::path(outputdir) / "suitebenchmark_record";
+	std::vector<char> stream = makeStream(geometry, 16);
+	int datasize = geometry.probes * geometry.samples * (int)sizeof(uint16_t);
+	int packetsize = 6 + datasize;
+
+	struct Variant
+	{
+		const char* name;
+		int format;
+		int compressthreads;
+		int tiffthreads;
+	};
+	const Variant variants[] = { { "binary", RECORD_BINARY, 0, 0 }, { "binary_compressed", RECORD_BINARY, 2, 0 },
+		{ "tiff", RECORD_TIFF, 0, 0 }, { "tiff_pool2", RECORD_TIFF, 0, 2 }, { "tiff_pool4", RECORD_TIFF, 0, 4 } };
+
+	for (const Variant& variant : variants) {
+		boost::filesystem::remove_all(directory);
+		boost::filesystem::create_directories(directory);
+
+		FramePool pool(512, 4, 2, datasize);
+		FrameRecorder recorder(DATA_RAW, geometry.samples, geometry.probes, 256, QUEUE_BLOCK);
+		recorder.setFormat(variant.format);
+		recorder.setCompression(variant.compressthreads);
+		recorder.setTiffThreads(variant.tiffthreads);
+		recorder.useDataIndex(true);
+		recorder.setPath(directory.string(), "suitebenchmark");
+		if (recorder.start() != 0) {
+			std::cerr << "record: unable to start the recorder for " << variant.name << std::endl;
+			continue;
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (long f = 0; f < framecount; f++) {
+			FrameRef frame;
+			while ((frame = pool.acquire()).empty()) std::this_thread::yield();
+			memcpy(frame->packet, stream.data() + (size_t)(f % 16) * packetsize, packetsize);
+			frame->timestamp = FrameClock::now();
+			frame->index = (uint64_t)f;
+			recorder.push(frame);
+		}
+		recorder.stop();
+		double seconds = secondsSince(start);
+
+		results.add("record", variant.name, geometry.name, recorder.getWriteCount(), recorder.getWriteCount() / seconds, "frames/s");
+		results.add("record", variant.name, geometry.name, recorder.getWriteCount(), (double)recorder.getWriteCount() * datasize / seconds / 1e6, "MB/s");
+	}
+	boost::filesystem::remove_all(directory);
+}
+
+// the handoff of a frame from the thread of the socket to a consumer thread through the queue of the recorder,
+// the consumer only lets go of the slot, so this is what the queue and the references cost
+void benchmarkQueue(Results& results, const Geometry& geometry, long framecount) {
+
+	int datasize = geometry.probes * geometry.samples * (int)sizeof(uint16_t);
+	FramePool pool(512, 4, 2, datasize);
+	SpscQueue<FrameRef> queue(256, QUEUE_BLOCK);
+	std::atomic<long> popped{ 0 };
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::thread consumer([&] {
+		FrameRef frame;
+		while (popped.load(std::memory_order_relaxed) < framecount) {
+			if (queue.pop(frame)) {
+				frame = FrameRef();
+				popped.fetch_add(1, std::memory_order_relaxed);
+			}
+			else {
+				std::this_thread::yield();
+			}
+		}
+	});
+
+	for (long f = 0; f < framecount; f++) {
+		FrameRef frame;
+		while ((frame = pool.acquire()).empty()) std::this_thread::yield();
+		frame->index = (uint64_t)f;
+		queue.push(frame);
+	}
+	consumer.join();
+	double seconds = secondsSince(start);
+
+	results.add("queue", "spsc_frameref", geometry.name, framecount, seconds * 1e9 / framecount, "ns/frame");
+}
+
+// the simulator and the connection over loopback, as fast as possible, the same as AModeBenchmark without recording
+void benchmarkLoopback(Results& results, const Geometry& geometry, const std::string& port, long framecount) {
+
+	AModeSimulator simulator(port, geometry.samples, geometry.probes, DATA_RAW);
+	simulator.setFrameRate(0.0);
+	simulator.setFrameCount(framecount);
+	if (simulator.listenTCP() != 0) {
+		std::cerr << "loopback: unable to listen on " << port << std::endl;
+		return;
+	}
+	std::thread threadSimulator(std::ref(simulator));
+
+	AModeUSConnection connection("127.0.0.1", port, geometry.samples, geometry.probes);
+	connection.setRecord(false);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::thread threadConnection(std::ref(connection));
+	threadConnection.join();
+	threadSimulator.join();
+	double seconds = secondsSince(start);
+
+	long received = connection.getFrameCount();
+	results.add("loopback", "raw", geometry.name, received, received / seconds, "frames/s");
+	results.add("loopback", "raw", geometry.name, received, (double)received * simulator.getPacketSize() / seconds / 1e6, "MB/s");
+	results.add("loopback", "raw", geometry.name, received, (double)(simulator.getFrameSent() - received), "frames dropped");
+	results.add("loopback", "raw", geometry.name, received, (double)connection.getResyncCount(), "resyncs");
+}
+
+int main(int argc, char** argv)
+{
+	std::string benchmarks = "decode,csv,record,queue,loopback";
+	std::string geometrylist = "30x1500,30x3000,64x1500";
+	long framecount = 5000;
+	std::string outputdir = ".";
+	std::string resultfile = "amode_benchmark.jsonl";
+	std::string port = "6350";
+	std::string label;
+
+	commandLineOptions(argc, argv, benchmarks, geometrylist, framecount, outputdir, resultfile, port, label);
+	if (framecount < 1) framecount = 1;
+
+	std::vector<Geometry> geometries;
+	for (const std::string& item : splitList(geometrylist)) {
+		Geometry geometry;
+		if (sscanf(item.c_str(), "%dx%d", &geometry.probes, &geometry.samples) != 2 || geometry.probes < 1 || geometry.samples < 1) {
+			std::cerr << "Geometry " << item << " is not probes x samples" << std::endl;
+			return 1;
+		}
+		geometry.name = item;
+		geometries.push_back(geometry);
+	}
+	std::vector<std::string> selected = splitList(benchmarks);
+	auto run = [&](const char* name) { return std::find(selected.begin(), selected.end(), name) != selected.end(); };
+
+	Results results(resultfile, label);
+	std::cout << "\n==== A-mode benchmark suite ====\n"
+		<< framecount << " frames per benchmark and geometry, results appended to " << resultfile << "\n\n";
+
+	if (run("decode")) for (const Geometry& geometry : geometries) benchmarkDecode(results, geometry, framecount);
+	if (run("csv")) benchmarkCsv(results, outputdir, framecount);
+	if (run("record")) for (const Geometry& geometry : geometries) benchmarkRecord(results, geometry, outputdir, framecount);
+	if (run("queue")) for (const Geometry& geometry : geometries) benchmarkQueue(results, geometry, framecount);
+
+	// the connection prints every frame, so the loopback is last
+	if (run("loopback")) {
+		for (size_t g = 0; g < geometries.size(); g++) {
+			benchmarkLoopback(results, geometries[g], std::to_string(std::stoi(port) + (int)g), framecount);
+		}
+	}
+
+	return 0;
+}
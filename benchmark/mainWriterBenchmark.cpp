@@ -0,0 +1,175 @@
+// core cpp library
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <random>
+
+// dependencies
+#include <tclap/CmdLine.h>
+#include <boost/filesystem.hpp>
+
+// the writer and the backends we want to measure
+#include "RecordingWriter.h"
+
+// function for parsing arguments
+void commandLineOptions(const int& argc, char** argv, std::string& outputdir, long& framecount, int& framesize, double& framerate, int& segmentsize, int& inflight) {
+
+	// see TCLAP (Templatized C++ Command Line Parser Manual) documentation
+	// can be found in: http://tclap.sourceforge.net/manual.html
+	try {
+		TCLAP::CmdLine cmd("Measures the throughput and the latency of writing the frames: one fwrite() per frame, RecordingWriter with fwrite(), with io_uring and with io_uring and O_DIRECT", ' ', "1.0");
+
+		TCLAP::ValueArg<std::string> nameargOutputDir("o", "output", "Directory for the files, on the disk to measure.", false, ".", "string");
+		TCLAP::ValueArg<long> nameargFrameCount("c", "count", "Number of frames for every backend.", false, 10000, "long");
+		TCLAP::ValueArg<int> nameargFrameSize("b", "bytes", "Bytes of a frame, 90000 is a raw 30x1500 frame.", false, 90000, "int");
+		TCLAP::ValueArg<double> nameargFrameRate("r", "rate", "Frames per second, 0 as fast as possible.", false, 0, "double");
+		TCLAP::ValueArg<int> nameargSegmentSize("g", "segment", "Segment size in MB.", false, 256, "int");
+		TCLAP::ValueArg<int> nameargInflight("q", "inflight", "Buffers written at the same time with io_uring.", false, 4, "int");
+
+		cmd.add(nameargOutputDir);
+		cmd.add(nameargFrameCount);
+		cmd.add(nameargFrameSize);
+		cmd.add(nameargFrameRate);
+		cmd.add(nameargSegmentSize);
+		cmd.add(nameargInflight);
+
+		cmd.parse(argc, argv);
+
+		outputdir = nameargOutputDir.getValue();
+		framecount = nameargFrameCount.getValue();
+		framesize = nameargFrameSize.getValue();
+		framerate = nameargFrameRate.getValue();
+		segmentsize = nameargSegmentSize.getValue();
+		inflight = nameargInflight.getValue();
+	}
+	catch (TCLAP::ArgException& e)  // catch exceptions
+	{
+		std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
+	}
+
+}
+
+// the files are only for the measurement, and every backend should create new files like a session does
+void removeFiles(const std::string& outputdir) {
+
+	boost::filesystem::remove(boost::filesystem::path(outputdir) / "writerbenchmark_frame.bin");
+	for (int s = 0; ; s++) {
+		char segmentname[64];
+		snprintf(segmentname, sizeof(segmentname), "writerbenchmark_%04d%s", s, RECORDING_EXTENSION);
+		if (!boost::filesystem::remove(boost::filesystem::path(outputdir) / segmentname)) break;
+	}
+}
+
+// the microseconds the writer thread spent in every write, and how long it took until everything was closed
+struct Measurement
+{
+	std::vector<double> latency;
+	double seconds = 0.0;
+	bool ok = true;
+};
+
+// writes the frames with the rate, backend < 0 is the path before RecordingWriter, one fwrite() per frame
+Measurement measure(int backend, bool direct, const std::string& outputdir, const std::vector<char>& frame, long framecount,
+	double framerate, int segmentsize, int inflight) {
+
+	Measurement measurement;
+	measurement.latency.reserve(framecount);
+
+	RecordingWriter writer;
+	FILE* file = nullptr;
+	if (backend < 0) {
+		file = fopen((boost::filesystem::path(outputdir) / "writerbenchmark_frame.bin").string().c_str(), "wb");
+		if (file == nullptr) {
+			measurement.ok = false;
+			return measurement;
+		}
+		setvbuf(file, NULL, _IONBF, 0);
+	}
+	else {
+		writer.setBackend(backend, direct, inflight);
+		writer.setSegmentSize((uint64_t)segmentsize << 20);
+		if (writer.open(outputdir, "writerbenchmark", 0, (int)frame.size() / 2, 1, 2, RECORDING_CLOCK_MONOTONIC, 0, 0) != 0) {
+			measurement.ok = false;
+			return measurement;
+		}
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (long f = 0; f < framecount; f++) {
+		if (framerate > 0) std::this_thread::sleep_until(start + std::chrono::duration<double>(f / framerate));
+
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		if (backend < 0) {
+			if (fwrite(frame.data(), 1, frame.size(), file) != frame.size()) measurement.ok = false;
+		}
+		else {
+			if (writer.write(f, f, frame.data(), (uint32_t)frame.size()) != 0) measurement.ok = false;
+		}
+		measurement.latency.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count());
+	}
+
+	if (backend < 0) {
+		if (fclose(file) != 0) measurement.ok = false;
+	}
+	else if (writer.close() != 0) {
+		measurement.ok = false;
+	}
+	measurement.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	removeFiles(outputdir);
+	return measurement;
+}
+
+void print(const std::string& name, Measurement& measurement, const std::vector<char>& frame, long framecount) {
+
+	if (!measurement.ok) {
+		std::cout << name << ": failed\n";
+		return;
+	}
+
+	std::sort(measurement.latency.begin(), measurement.latency.end());
+	auto percentile = [&](double p) { return measurement.latency[(size_t)(p * (measurement.latency.size() - 1))]; };
+
+	printf("%-16s %9.1f %9.1f %9.1f %9.1f %10.1f\n", name.c_str(), percentile(0.5), percentile(0.99), percentile(0.999),
+		measurement.latency.back(), frame.size() * (double)framecount / measurement.seconds / 1e6);
+}
+
+int main(int argc, char** argv)
+{
+	std::string outputdir = ".";
+	long framecount = 10000;
+	int framesize = 90000;
+	double framerate = 0.0;
+	int segmentsize = 256;
+	int inflight = 4;
+
+	commandLineOptions(argc, argv, outputdir, framecount, framesize, framerate, segmentsize, inflight);
+
+	// noise, so a filesystem with compression can't make it smaller
+	std::vector<char> frame(framesize);
+	std::mt19937 rng(1);
+	for (char& value : frame) value = (char)rng();
+
+	removeFiles(outputdir);
+
+	std::cout << "\n==== A-mode writer benchmark ====\n"
+		<< framecount << " frames of " << framesize << " bytes, " << (framerate > 0 ? std::to_string(framerate) + " frames/s" : "as fast as possible")
+		<< ", io_uring " << (AsyncFileWriter::hasIoUring() ? "available" : "NOT available") << "\n"
+		<< "latency of a write in us, MB/s until the files are closed\n\n";
+	printf("%-16s %9s %9s %9s %9s %10s\n", "backend", "p50", "p99", "p99.9", "max", "MB/s");
+
+	Measurement measurement = measure(-1, false, outputdir, frame, framecount, framerate, segmentsize, inflight);
+	print("fwrite per frame", measurement, frame, framecount);
+	measurement = measure(FILEWRITER_BUFFERED, false, outputdir, frame, framecount, framerate, segmentsize, inflight);
+	print("buffered", measurement, frame, framecount);
+	if (AsyncFileWriter::hasIoUring()) {
+		measurement = measure(FILEWRITER_IOURING, false, outputdir, frame, framecount, framerate, segmentsize, inflight);
+		print("io_uring", measurement, frame, framecount);
+		measurement = measure(FILEWRITER_IOURING, true, outputdir, frame, framecount, framerate, segmentsize, inflight);
+		print("io_uring direct", measurement, frame, framecount);
+	}
+
+	return 0;
+}
@@ -1,8 +1,7 @@
 #include <Synch.h>
 
-bool synch::stop_= false;
-std::mutex synch::stopMutex_;
+std::atomic<bool> synch::stop_{ false };
 
 std::condition_variable synch::startCondVar_;
 std::mutex synch::startMutex_;
-bool synch::start_ = false;
\ No newline at end of file
+std::atomic<int64_t> synch::startTime_{ 0 };
\ No newline at end of file
@@ -1,13 +1,20 @@
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <csignal>
 #include <iostream>
 #include <cstdlib>
+#include <stdint.h>
 
 #ifndef SYNCH_H
 #define SYNCH_H
 
 /**
  * @brief Class for syncronization between framegrabber and mocap (and also stop the exec)
+ * The flags are atomics, the threads which stream read them for every frame without taking a lock.
+ * Only waitStart() sleeps on a condition variable, that is for the threads which have nothing to do before the start.
 */
 class synch
 {
@@ -18,11 +25,7 @@ public:
 	*/
 	static bool getStop()
 	{
-		bool stop;
-		stopMutex_.lock();
-		stop = stop_;
-		stopMutex_.unlock();
-		return stop;
+		return stop_.load(std::memory_order_acquire);
 	}
 
 	/**
@@ -31,44 +34,117 @@ public:
 	*/
 	static void setStop(bool stop)
 	{
-		stopMutex_.lock();
-		stop_ = stop;
-		stopMutex_.unlock();
+		stop_.store(stop, std::memory_order_release);
 		// if we were waiting to start if we don't start it will still wait and not stop
 		if (stop == true)
 		{
 			std::cout << "stop" << std::endl;
-			start();
+			wakeWaiting();
 		}
 	}
 
+	/**
+	 * @brief Stop on ctrl+c (SIGINT) and SIGTERM, instead of polling the keyboard in the threads.
+	 * The handler only sets the stop flag (a lock-free atomic, that is allowed in a signal handler),
+	 * whoever waits for getStop() does the rest, see waitStop().
+	*/
+	static void installSignalHandler()
+	{
+		std::signal(SIGINT, onSignal);
+		std::signal(SIGTERM, onSignal);
+	}
+
+	/**
+	 * @brief Wait until getStop(), for a control thread which then stops everything else
+	 * @param timeout seconds to wait at most
+	 * @return if we are stopping the exec
+	*/
+	static bool waitStop(double timeout)
+	{
+		// a signal handler can't notify anybody, so this looks at the flag every few milliseconds
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(timeout));
+		while (!getStop() && std::chrono::steady_clock::now() < end)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+		return getStop();
+	}
+
 	/**
 	 * @brief Wait for the start of the recording of the mocap system
+	 * @return when it started, see getStartTime() (0 if we are stopping before the start)
 	*/
-	static void waitStart()
+	static int64_t waitStart()
 	{
+		int64_t started = startTime_.load(std::memory_order_acquire);
+		if (started != 0) return started;
+
 		std::unique_lock<std::mutex> lk(startMutex_);
-		startCondVar_.wait(lk, [] {return start_; });
+		startCondVar_.wait(lk, [] {return startTime_.load(std::memory_order_acquire) != 0 || getStop(); });
+		return startTime_.load(std::memory_order_acquire);
+	}
+
+	/**
+	 * @brief start the recording of the video stream, only the first start counts
+	 * @param timestamp when the mocap system started, nanoseconds of std::chrono::steady_clock (FrameClock::now()), 0 is now
+	*/
+	static void start(int64_t timestamp = 0)
+	{
+		if (timestamp == 0) timestamp = now();
+		int64_t none = 0;
+		if (startTime_.compare_exchange_strong(none, timestamp, std::memory_order_acq_rel)) wakeWaiting();
+	}
+
+	/**
+	 * @brief If the recording of the mocap system has started, without waiting for it
+	 * @return if start() was called
+	*/
+	static bool isStarted()
+	{
+		return startTime_.load(std::memory_order_acquire) != 0;
+	}
+
+	/**
+	 * @brief When the recording of the mocap system started, without waiting for it
+	 * @return nanoseconds of std::chrono::steady_clock, 0 if it didn't start yet
+	*/
+	static int64_t getStartTime()
+	{
+		return startTime_.load(std::memory_order_acquire);
 	}
 
 	/**
-	 * @brief start the recording of the video stream
+	 * @brief nanoseconds of std::chrono::steady_clock, the clock of the start time
 	*/
-	static void start()
+	static int64_t now()
 	{
-		startMutex_.lock();
-		start_ = true;
-		startMutex_.unlock();
-		startCondVar_.notify_one();
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
 	}
 
 protected:
-	static bool stop_;
-	static std::mutex stopMutex_;
+	/**
+	 * @brief Wakes the threads in waitStart(), they look at the flags again
+	*/
+	static void wakeWaiting()
+	{
+		// the lock is only so a thread which just checked the flags is already waiting, otherwise it would miss this
+		{
+			std::lock_guard<std::mutex> lk(startMutex_);
+		}
+		startCondVar_.notify_all();
+	}
+
+	static void onSignal(int)
+	{
+		stop_.store(true, std::memory_order_release);
+	}
+
+	static std::atomic<bool> stop_;
+	static_assert(std::atomic<bool>::is_always_lock_free, "the signal handler needs a lock-free stop flag");
 
 	static std::condition_variable startCondVar_;
 	static std::mutex startMutex_;
-	static bool start_;
+	static std::atomic<int64_t> startTime_;
 };
 
-#endif
\ No newline at end of file
+#endif
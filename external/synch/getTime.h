@@ -3,13 +3,16 @@
 #ifdef WIN32
 #include <windows.h>
 #endif
+#if defined(UNIX) || defined(__unix__)
+#include <sys/time.h>
+#endif
 
 namespace rtb {
 
 	inline double getTime()
 	{
 		double timeNow;
-#ifdef UNIX
+#if defined(UNIX) || defined(__unix__)
 		struct timeval now;
 
 		gettimeofday(&now, NULL);
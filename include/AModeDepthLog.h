@@ -0,0 +1,74 @@
+#ifndef AMODEDEPTHLOG_H
+#define AMODEDEPTHLOG_H
+
+// basic libraries
+#include <stdint.h>
+
+/*
+ * Columnar binary log of the DATA_DEPTH frames of a session, used instead of the .csv.
+ *
+ * A DATA_DEPTH frame is only 60 doubles, one line of text per frame costs more than the frame itself, and nobody
+ * reads a whole frame later, they plot one probe over time. So the frames are collected in blocks and every block
+ * is stored column by column: all the timestamps, all the indices, then every value (probe after probe, value
+ * after value) over all the frames of the block. One file <name>.amodedepth:
+ *
+ *   DepthLogHeader                         fixed, everything needed to interpret the blocks
+ *   DepthLogBlockHeader + columns          one block per blockframes frames, the last one can be shorter
+ *   DepthLogBlockHeader + columns
+ *   ...
+ *   DepthLogBlockHeader + metadata         the trailer, written when the log is closed (version 2)
+ *
+ * The columns of a block with framecount frames, one after another without padding:
+ *
+ *   int64_t  timestamp[framecount]         when the frames arrived, see DepthLogHeader::clock
+ *   uint64_t index[framecount]             index sent by the machine
+ *   double   value[framecount]             probe 0 value 0, then probe 0 value 1, ... columns times
+ *
+ * The trailer has the magic DEPTHLOG_METADATA_MAGIC, framecount and columns 0, firstframe the frames of the log and
+ * blocksize the bytes of the metadata behind it, "key=value\n" text like the metadata of the .amode segments
+ * (the loss on the network, the reconnects, the trigger, ... see AModeUSConnection::stopStreaming()).
+ *
+ * All numbers are little endian. A block is written in one go when it is full, if the session crashed only the
+ * block being collected is lost, a block cut short at the end of the file is ignored. A log which was not closed
+ * has no trailer, so it has no metadata either.
+ */
+
+#define DEPTHLOG_MAGIC "AMODECOL"           //!< First 8 bytes of the file
+#define DEPTHLOG_BLOCK_MAGIC "AMODEBLK"     //!< First 8 bytes of every block
+#define DEPTHLOG_METADATA_MAGIC "AMODEMTA"  //!< First 8 bytes of the trailer with the metadata
+#define DEPTHLOG_VERSION 2                  //!< 1 had no trailer
+#define DEPTHLOG_EXTENSION ".amodedepth"
+
+/**
+ * @brief Fixed header at the beginning of the file.
+ */
+struct DepthLogHeader
+{
+    char magic[8];                          //!< DEPTHLOG_MAGIC, not null terminated
+    uint32_t version;                       //!< DEPTHLOG_VERSION
+    uint32_t headersize;                    //!< sizeof(DepthLogHeader), the first block starts here
+    uint32_t probes;                        //!< Number of probes
+    uint32_t values;                        //!< Values per probe (2, depth and amplitude)
+    uint32_t blockframes;                   //!< Frames of a full block
+    uint32_t clock;                         //!< What the timestamps mean, RECORDING_CLOCK_WALL or RECORDING_CLOCK_MONOTONIC (AModeRecording.h)
+    int64_t clockorigin;                    //!< Timestamp (same clock) when the session was started
+    int64_t wallorigin;                     //!< Nanoseconds since 1970 at clockorigin
+    uint8_t reserved[80];                   //!< Zero, room for later versions
+};
+
+/**
+ * @brief Written in front of the columns of every block.
+ */
+struct DepthLogBlockHeader
+{
+    char magic[8];                          //!< DEPTHLOG_BLOCK_MAGIC
+    uint32_t framecount;                    //!< Frames in this block, the length of every column
+    uint32_t columns;                       //!< Number of value columns, probes * values
+    uint64_t firstframe;                    //!< Number of frames in the blocks before this one
+    uint64_t blocksize;                     //!< Bytes of the columns behind this header
+};
+
+static_assert(sizeof(DepthLogHeader) == 128, "DepthLogHeader must be 128 bytes");
+static_assert(sizeof(DepthLogBlockHeader) == 32, "DepthLogBlockHeader must be 32 bytes");
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef AMODERECORDING_H
+#define AMODERECORDING_H
+
+// basic libraries
+#include <stdint.h>
+
+/*
+ * Binary recording of an A-mode session, used instead of one .tiff per frame.
+ *
+ * A session is a set of segment files <name>_0000.amode, <name>_0001.amode, ... A new segment is started when
+ * the current one reaches the segment size, so no file gets too big to copy. Every segment is:
+ *
+ *   RecordingHeader                        fixed, everything needed to interpret the frames
+ *   RecordingFrameHeader + payload         one record per frame, appended in the order they arrived
+ *   RecordingFrameHeader + payload
+ *   ...
+ *   RecordingIndexEntry * framecount       written when the segment is closed, one entry per frame
+ *   metadata                               written when the segment is closed, "key=value\n" text
+ *   RecordingFooter                        the last bytes of the file, points to the index and metadata
+ *
+ * All numbers are little endian. The payload is the values exactly as the machine sends them (uint16_t for
+ * DATA_RAW, double for DATA_DEPTH, probe after probe), unless codec says it is compressed.
+ * If the session crashed and the footer is missing, the records can still be read one after another.
+ */
+
+#define RECORDING_MAGIC "AMODEREC"          //!< First 8 bytes of a segment
+#define RECORDING_FOOTER_MAGIC "AMODEIDX"   //!< First 8 bytes of the footer
+#define RECORDING_VERSION 1
+#define RECORDING_EXTENSION ".amode"
+
+#define RECORDING_CLOCK_WALL 0              //!< Timestamps are nanoseconds since 1970 (rtb::getTime())
+#define RECORDING_CLOCK_MONOTONIC 1         //!< Timestamps are nanoseconds of a monotonic clock, the wall time is timestamp - clockorigin + wallorigin
+
+#define RECORDING_CODEC_NONE 0              //!< Payload is the values as they came from the machine
+#define RECORDING_CODEC_PACK16 1            //!< Payload is a DATA_RAW frame compressed by FrameCodec, it may need the previous frame
+
+/**
+ * @brief Fixed header at the beginning of every segment.
+ */
+struct RecordingHeader
+{
+    char magic[8];                          //!< RECORDING_MAGIC, not null terminated
+    uint32_t version;                       //!< RECORDING_VERSION
+    uint32_t headersize;                    //!< sizeof(RecordingHeader), the first record starts here
+    uint32_t datamode;                      //!< DATA_RAW or DATA_DEPTH
+    uint32_t samples;                       //!< Values per probe
+    uint32_t probes;                        //!< Number of probes
+    uint32_t valuesize;                     //!< Bytes per value, 2 for DATA_RAW, 8 for DATA_DEPTH
+    uint32_t segment;                       //!< Number of this segment in the session, starting from 0
+    uint32_t clock;                         //!< What the timestamps mean, RECORDING_CLOCK_WALL or RECORDING_CLOCK_MONOTONIC
+    int64_t clockorigin;                    //!< Timestamp (same clock) when the session was started
+    uint64_t firstframe;                    //!< Number of frames in the segments before this one
+    int64_t wallorigin;                     //!< Nanoseconds since 1970 at clockorigin (0 in older files)
+    uint8_t reserved[64];                   //!< Zero, room for later versions
+};
+
+/**
+ * @brief Written in front of every payload.
+ */
+struct RecordingFrameHeader
+{
+    int64_t timestamp;                      //!< When the frame arrived, see RecordingHeader::clock
+    uint64_t index;                         //!< Index sent by the machine
+    uint32_t payloadsize;                   //!< Bytes of the payload behind this header
+    uint32_t codec;                         //!< RECORDING_CODEC_NONE if the payload is not compressed
+};
+
+/**
+ * @brief One entry of the index at the end of a segment.
+ */
+struct RecordingIndexEntry
+{
+    uint64_t offset;                        //!< Position of the RecordingFrameHeader in the segment file
+    int64_t timestamp;                      //!< Copy of RecordingFrameHeader::timestamp
+    uint64_t index;                         //!< Copy of RecordingFrameHeader::index
+};
+
+/**
+ * @brief The last bytes of a segment that was closed properly.
+ */
+struct RecordingFooter
+{
+    char magic[8];                          //!< RECORDING_FOOTER_MAGIC
+    uint64_t indexoffset;                   //!< Position of the first RecordingIndexEntry
+    uint64_t framecount;                    //!< Number of frames (and index entries) in this segment
+    uint64_t metadataoffset;                //!< Position of the metadata text
+    uint64_t metadatasize;                  //!< Bytes of the metadata text
+};
+
+static_assert(sizeof(RecordingHeader) == 128, "RecordingHeader must be 128 bytes");
+static_assert(sizeof(RecordingFrameHeader) == 24, "RecordingFrameHeader must be 24 bytes");
+static_assert(sizeof(RecordingIndexEntry) == 24, "RecordingIndexEntry must be 24 bytes");
+static_assert(sizeof(RecordingFooter) == 40, "RecordingFooter must be 40 bytes");
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef AMODESHAREDRING_H
+#define AMODESHAREDRING_H
+
+// basic libraries
+#include <stdint.h>
+#include <atomic>
+
+/*
+ * Shared memory ring of an A-mode stream, for other processes on the same PC (tracking, visualisation, ...).
+ * The connection writes every frame into it, any number of readers map it read-only and look at the frames in place.
+ *
+ *   SharedRingHeader                       fixed, what the frames are and how many were published
+ *   slot 0: SharedSlotHeader + values      slotsize bytes, the values start on a cache line
+ *   slot 1: SharedSlotHeader + values
+ *   ...
+ *   slot slotcount-1
+ *
+ * Frame n (counting from 0) is in slot n % slotcount. Every slot is a seqlock: the writer sets sequence to 2n+1
+ * before it changes the slot and to 2n+2 when frame n is complete. A reader which got frame n checks after
+ * using it that sequence is still 2n+2, otherwise the writer went round the ring and overwrote it (the reader
+ * was too slow). Readers never write to the ring, so a reader that crashes or stops reading doesn't matter to anyone.
+ * A writer that crashed is noticed with writerpid, it creates a new ring when it starts again.
+ *
+ * POSIX shared memory (/dev/shm/<name>) on linux, a named file mapping (Local\<name>) on windows.
+ */
+
+#define SHAREDRING_MAGIC "AMODESHM"         //!< First 8 bytes of the ring
+#define SHAREDRING_VERSION 1
+#define SHAREDRING_ALIGNMENT 64             //!< Slots and values start on a cache line
+
+#define SHAREDRING_STATE_OPEN 1             //!< The writer is publishing
+#define SHAREDRING_STATE_CLOSED 2           //!< The writer finished, no more frames come
+
+// the atomics are used by several processes, that only works if they don't need a lock
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the shared ring needs lock-free 64 bit atomics");
+
+/**
+ * @brief At the beginning of the shared memory.
+ */
+struct SharedRingHeader
+{
+    char magic[8];                          //!< SHAREDRING_MAGIC, not null terminated
+    uint32_t version;                       //!< SHAREDRING_VERSION
+    uint32_t headersize;                    //!< sizeof(SharedRingHeader), the first slot starts here
+    uint32_t datamode;                      //!< DATA_RAW or DATA_DEPTH
+    uint32_t samples;                       //!< Values per probe
+    uint32_t probes;                        //!< Number of probes
+    uint32_t valuesize;                     //!< Bytes per value, 2 for DATA_RAW, 8 for DATA_DEPTH
+    uint32_t slotcount;                     //!< Number of slots
+    uint32_t slotsize;                      //!< Bytes from one slot to the next
+    uint32_t datasize;                      //!< Bytes of the values of a frame
+    uint32_t reserved0;                     //!< Zero
+    int64_t writerpid;                      //!< Process id of the writer
+    int64_t clockorigin;                    //!< FrameClock::now() of the writer at wallorigin, the timestamps are the same clock
+    int64_t wallorigin;                     //!< Nanoseconds since 1970 at clockorigin
+    uint8_t reserved[48];                   //!< Zero, room for later versions
+
+    alignas(SHAREDRING_ALIGNMENT) std::atomic<uint64_t> published; //!< Frames published, the next frame is number published
+    std::atomic<int64_t> heartbeat;         //!< FrameClock::now() of the last publish
+    std::atomic<uint32_t> state;            //!< SHAREDRING_STATE_OPEN or SHAREDRING_STATE_CLOSED
+};
+
+/**
+ * @brief At the beginning of every slot, the values follow at SHAREDRING_ALIGNMENT.
+ */
+struct SharedSlotHeader
+{
+    std::atomic<uint64_t> sequence;         //!< 2n+1 while frame n is written, 2n+2 when it is complete, 0 never written
+    int64_t timestamp;                      //!< When the frame arrived, FrameClock::now() of the writer
+    uint64_t index;                         //!< Index sent by the machine
+    uint32_t datasize;                      //!< Bytes of the values
+    uint32_t reserved;                      //!< Zero
+};
+
+#endif
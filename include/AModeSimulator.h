@@ -0,0 +1,159 @@
+#ifndef AMODESIMULATOR_H
+#define AMODESIMULATOR_H
+
+// basic libraries
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <atomic>
+
+// socket library, winsock on windows and bsd sockets everywhere else
+#include "SocketCompat.h"
+
+#ifndef DATA_RAW
+#define DATA_RAW 0
+#define DATA_DEPTH 1
+#endif
+
+/**
+ * @brief AModeSimulator pretends to be the A-mode Ultrasound Machine.
+ * It listens on a TCP port and, once a client connected, streams packets with exactly the same
+ * structure as the machine does: 4 bytes header, the index (2 bytes for DATA_RAW, 8 bytes for DATA_DEPTH)
+ * and samples_ * probes_ values (uint16_t for DATA_RAW, double for DATA_DEPTH). This way we can test and
+ * benchmark AModeUSConnection on any PC (also on loopback) without the machine.
+ *
+ * The header of the real machine is not documented, the simulator puts the number of bytes that follows
+ * the header (index+data) there, as little endian uint32_t. The raw signal is a noisy baseline with one
+ * echo per probe which slowly moves in depth, so that the signal processing has something to detect.
+ */
+class AModeSimulator
+{
+
+private:
+    // variables that stores the connection spec
+    std::string port_;                      //!< Port number where the simulator listens
+    SOCKET ListenSocket_;                   //!< Socket which accepts the client
+    SOCKET ClientSocket_;                   //!< Socket of the connected client
+
+
+    // variables that stores amode spesifications
+    int samples_;                           //!< The number of sample points in the signal (default 1500)
+    int probes_;                            //!< The number of ultrasound probes (default 30)
+    int datalength_;                        //!< samples_ * probes_
+    int headersize_ = 4;                    //!< The number of bytes of the header of the data packet
+    int indexsize_;                         //!< The number of bytes of the index
+    int datamode_ = DATA_RAW;               //!< Mode of the data, DATA_RAW and DATA_DEPTH
+
+
+    // variables that controls the stream
+    double framerate_ = 0.0;                //!< Frames per second, 0 means as fast as the socket allows
+    long framecount_ = 0;                   //!< Frames to send before closing the connection, 0 means until stop()
+    int packetvariation_ = 64;              //!< How many different packets are precomputed and cycled
+    std::vector<std::vector<char>> packets_;//!< Precomputed packets (header+index+data)
+    uint64_t dataindex_ = 0;                //!< Index that will be put in the next packet
+    long skipevery_ = 0;                    //!< Every skipevery_-th packet the index skips one, 0 means never
+    std::atomic<long> countsent_{ 0 };      //!< Number of packets sent to the current client
+    std::atomic<bool> stop_{ false };       //!< Flag to stop streaming
+
+public:
+
+    /**
+     * @brief Default constructor, the geometry is the same as the machine for the given mode.
+     *
+     * @param port      Port where the simulator listens.
+     * @param mode      Streaming mode, DATA_RAW or DATA_DEPTH.
+     */
+    AModeSimulator(std::string port, int mode);
+
+
+    /**
+     * @brief Second option for constructors, you can put your own sample number and probes.
+     *
+     * @param port      Port where the simulator listens.
+     * @param samples   The number of point samples from the signals.
+     * @param probes    The number of probes/transducers being simulated.
+     * @param mode      Streaming mode, DATA_RAW or DATA_DEPTH.
+     */
+    AModeSimulator(std::string port, int samples, int probes, int mode);
+
+    ~AModeSimulator();
+
+
+    /**
+     * @brief A function to set how many frames per second are sent.
+     * @param framerate     Frames per second, 0 means as fast as possible.
+     */
+    void setFrameRate(double framerate);
+
+    /**
+     * @brief A function to set how many frames are sent before the simulator closes the connection.
+     * @param framecount    Number of frames, 0 means stream until stop() is called.
+     */
+    void setFrameCount(long framecount);
+
+    /**
+     * @brief A function to pretend that frames are lost on the network, the index jumps over one frame
+     * after every skipevery-th packet (nothing else changes, the packets are all sent).
+     * @param skipevery     Packets between two lost frames, 0 means no frame is lost.
+     */
+    void setIndexSkip(long skipevery);
+
+    /**
+     * @brief Open the listening socket. Call this before the client tries to connect.
+     * @return              A flag indicating the status. 0 if success, -1 if there is something wrong.
+     */
+    int listenTCP();
+
+    /**
+     * @brief Close the listening socket, like a machine that is switched off, connecting is refused until listenTCP().
+     * Call it when operator()() returned.
+     */
+    void closeTCP();
+
+    /**
+     * @brief A function to let the index go on as if frames were sent, e.g. while the simulator was "off",
+     * the machine keeps counting when nobody is connected.
+     * @param frames        Frames the index skips.
+     */
+    void advanceIndex(long frames);
+
+    /**
+     * @brief A function that is used for multithreading.
+     * Waits for one client, streams the packets to it and closes the client connection.
+     * It can be called again to serve the next client, the index continues where it stopped.
+     */
+    void operator()();
+
+    /**
+     * @brief Stop streaming, the client connection is closed afterwards. Safe to call from other thread.
+     */
+    void stop();
+
+    /**
+     * @brief A function to get how many packets were sent to the last client.
+     * @return              The number of packets.
+     */
+    long getFrameSent();
+
+    /**
+     * @brief A function to get the size of one packet in bytes (header+index+data).
+     * @return              The number of bytes.
+     */
+    int getPacketSize();
+
+protected:
+
+    /**
+     * @brief Fill packets_ with the synthetic signals.
+     */
+    void generatePackets();
+
+    /**
+     * @brief Send the whole buffer, send() may only take a part of it.
+     * @return              The number of bytes sent, or SOCKET_ERROR.
+     */
+    int sendAll(const char* buffer, int buffersize);
+};
+
+#endif
@@ -1,8 +1,16 @@
+#ifndef AMODEUSCONNECTION_H
+#define AMODEUSCONNECTION_H
+
 // basic libraries
 #include <stdio.h>
+#include <iostream>
+#include <sstream>
 #include <string>
 #include <vector>
 #include <stdint.h>
+#include <memory>
+#include <atomic>
+#include <mutex>
 
 // this library if for managing file
 #include <filesystem>
@@ -10,23 +18,47 @@
 #include <iterator>
 #include <boost/filesystem.hpp>
 
-// these libraries is for windows connection
-#include <winsock2.h>
-#include <ws2tcpip.h>
-// need to connect the lib that is needed by winsock 
-#pragma comment(lib, "Ws2_32.lib")
-#pragma comment (lib, "Mswsock.lib")
-#pragma comment (lib, "AdvApi32.lib")
+// socket library, winsock on windows and bsd sockets everywhere else
+#include "SocketCompat.h"
 
 // Guillaume's libraries
-// #include "Synch.h"
+#include "Synch.h"
 #include "getTime.h"
 
+// reassembles the packets that tcp splits
+#include "FrameDecoder.h"
+// writes the frames in its own thread
+#include "FrameRecorder.h"
+// the frames before the trigger of an event recording
+#include "FrameHistory.h"
+// the frames which are passed around without copying
+#include "FramePool.h"
+// other consumers of the frames, next to the recorder
+#include "FrameSubscriber.h"
+// envelope and depth of the raw frames while streaming
+#include "FrameStage.h"
+#include "EnvelopeDetector.h"
+#include "DepthEstimator.h"
+// only the probes and samples that are needed
+#include "FrameReducer.h"
+// the frames for other processes
+#include "SharedRingWriter.h"
+// checks the index of the packets for lost frames
+#include "IndexTracker.h"
+// the monotonic timestamps of the frames
+#include "FrameClock.h"
+// latency histograms, only with AMODE_ENABLE_STATS
+#include "PipelineStats.h"
+// pinning and priority of the threads
+#include "ThreadCompat.h"
+
 #include <opencv2/opencv.hpp>
 
 #define DATA_RAW 0
 #define DATA_DEPTH 1
 
+#define RECEIVE_AGAIN -2                    //!< receiveData() on a non-blocking socket without data, call again when it is readable
+
 #ifdef _WIN32
 #define sleep Sleep
 #else
@@ -44,6 +76,27 @@ private:
     std::string ip_;                        //!< IP address of Ultrasound Machine
     std::string port_;                      //!< Port number of Ultrasound Machine
     SOCKET ConnectSocket_;                  //!< Socket which will be used for communication 
+    std::mutex socketmutex_;                //!< Protects ConnectSocket_ against stop() while it is closed or replaced
+    bool kerneltimestamps_ = false;         //!< The socket gives the receive time of the kernel (SO_TIMESTAMPNS)
+    double connecttimeout_ = 3.0;           //!< Seconds connect() may take
+    double stalltimeout_ = 0.0;             //!< Seconds without data until the connection counts as lost, 0 never
+
+    // getting the machine back after the connection was lost, only in operator()()
+    double reconnecttimeout_ = 0.0;         //!< Seconds to keep trying, 0 never reconnects
+    double backoffmin_ = 0.01;              //!< Seconds before the second attempt, doubled after every failed one
+    double backoffmax_ = 0.1;               //!< Longest wait between two attempts
+    int64_t lostat_ = 0;                    //!< FrameClock::now() when the connection was lost, 0 if it is not
+    long countreconnect_ = 0;               //!< Times the frames came again after the connection was lost
+    double lastfirstframe_ = 0.0;           //!< Seconds from losing the connection to the first frame, of the last reconnect
+    double maxfirstframe_ = 0.0;            //!< Same, the worst reconnect
+
+    // the low latency profile
+    bool lowlatency_ = false;               //!< Tune the socket, see setLowLatency()
+    bool busypoll_ = false;                 //!< operator()() spins on a non-blocking recv() instead of sleeping in it
+    int bufferframes_ = 8;                  //!< Whole packets the receive buffer of the kernel holds
+    int receivecore_ = -1;                  //!< Core of the thread of operator()(), -1 anywhere
+    int writercore_ = -1;                   //!< Core of the writer thread of the recorder, -1 anywhere
+    int threadpriority_ = 0;                //!< SCHED_FIFO priority of both threads, 0 normal scheduling
 
 
     // variables that stores amode spesifications
@@ -51,23 +104,89 @@ private:
     int probes_;                            //!< The number of ultrasound probes being used in the experiment (default 30)
     int datalength_;                        //!< samples_ * probes_
     int headersize_ = 4;                    //!< The number of bytes of the header of the data packet
+    bool headersync_ = true;                //!< Check the header of every packet against the first one
     int indexsize_;                         //!< The number of bytes which contains the information of the index (used for indexing)
 
+    // the frames after the region of interest, what everyone downstream gets
+    std::unique_ptr<FrameReducer> reducer_; //!< Cuts every frame down at ingest, nullptr keeps the frames as they are
+    int roisamples_;                        //!< Values per probe of the frames downstream
+    int roiprobes_;                         //!< Probes of the frames downstream
+
 
     // variable that controls the behavior of this class
     bool setrecord_ = false;                //!< flag for setting the status of the record
     bool usedataindex_ = false;             //!< flag for using index 
     bool firstpass_ = true;                 //!< 
     int datamode_ = DATA_RAW;               //!< Mode to interpret data, DATA_RAW and DATA_DEPTH
-    std::string fullpath_;                  //!< Full path to the directory where the data is stored
+    std::string recordname_;                //!< Name of the .csv, .amodedepth or the .amode segments, without extension
+    int recordformat_;                      //!< RECORD_BINARY (default DATA_RAW), RECORD_TIFF, RECORD_CSV or RECORD_COLUMNS (default DATA_DEPTH)
     std::string recorddirectory_;           //!< Local directory where the data is stored
 
-    // for logging data
-    std::ofstream ofs_;                     //!< Object for logging csv data
+    // for logging data, the writing happens in the thread of the recorder
+    std::unique_ptr<FrameRecorder> recorder_; //!< Writer thread, created in operator()() if setrecord_
+    int queuecapacity_ = 256;               //!< How many frames can wait for the disk
+    int queuepolicy_ = QUEUE_BLOCK;         //!< What to do if the disk is too slow and the queue is full
+    int compressthreads_ = 0;               //!< Threads compressing DATA_RAW frames before they are written, 0 is no compression
+    int tiffthreads_ = 0;                   //!< Threads writing the .tiff files of RECORD_TIFF, 0 only the writer thread
+    int recordbackend_ = FILEWRITER_AUTO;   //!< How the .amode segments go to the disk
+    bool recorddirect_ = false;             //!< The .amode segments bypass the page cache
+
+    // event recording, the recorder only gets the frames from pretrigger_ seconds before the trigger on
+    double pretrigger_ = 0.0;               //!< Seconds before the trigger which are recorded, 0 records everything
+    double pretriggerrate_ = 1000.0;        //!< Frames per second the history is sized for
+    bool externaltrigger_ = false;          //!< synch::start() of the mocap system triggers too
+    std::atomic<int64_t> triggerrequest_{ 0 }; //!< FrameClock::now() of trigger(), 0 if nobody triggered yet
+    int64_t triggerat_ = 0;                 //!< When the receiving thread saw the trigger, 0 before
+    std::unique_ptr<FrameHistory> history_; //!< The last frames before the trigger, then the backlog for the recorder
+    long countpretrigger_ = 0;              //!< Frames from before the trigger which went to the recorder
+    long counttriggerlost_ = 0;             //!< Frames after the trigger pushed out of the history, the recorder was too slow for the backlog
+    uint64_t triggerindex_ = 0;             //!< Index of the first frame after the trigger
+
+    // everyone else who wants the frames
+    std::vector<std::unique_ptr<FrameSubscriber>> subscribers_; //!< Get a reference to every frame, see subscribe()
+
+    // the frames computed from the raw frames while streaming
+    std::unique_ptr<EnvelopeDetector> envelopedetector_; //!< Used by the thread of envelope_, created in startStreaming()
+    std::unique_ptr<FrameStage> envelope_;  //!< Computes the envelope frames, created by subscribeEnvelope()
+    double envelopecenter_ = 0.12;          //!< Center frequency of the echo, relative to the sampling frequency
+    double envelopebandwidth_ = 0.08;       //!< Width of the pass band, relative to the sampling frequency
+    double enveloperange_ = 60.0;           //!< Dynamic range in dB of the compressed envelope
+    std::unique_ptr<DepthEstimator> depthestimator_; //!< Used by the thread of depth_, created in startStreaming()
+    std::unique_ptr<FrameStage> depth_;     //!< Computes the depth frames, created by subscribeDepth()
+    int depthfirst_ = 0;                    //!< First sample searched for the echo
+    int depthlast_ = -1;                    //!< Last sample searched for the echo, -1 is the end of the line
+    double depththreshold_ = -40.0;         //!< Weakest echo in dB
+    double depthspacing_ = 1.0;             //!< Depth of one sample
+    double depthoffset_ = 0.0;              //!< Depth of the first sample
+    int depththreads_ = 1;                  //!< Threads estimating one frame
+    double depthbudget_ = 0.0;              //!< Microseconds from arrival to depth, 0 is no budget
+    std::string sharedname_;                //!< Name of the shared memory ring, empty if there is none
+    int sharedslots_ = 256;                 //!< Frames in the shared memory ring
+    std::unique_ptr<SharedRingWriter> shared_; //!< Publishes every frame for other processes, created in startStreaming()
+
+    // the frames, allocated once when the streaming starts
+    std::unique_ptr<FramePool> pool_;       //!< All frames, created in operator()()
+    FrameRef current_;                      //!< The slot the next packet is received in
+
+    // for reassembling the packets from the tcp stream
+    std::unique_ptr<FrameDecoder> decoder_; //!< Staging buffer of one packet, created in operator()()
+    std::unique_ptr<IndexTracker> tracker_; //!< Counts the frames lost before they reached us, created in operator()()
+    int64_t arrival_ = 0;                   //!< FrameClock::now() of the first bytes of the current packet, never goes back
+    FrameClock clock_;                      //!< Converts the receive timestamps of the kernel, anchored in startStreaming()
+    long countkerneltime_ = 0;              //!< Frames timestamped by the kernel
+
+    // latency of the streaming
+    std::string statspath_;                 //!< File for the json lines of the statistics, empty is stdout
+    double statsinterval_ = 0.0;            //!< Seconds between two lines, 0 only at the end
+#ifdef AMODE_ENABLE_STATS
+    std::unique_ptr<PipelineStats> stats_;  //!< Histograms of the stages, created in operator()()
+    int64_t statsarrival_ = 0;              //!< statsNow() of the last complete packet
+    int64_t statsfirstbyte_ = 0;            //!< statsNow() of the first bytes of the current packet
+#endif
 
     // for testing
+    double starttime_ = 0.0;                //!< rtb::getTime() in startStreaming()
     int countdata_ = 0;                     //!< 
-    std::stringstream filename_;            //!< 
 
 public:
 
@@ -99,6 +218,75 @@ public:
 
 
 
+    /**
+     * @brief A function to set how long connecting may take, and when a silent connection counts as lost.
+     * The connect() doesn't block for the timeout of the OS (minutes when the machine is off), it gives up after connect.
+     * The machine streams all the time, so if nothing came for stall seconds the cable or the machine is gone,
+     * without a stall timeout recv() would wait forever for it, because nobody closes the connection.
+     * The constructor connects with the default, connect is for the reconnects (see setReconnect()).
+     *
+     * @param connect       Seconds for connect() (default 3).
+     * @param stall         Seconds without data until the connection is lost, 0 (default) waits forever. Only in operator()().
+     */
+    void setConnectTimeout(double connect, double stall = 0.0);
+
+
+    /**
+     * @brief A function to connect to the machine again when the connection is lost (closed, failed or stalled),
+     * instead of ending the session. The attempts are spaced by a backoff which doubles from backoffmin up to backoffmax,
+     * so a short blip costs little more than the blip, and a machine that is off isn't hammered.
+     * The streaming continues in the same session: the same recorder and files, the same subscribers, the frames
+     * lost in between are a gap of the index (see getIndexTracker()). If the machine wasn't there when the
+     * constructor connected, operator()() tries to connect the same way before it gives up.
+     * Only in operator()(), ConnectionManager ends a connection that is lost.
+     *
+     * @param timeout       Seconds to keep trying after the connection was lost, 0 (default) never reconnects.
+     * @param backoffmin    Seconds between the first two attempts (default 0.01).
+     * @param backoffmax    Longest wait between two attempts (default 0.1), the most the backoff adds to a blip.
+     */
+    void setReconnect(double timeout, double backoffmin = 0.01, double backoffmax = 0.1);
+
+
+    /**
+     * @brief A function to receive with the shortest latency. The receive buffer of the kernel holds bufferframes whole
+     * packets, so a late reader finds them there instead of the machine being throttled, TCP_NODELAY and TCP_QUICKACK
+     * are set (the acks go out right away, TCP_QUICKACK again after every packet since the kernel forgets it).
+     * With busypoll operator()() doesn't sleep in recv(), it asks a non-blocking socket again and again (and the kernel
+     * polls the network card, SO_BUSY_POLL, if it is allowed), the wake-up after a packet is gone but a core is always busy.
+     * Busy polling should run on its own core (setThreads()), the stall timeout of setConnectTimeout() still works.
+     * Compare the latency statistics (setStatsOutput()) of the profiles, every line says which profile it is.
+     *
+     * @param busypoll      Spin on recv() in operator()().
+     * @param bufferframes  Whole packets in the receive buffer (default 8), 0 keeps the default of the OS.
+     */
+    void setLowLatency(bool busypoll, int bufferframes = 8);
+
+
+    /**
+     * @brief A function to keep the threads on their cores, so the scheduler doesn't move them around (and their caches),
+     * and to run them with SCHED_FIFO, so nothing of normal priority takes the core from them.
+     * Pinning works for every user, SCHED_FIFO needs root or CAP_SYS_NICE on linux. If it isn't allowed, it is printed
+     * and the thread runs as usual.
+     *
+     * @param receivecore   Core of the thread that calls operator()(), -1 (default) anywhere.
+     * @param writercore    Core of the writer thread of the recorder, -1 (default) anywhere.
+     * @param priority      SCHED_FIFO priority (1..99) of both threads, 0 (default) normal scheduling.
+     */
+    void setThreads(int receivecore, int writercore = -1, int priority = 0);
+
+
+    /**
+     * @brief A function to turn the header check of the decoder on or off (FrameDecoder::setSyncCheck()).
+     * The decoder assumes the machine sends the same header in every packet (the simulator does), the first header
+     * is the sync word and a packet with another header is taken as a misaligned stream. If the machine is configured
+     * to put something that changes into the header (a counter, a timestamp), every packet would be resynchronised
+     * and thrown away, turn the check off then. On by default, call it before operator()().
+     *
+     * @param flag          Set true to check the header.
+     */
+    void setHeaderSync(bool flag);
+
+
     /**
     * @brief A function to check if the PC and A-mode ultrasound is already connected through TCP.
     * @return              A flag indicating the status.
@@ -123,8 +311,230 @@ public:
     void useDataIndex(bool flag);
 
 
+    /**
+     * @brief A function to set how many frames can wait for the disk, and what happens when the disk is too slow.
+     * The frames are written by a separate thread, the thread reading the socket only puts them in a queue.
+     *
+     * @param capacity      Number of frames in the queue (default 256).
+     * @param policy        QUEUE_BLOCK (default, wait for the disk), QUEUE_DROP_OLDEST or QUEUE_DROP_NEWEST.
+     */
+    void setRecordQueue(int capacity, int policy);
+
+
+    /**
+     * @brief A function to set how the streamed data is stored.
+     * RECORD_BINARY appends all frames to a few big .amode files (see AModeRecording.h), this is the default for DATA_RAW.
+     * RECORD_TIFF is the old way for DATA_RAW, one <timestamp>_<index>.tiff per frame.
+     * RECORD_COLUMNS is the default for DATA_DEPTH, one .amodedepth file with the frames in blocks of columns
+     * (see AModeDepthLog.h), AModeDepthExport turns it into the .csv afterwards.
+     * RECORD_CSV is the old way for DATA_DEPTH, one line per frame written while streaming.
+     *
+     * @param format        RECORD_BINARY, RECORD_TIFF, RECORD_CSV or RECORD_COLUMNS.
+     */
+    void setRecordFormat(int format);
+
+
+    /**
+     * @brief A function to compress the DATA_RAW frames without loss before they are written (RECORD_BINARY only).
+     * A raw frame is 90 KB, an hour of streaming is hundreds of GB, but the echo is very redundant.
+     * The encoding runs on its own threads, more threads are needed for higher frame rates.
+     *
+     * @param threads       Threads encoding in parallel, 0 (default) writes the frames as they are.
+     */
+    void setRecordCompression(int threads);
+
+
+    /**
+     * @brief A function to write the .tiff files of RECORD_TIFF on several threads, for higher frame rates.
+     * The files are the same <timestamp>_<index>.tiff as before, the name says which frame it is, only the order
+     * in which they appear in the directory is not the order of the frames within a batch (a few frames).
+     *
+     * @param threads       Threads encoding and writing in parallel, 0 (default) writes them one after the other.
+     */
+    void setRecordTiffThreads(int threads);
+
+
+    /**
+     * @brief A function to choose how the .amode segments go to the disk (RECORD_BINARY only).
+     * By default they are written with io_uring if the kernel has it (linux 5.1 and newer), a few big buffers are on
+     * their way to the disk while the next one is filled, otherwise (and on windows) with fwrite().
+     * The segments are preallocated in both cases.
+     *
+     * @param backend       FILEWRITER_AUTO (default), FILEWRITER_BUFFERED or FILEWRITER_IOURING.
+     * @param direct        Bypass the page cache with O_DIRECT (io_uring only), the recording doesn't push
+     *                      everything else out of the memory, but the disk has to keep up on its own.
+     */
+    void setRecordBackend(int backend, bool direct = false);
+
+
+    /**
+     * @brief A function to keep only the region of interest of the DATA_RAW frames, right where they come in: some of the
+     * probes, a window of every line and optionally every decimation-th sample (after an anti-alias low-pass, see FrameReducer).
+     * The recorder, the subscribers, the envelope, the depth and the shared ring only get the reduced frames, as if the
+     * machine had sent probes x samples of that size, the packet is received in the staging buffer of the decoder.
+     * The recording has the real geometry and the region in its metadata (roi.*), the footer of the .amode segments
+     * or, for RECORD_TIFF, the <name>.meta file in the directory of the .tiff files.
+     * Call it before subscribeEnvelope() and subscribeDepth(), their frames have the reduced geometry too.
+     *
+     * @param probes        The probes to keep (from 0), in the order of the reduced frame. Empty keeps all.
+     * @param first         First sample of the window, one for all probes or one per kept probe. Empty starts at 0.
+     * @param length        Samples of every window, -1 (default) up to the end of the line.
+     * @param decimation    Keep every decimation-th sample of the window, 1 (default) keeps all.
+     * @return              A flag indicating the status. -1 if the region doesn't fit the frames or for DATA_DEPTH.
+     */
+    int setRegionOfInterest(std::vector<int> probes, std::vector<int> first, int length = -1, int decimation = 1);
+
+
+    /**
+     * @brief A function to record only an event, but with what happened before it: the frames of the last seconds are
+     * kept in memory all the time (a ring of references to the pool, its memory is allocated when the streaming starts),
+     * nothing is written until the trigger. Then the frames of the seconds before the trigger go to the recorder,
+     * followed by the live frames without a gap. The backlog is handed over only as fast as the queue of the recorder
+     * takes it without waiting, so the socket is never held up, the live frames wait behind it in the same ring.
+     * The trigger is trigger(), or synch::start() of the mocap system if external is set.
+     * The recording has the trigger in its metadata (trigger.*). Only the recorder waits for the trigger, the subscribers,
+     * the stages and the shared ring get every frame.
+     *
+     * @param seconds       Seconds before the trigger which are recorded, 0 (default) records the whole session.
+     * @param framerate     Frames per second of the machine, the history holds seconds * framerate frames and some more.
+     * @param external      Start on synch::start() too.
+     */
+    void setPreTrigger(double seconds, double framerate = 1000.0, bool external = false);
+
+    /**
+     * @brief Starts the recording of an event (see setPreTrigger()), from any thread. Only the first trigger counts.
+     */
+    void trigger();
+
+    /**
+     * @brief A function to know if the event recording was triggered.
+     * @return              True once trigger() was called (or synch::start() with an external trigger).
+     */
+    bool isTriggered();
+
+
+    /**
+     * @brief A function to get the frames in your own code, e.g. for live processing or monitoring while recording.
+     * Every subscriber has its own queue, when it is full the subscriber loses frames, the socket and the other
+     * subscribers never wait for it. Nothing is copied, the subscribers and the recorder look at the same frame.
+     * Subscribe before the streaming starts, the connection owns the subscriber.
+     *
+     * @param capacity      How many frames can wait for the subscriber.
+     * @param policy        QUEUE_DROP_OLDEST (default, the latest frames are kept) or QUEUE_DROP_NEWEST.
+     * @return              The subscriber, take the frames with pop() from one thread.
+     */
+    FrameSubscriber* subscribe(size_t capacity = 64, int policy = QUEUE_DROP_OLDEST);
+
+    /**
+     * @brief Same as subscribe(), but the subscriber has its own thread which calls callback for every frame.
+     *
+     * @param callback      Gets the frame, read only, it is still used by others.
+     * @param capacity      How many frames can wait for the callback.
+     * @param policy        QUEUE_DROP_OLDEST (default) or QUEUE_DROP_NEWEST.
+     * @return              The subscriber, for its counters.
+     */
+    FrameSubscriber* subscribe(FrameCallback callback, size_t capacity = 64, int policy = QUEUE_DROP_OLDEST);
+
+
+    /**
+     * @brief A function to get the envelope of the raw frames while streaming (DATA_RAW only), instead of computing it
+     * in every consumer. Every probe line is band-pass filtered, Hilbert transformed and log-compressed (see EnvelopeDetector),
+     * with AVX2 if the CPU has it. The envelope frames are probes x samples uint16_t, with the timestamp and index of the raw frame.
+     * The detector has its own thread, it is a subscriber of the raw frames, if it is too slow it loses frames, not the socket.
+     *
+     * @param capacity      How many envelope frames can wait for the subscriber.
+     * @param policy        QUEUE_DROP_OLDEST (default) or QUEUE_DROP_NEWEST.
+     * @return              The subscriber, take the envelope frames with pop() from one thread. nullptr for DATA_DEPTH.
+     */
+    FrameSubscriber* subscribeEnvelope(size_t capacity = 64, int policy = QUEUE_DROP_OLDEST);
+
+    /**
+     * @brief Same as subscribeEnvelope(), but the subscriber has its own thread which calls callback for every envelope frame.
+     *
+     * @param callback      Gets the envelope frame, read only.
+     * @param capacity      How many envelope frames can wait for the callback.
+     * @param policy        QUEUE_DROP_OLDEST (default) or QUEUE_DROP_NEWEST.
+     * @return              The subscriber, for its counters. nullptr for DATA_DEPTH.
+     */
+    FrameSubscriber* subscribeEnvelope(FrameCallback callback, size_t capacity = 64, int policy = QUEUE_DROP_OLDEST);
+
+    /**
+     * @brief A function to configure the envelope (see subscribeEnvelope()), the default fits the simulator.
+     *
+     * @param center        Center frequency of the echo, relative to the sampling frequency.
+     * @param bandwidth     Width of the pass band, relative to the sampling frequency.
+     * @param range         Dynamic range in dB of the compressed envelope.
+     */
+    void setEnvelopeFilter(double center, double bandwidth, double range);
+
+
+    /**
+     * @brief A function to get the depths from the raw frames while streaming, the same as DATA_DEPTH but without the
+     * ultrasound PC computing them, so one connection gives raw frames and depths (see DepthEstimator).
+     * The depth frames are probes x 2 double (depth, amplitude in dB), with the timestamp and index of the raw frame.
+     * The estimation has its own thread (and helpers, see setDepthThreads()), if it is too slow it loses frames, not the socket.
+     *
+     * @param capacity      How many depth frames can wait for the subscriber.
+     * @param policy        QUEUE_DROP_OLDEST (default) or QUEUE_DROP_NEWEST.
+     * @return              The subscriber, take the depth frames with pop() from one thread. nullptr for DATA_DEPTH.
+     */
+    FrameSubscriber* subscribeDepth(size_t capacity = 64, int policy = QUEUE_DROP_OLDEST);
+
+    /**
+     * @brief Same as subscribeDepth(), but the subscriber has its own thread which calls callback for every depth frame.
+     *
+     * @param callback      Gets the depth frame, read only.
+     * @param capacity      How many depth frames can wait for the callback.
+     * @param policy        QUEUE_DROP_OLDEST (default) or QUEUE_DROP_NEWEST.
+     * @return              The subscriber, for its counters. nullptr for DATA_DEPTH.
+     */
+    FrameSubscriber* subscribeDepth(FrameCallback callback, size_t capacity = 64, int policy = QUEUE_DROP_OLDEST);
+
+    /**
+     * @brief A function to configure the search of the echo (see subscribeDepth()). The envelope is configured with setEnvelopeFilter().
+     *
+     * @param first         First sample searched, e.g. behind the ringing of the transducer.
+     * @param last          Last sample searched, -1 is the end of the line.
+     * @param threshold     Weakest echo in dB against the reference, weaker ones give DEPTH_NOECHO.
+     * @param spacing       Depth of one sample, 1 (default) gives the depth in samples.
+     * @param offset        Depth of the first sample.
+     */
+    void setDepthEstimation(int first, int last, double threshold, double spacing = 1.0, double offset = 0.0);
+
+    /**
+     * @brief A function to share the probes of a frame between threads, for a higher frame rate or a shorter latency.
+     *
+     * @param threads       Threads estimating one frame, including the thread of the stage.
+     * @param budget        Microseconds from the arrival of the raw frame to the depth, the frames over it are counted. 0 counts nothing.
+     */
+    void setDepthThreads(int threads, double budget = 0.0);
+
+
+    /**
+     * @brief A function to publish every frame in shared memory, so other processes on this PC (tracking, visualisation)
+     * get the frames live with SharedRingReader, without files and without copying them again.
+     * The ring has slots frames, a reader which is further behind loses frames, nobody waits for the readers.
+     *
+     * @param name          Name of the ring, the readers open it with this name. Empty (default) publishes nothing.
+     * @param slots         Frames the ring holds.
+     */
+    void setSharedRing(std::string name, int slots = 256);
+
+
+    /**
+     * @brief A function to configure where the latency statistics go (inter-arrival time, receiving, waiting in the queue
+     * of the recorder and writing), they are json lines with p50/p99/p99.9/max of every stage.
+     * Only when built with AMODE_ENABLE_STATS, otherwise there is nothing measured at all.
+     *
+     * @param path          File the lines are appended to, empty (default) prints to the console.
+     * @param interval      Seconds between two lines, 0 (default) only at the end of the streaming.
+     */
+    void setStatsOutput(std::string path, double interval);
+
+
     /**
      * @brief A function to specify the where the streamed data will be stored.
+     * The .csv, .amodedepth or the .amode segments are named with the current timestamp.
      *
      * @param directory     Path to the directory.
      * @return              A flag indicating the status. -1 if there is something wrong.
@@ -134,8 +544,8 @@ public:
 
     /**
      * @brief An alternative function to specify where the streamed data will be stored with custom file name.
-     * This is used when you specify DATA_DEPTH for streaming mode, so that you can specify your own .csv file name.
-     * However, you can't use this for DATA_RAW, since the naming is predetermined using timestamp and index.
+     * This is used for the .csv or .amodedepth file (DATA_DEPTH) or the .amode segments (<filename>_0000.amode, ...).
+     * However, you can't use this for RECORD_TIFF, since the naming is predetermined using timestamp and index.
      *
      * @param directory Path to directory.
      * @param filename Filename.
@@ -155,50 +565,91 @@ public:
 
 
     /**
-     * @brief A function to receive the data for DATA_RAW mode.
-     * Each data packet is a long array of unit16_t, with the number (samples_ * probes_).
-     * Raw data will be converted into uint16_t then stored to .TIFF file. OpenCV is used in
-     * this process since they are very effective in storing big image.
+     * @brief A function to receive the data, for DATA_RAW and DATA_DEPTH mode.
+     * Each data packet is a long array of unit16_t (DATA_RAW, samples_ * probes_ values) or of double (DATA_DEPTH).
+     * One call is one recv(), TCP can split a packet, so the packet is reassembled by decoder_, directly in a
+     * slot of the frame pool. When the packet is complete, frame refers to that slot, nothing is copied, and the
+     * recorder gets another reference to the same slot. The slot goes back to the pool when nobody refers to it.
      *
-     * @param ultrasound_frd    A pointer to array of unit16_t where the A-mode Ultrasound raw signal is stored.
-     * @param receivebuffer     A temporary buffer that we will use for store binary string from socket.
-     *                          The A-mode ultrasound machine always send full data (header+index+data)
-     *                          so we need to accomodate the full data.
-     * @param receivebuffersize The byte size of recievebuffer (all, header+index+data).
-     * @param datasize          The byte size of data (only data without header and index).
-     * @param headerindexsize   This will be used to skip or not to skip the bytes that represent the
-     *                          index so if the user specified useDataIndex(true), it means we do not skip the index
-     *                          byte thus the headerindexsize is only the size of headersize_
-     * @return                  A flag indicating the status. >0 means there is data, 0 means the connection is closed, -1 means there is something wrong.
+     * @param frame         Receives the reference to the frame when a packet is complete, the values are (*frame)->data.
+     *                      It is empty if the pool had no free slot for this packet.
+     * @return              A flag indicating the status. >0 means there is data, 0 means the connection is closed, -1 means there is something wrong,
+     *                      RECEIVE_AGAIN means the socket is non-blocking and has no data now.
+     */
+    int receiveData(FrameRef* frame);
+
+    /**
+     * @brief A function that is used for multithreading.
+     * Here, receiveData() will be invoked. Several data specification is configured also in this funuction.
+     * It is startStreaming(), receiveData() until the connection is closed, then stopStreaming().
+     */
+    void operator()();
+
+    /**
+     * @brief A function to prepare everything for receiveData() (frame pool, decoder, recorder, ...),
+     * for when the loop is not operator()() but e.g. ConnectionManager.
      */
-    int receiveData(std::vector<uint16_t>* ultrasound_frd, char* receivebuffer, int receivebuffersize, int datasize, int headerindexsize);
-    
+    void startStreaming();
 
     /**
-     * @brief A function to receive the data for DATA_DEPTH mode.
-     * Each data packet is a long array of double, with the number of probes_. Depth data will be stored in .csv file.
+     * @brief A function to finish after the last receiveData(), it closes the socket, prints the summary and
+     * writes what the recorder still has.
+     */
+    void stopStreaming();
+
+    /**
+     * @brief A function to get the socket, e.g. to wait for it together with other sockets.
+     * @return              The socket, INVALID_SOCKET if the connection failed.
+     */
+    SOCKET getSocket();
+
+    /**
+     * @brief A function to get how many complete frames have been received since operator()() started.
+     * Compare it with the number of frames the machine (or the simulator) sent to know how many were dropped.
      *
-     * @param ultrasound_frd    A pointer to array of unit16_t where the A-mode Ultrasound raw signal is stored.
-     * @param receivebuffer     A temporary buffer that we will use for store binary string from socket.
-     *                          The A-mode ultrasound machine always send full data (header+index+data)
-     *                          so we need to accomodate the full data.
-     * @param receivebuffersize The byte size of recievebuffer (all, header+index+data).
-     * @param datasize          The byte size of data (only data without header and index).
-     * @param headerindexsize   This will be used to skip or not to skip the bytes that represent the
-     *                          index so if the user specified useDataIndex(true), it means we do not skip the index
-     *                          byte thus the headerindexsize is only the size of headersize_
-     * @return                  A flag indicating the status. >0 means there is data, 0 means the connection is closed, -1 means there is something wrong.
+     * @return              The number of complete frames.
      */
-    int receiveData(std::vector<double>* ultrasound_frd, char* receivebuffer, int receivebuffersize, int datasize, int headerindexsize);
+    int getFrameCount();
 
     /**
-     * @brief A function that is used for multithreading.
-     * Here, receiveData() will be invoked. Several data specification is configured also in this funuction.
+     * @brief A function to get how many times the stream was misaligned and had to be resynchronised on the header.
+     * @return              The number of resynchronisations.
+     */
+    long getResyncCount();
+
+    /**
+     * @brief A function to get what happened to the index of the packets: gaps (frames lost before they reached
+     * this PC), duplicates and reordered frames, loss rate per second and the missing ranges.
+     * Frames that were received but not recorded are counted by the recorder, not here.
      *
+     * @return              The tracker, nullptr before operator()() started.
      */
-    void operator()();
+    IndexTracker* getIndexTracker();
+
+    /**
+     * @brief A function to get how many times the frames came again after the connection was lost.
+     * @return              The number of reconnects.
+     */
+    long getReconnectCount();
+
+    /**
+     * @brief A function to get the time from losing the connection to the first complete frame afterwards,
+     * this is the data lost by a blip (besides what the machine sends while it is really gone).
+     *
+     * @param worst         The worst reconnect if true, otherwise the last one.
+     * @return              Seconds, 0 if there was no reconnect.
+     */
+    double getReconnectTime(bool worst = true);
+
+    /**
+     * @brief A function to end the streaming from another thread, e.g. a control thread which waits for
+     * synch::waitStop() (ctrl+c with synch::installSignalHandler()) or for a key. A recv() waiting for the machine
+     * is woken up, so the streaming ends in bounded time even if no frame comes, operator()() still finishes
+     * with stopStreaming() and the recording is complete.
+     */
+    void stop();
 
-    bool userquit_ = false;                     //!< A flag which specified if the user wants to exit
+    std::atomic<bool> userquit_{ false };       //!< A flag which specified if the user wants to exit, set by stop()
 
 protected:
 
@@ -209,15 +660,60 @@ protected:
      * which can be found in. https://docs.microsoft.com/en-us/windows/win32/winsock/getting-started-with-winsock
      *
      * @param ConnectSocket     Pointer to socket object, which will be used in the entire code for data streaming.
+     * @param quiet             Don't print that the machine is not there, for the attempts of reconnect().
      * @return                  A flag indicating the status. 0 if connection is successfully made, -1 if there is something wrong.
      */
-    int connectTCP(SOCKET* ConnectSocket);
+    int connectTCP(SOCKET* ConnectSocket, bool quiet = false);
 
     /**
-     * @brief If user pressed ESC, program halts and finished
-    */
-    bool checkKeyPressed()
-    {
-        return (GetKeyState(VK_ESCAPE) & 0x8000);
-    }
-};
\ No newline at end of file
+     * @brief Closes the lost connection and connects again, with the backoff of setReconnect().
+     * The partial packet is thrown away, everything else continues.
+     *
+     * @return                  A flag indicating the status. 0 if connected again, -1 if it gave up (or the user quit).
+     */
+    int reconnect();
+
+    /**
+     * @brief Shuts down and closes the socket, if there is one.
+     */
+    void closeTCP();
+
+    /**
+     * @brief Sets the socket options of the low latency profile on the connected socket (see setLowLatency()).
+     */
+    void tuneSocket();
+
+    /**
+     * @brief Name of the profile for the latency statistics, e.g. "busypoll,pinned,fifo".
+     */
+    std::string getProfileName();
+
+    /**
+     * @brief Takes the next slot from the pool and lets the decoder receive the next packet in it.
+     */
+    void nextSlot();
+
+    /**
+     * @brief Hands a complete frame to the recorder, or to the history while an event recording waits for its trigger.
+     * @param frame         The frame.
+     */
+    void recordFrame(const FrameRef& frame);
+
+    /**
+     * @brief Gives the backlog of the history to the recorder, as much as the queue takes without waiting.
+     * @param all           Everything, the recorder may make us wait (at the end of the streaming).
+     */
+    void flushHistory(bool all);
+
+    /**
+     * @brief A stage of the raw frames (envelope_ or depth_), created the first time it is needed.
+     *
+     * @param stage         The member that holds it.
+     * @param name          Name for the console.
+     * @param outputsize    Bytes of an output frame.
+     * @return              nullptr for DATA_DEPTH, there is no echo to compute anything of.
+     */
+    FrameStage* rawStage(std::unique_ptr<FrameStage>& stage, std::string name, int outputsize);
+};
+
+#endif
@@ -0,0 +1,165 @@
+#ifndef ASYNCFILEWRITER_H
+#define ASYNCFILEWRITER_H
+
+// basic libraries
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#define FILEWRITER_AUTO -1                  //!< io_uring if the kernel has it, otherwise buffered
+#define FILEWRITER_BUFFERED 0               //!< fwrite(), waits until the OS took the batch
+#define FILEWRITER_IOURING 1                //!< io_uring (linux 5.1 and newer), the batches are written while the next ones are filled
+
+#define FILEWRITER_ALIGNMENT 4096           //!< Alignment of the buffers, and of every batch with O_DIRECT
+
+/**
+ * @brief AsyncFileWriter appends big batches to one file, so the writer doesn't wait for the disk for every batch.
+ * The caller fills the buffer of getBuffer() and gives it away with submit(), then fills the next buffer.
+ * With FILEWRITER_IOURING there are a few buffers, submit() only queues the write in the io_uring of the kernel
+ * (no liburing, only the three syscalls) and waits only when all buffers are still being written.
+ * With FILEWRITER_BUFFERED there is one buffer and submit() is a fwrite(), the way it always was (and on windows).
+ *
+ * The file can be preallocated (fallocate() without changing the size), so the filesystem doesn't have to find new
+ * blocks in the middle of a long session, and opened with O_DIRECT, so the batches don't go through the page cache.
+ * For O_DIRECT every batch but the last one has to be a whole buffer, the last one is padded and cut in close().
+ * With io_uring a file can be closed without waiting for its last batches, so the next segment starts right away,
+ * it is really closed when they are on the disk. Its failures are its own, they are told by the next close().
+ * Not thread safe, it is used only by the writer thread.
+ */
+class AsyncFileWriter
+{
+
+private:
+    // configuration
+    int backend_ = FILEWRITER_AUTO;         //!< What was asked for
+    bool direct_ = false;                   //!< Open with O_DIRECT (io_uring only)
+    size_t buffersize_ = 8 << 20;           //!< Bytes of a buffer, multiple of FILEWRITER_ALIGNMENT
+    int inflight_ = 4;                      //!< Buffers, so writes in flight with io_uring
+
+    // the file
+    int active_ = FILEWRITER_BUFFERED;      //!< Backend of the open file
+    FILE* file_ = nullptr;                  //!< FILEWRITER_BUFFERED
+    int fd_ = -1;                           //!< FILEWRITER_IOURING
+    std::string path_;                      //!< Path of the open file
+    bool directopen_ = false;               //!< The open file has O_DIRECT
+    bool preallocated_ = false;             //!< The open file has blocks reserved behind its end
+    uint64_t offset_ = 0;                   //!< Bytes submitted, where the next batch goes
+    bool padded_ = false;                   //!< The last batch was padded to the alignment
+    bool failed_ = false;                   //!< A write failed since open()
+
+    // the file before, closed without waiting
+    int closingfd_ = -1;                    //!< Still has writes in flight, -1 if there is none
+    uint64_t closingsize_ = 0;              //!< Bytes it was given
+    bool closingtruncate_ = false;          //!< It has to be cut to closingsize_
+    std::string closingpath_;               //!< Path of it, for the messages
+    bool closingfailed_ = false;            //!< A write of it failed
+    bool closefailed_ = false;              //!< A file closed without waiting failed, the next close() returns -1
+
+    // the buffers
+    std::vector<char> memory_;              //!< All buffers, with room to align them
+    std::vector<char*> buffers_;            //!< Start of every buffer
+    std::vector<bool> busy_;                //!< The buffer is being written
+    int current_ = 0;                       //!< Buffer being filled
+
+    // io_uring, mapped from the kernel in open()
+    struct Ring;
+    Ring* ring_ = nullptr;                  //!< nullptr if not FILEWRITER_IOURING
+
+public:
+
+    AsyncFileWriter();
+
+    ~AsyncFileWriter();
+
+    /**
+     * @brief Which backend the next open() uses.
+     *
+     * @param backend       FILEWRITER_AUTO (default), FILEWRITER_BUFFERED or FILEWRITER_IOURING.
+     * @param direct        Bypass the page cache with O_DIRECT (io_uring only, the filesystem has to support it).
+     */
+    void setBackend(int backend, bool direct = false);
+
+    /**
+     * @brief Size and number of the buffers, call before open().
+     *
+     * @param buffersize    Bytes of a batch, rounded up to FILEWRITER_ALIGNMENT.
+     * @param inflight      Batches written at the same time (io_uring only, buffered has one buffer).
+     */
+    void setBuffers(size_t buffersize, int inflight);
+
+    /**
+     * @brief Creates the file and takes the buffers (only the first time).
+     *
+     * @param path          Path of the file, it is overwritten.
+     * @param preallocate   Bytes reserved on the disk for the file, 0 for nothing. The size of the file doesn't change.
+     * @return              A flag indicating the status. -1 if the file can't be created.
+     */
+    int open(const std::string& path, uint64_t preallocate = 0);
+
+    /**
+     * @brief The buffer to fill next, getBufferSize() bytes.
+     */
+    char* getBuffer();
+
+    /**
+     * @brief Writes the filled buffer behind the last one, getBuffer() gives the next buffer afterwards.
+     * @param size          Bytes of the buffer to write. Less than getBufferSize() only for the last batch with O_DIRECT.
+     * @return              A flag indicating the status. -1 if this or an earlier write failed.
+     */
+    int submit(size_t size);
+
+    /**
+     * @brief Cuts the file to the bytes submitted and closes it.
+     * @param wait          Wait for the writes in flight (default). If false, they finish while the next file is written,
+     *                      and the file is closed by the first submit() or close() after them.
+     * @return              A flag indicating the status. -1 if a write of this file failed, or of a file closed
+     *                      without waiting before it, which was not told yet (the messages say which file it was).
+     */
+    int close(bool wait = true);
+
+    bool isOpen();                          //!< A file is open
+    size_t getBufferSize();                 //!< Bytes of a buffer
+    int getBackend();                       //!< Backend of the open file, FILEWRITER_BUFFERED or FILEWRITER_IOURING
+    uint64_t getOffset();                   //!< Bytes submitted to the open file
+
+    /**
+     * @brief Checks if the kernel lets us create an io_uring (not before linux 5.1, not if it is disabled, never on windows).
+     */
+    static bool hasIoUring();
+
+protected:
+
+    /**
+     * @brief Creates the io_uring and maps its rings.
+     * @return              A flag indicating the status. -1 if there is no io_uring.
+     */
+    int openRing();
+
+    /**
+     * @brief Unmaps and closes the io_uring.
+     */
+    void closeRing();
+
+    /**
+     * @brief Closes the file closed without waiting, if its writes are done. A failure is kept for the next close().
+     * @param wait          Wait for its writes.
+     * @return              A flag indicating the status. -1 if a write or closing failed.
+     */
+    int finishClose(bool wait);
+
+    /**
+     * @brief Puts the write of a buffer (what is left of it) into the submission ring and tells the kernel.
+     * @return              A flag indicating the status. -1 if the kernel refused it.
+     */
+    int queueWrite(int buffer);
+
+    /**
+     * @brief Takes the finished writes from the completion ring, waits for one if buffer is still being written.
+     * @param buffer        The buffer to wait for, -1 to wait for all.
+     * @return              A flag indicating the status. -1 if a write failed.
+     */
+    int reap(int buffer);
+};
+
+#endif
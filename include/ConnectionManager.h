@@ -0,0 +1,78 @@
+#ifndef CONNECTIONMANAGER_H
+#define CONNECTIONMANAGER_H
+
+// basic libraries
+#include <stdio.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+#include "AModeUSConnection.h"
+
+#define MANAGER_READBUDGET 16               //!< recv() per connection and wakeup, so one busy machine can't starve the others
+#define MANAGER_TIMEOUT 100                 //!< Milliseconds an event loop waits before it checks stop()
+
+/**
+ * @brief ConnectionManager streams several A-mode machines from one thread (or a few), instead of one
+ * thread per AModeUSConnection. The sockets are made non-blocking and an event loop waits for all of them
+ * at once (epoll on linux, poll everywhere else), then reads from the ones which have data.
+ * Every connection keeps its own decoder, index tracker, frame pool and recorder, only the waiting is shared.
+ *
+ * With more than one event loop the connections are dealt out round robin, each loop has its own
+ * connections, so nothing is shared between the loops. The recorders still have their own threads,
+ * and with QUEUE_BLOCK a slow disk of one machine stalls all the machines of its loop, so use a drop policy.
+ */
+class ConnectionManager
+{
+
+private:
+    std::vector<AModeUSConnection*> connections_; //!< Not owned
+    int loops_;                             //!< Number of event loops
+    std::atomic<bool> stop_{ false };       //!< Set by stop()
+    std::atomic<long> countwakeup_{ 0 };    //!< How many times the loops woke up with something to read
+
+public:
+
+    /**
+     * @brief Constructor of the manager.
+     * @param loops         Threads with an event loop, 1 streams everything from the thread of operator()().
+     */
+    ConnectionManager(int loops = 1);
+
+    /**
+     * @brief Adds a connection, before operator()(). Configure it (setRecord(), setDirectory(), ...) as if it had its own thread.
+     * @param connection    The connection, it has to live longer than operator()() runs.
+     */
+    void add(AModeUSConnection* connection);
+
+    /**
+     * @brief Streams all connections until all of them are closed or stop() is called.
+     * The first event loop runs in this thread, the others in their own.
+     */
+    void operator()();
+
+    /**
+     * @brief Lets all event loops finish within MANAGER_TIMEOUT, from any thread.
+     */
+    void stop();
+
+    size_t getConnectionCount();            //!< Connections added
+    int getLoopCount();                     //!< Event loops
+    long getWakeupCount();                  //!< Times an event loop woke up with readable sockets
+
+protected:
+
+    /**
+     * @brief One event loop, until all its connections are closed or stop().
+     * @param connections   The connections of this loop.
+     */
+    void eventLoop(std::vector<AModeUSConnection*> connections);
+
+    /**
+     * @brief Reads what a readable socket has, at most MANAGER_READBUDGET times.
+     * @return              False if the connection is closed or broken.
+     */
+    bool readConnection(AModeUSConnection* connection);
+};
+
+#endif
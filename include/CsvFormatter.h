@@ -0,0 +1,141 @@
+#ifndef CSVFORMATTER_H
+#define CSVFORMATTER_H
+
+// basic libraries
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <charconv>
+
+/**
+ * @brief CsvFormatter writes numbers as text into a buffer which it owns, with std::to_chars: no locale, no stream state,
+ * no temporary strings, and the shortest text that reads back to exactly the same double.
+ * With a file (open()) the buffer is written with one fwrite() whenever it is full, the buffer is taken in the
+ * constructor and nothing is allocated after that. Without a file the text stays in the buffer (data(), size(),
+ * clear()), which grows if needed, that is how the exporter formats the blocks on several threads.
+ *
+ * Every field is followed by ',' and endLine() ends the line, the same lines the recorder always wrote:
+ * timestamp,[index,]value,value,...,value,
+ */
+class CsvFormatter
+{
+
+private:
+    std::vector<char> buffer_;              //!< The text
+    size_t size_ = 0;                       //!< Bytes used in buffer_
+    FILE* file_ = nullptr;                  //!< Where the full buffer goes, nullptr to keep the text
+    bool failed_ = false;                   //!< A write to the file failed, kept until the next open()
+
+public:
+
+    /**
+     * @brief Constructor of the formatter, takes all the memory.
+     * @param buffersize    Bytes of text collected before they are written.
+     */
+    CsvFormatter(size_t buffersize = 1 << 20) : buffer_(buffersize) {}
+
+    ~CsvFormatter() { close(); }
+
+    /**
+     * @brief Creates the file the text goes to.
+     * @return              A flag indicating the status. -1 if the file can't be created.
+     */
+    int open(const std::string& path) {
+        close();
+        failed_ = false;
+        file_ = fopen(path.c_str(), "wb");
+        if (file_ == nullptr) return -1;
+
+        // we do the buffering ourselves
+        setvbuf(file_, NULL, _IONBF, 0);
+        return 0;
+    }
+
+    /**
+     * @brief Writes what is left in the buffer and closes the file.
+     * @return              A flag indicating the status. -1 if writing failed.
+     */
+    int close() {
+        if (file_ == nullptr) return 0;
+        int iResult = flush();
+        if (fclose(file_) != 0) iResult = -1;
+        file_ = nullptr;
+        return iResult;
+    }
+
+    /**
+     * @brief Writes the buffer to the file, nothing happens without a file.
+     * @return              A flag indicating the status. -1 if this or any earlier write failed, also the ones
+     *                      of a full buffer while adding fields.
+     */
+    int flush() {
+        if (file_ != nullptr && size_ != 0) {
+            size_t size = size_;
+            size_ = 0;
+            if (fwrite(buffer_.data(), 1, size, file_) != size) failed_ = true;
+        }
+        return failed_ ? -1 : 0;
+    }
+
+    /**
+     * @brief Nanoseconds as seconds with all 9 decimals, exact for any int64_t (a double is not below the microsecond).
+     */
+    void addTime(int64_t nanoseconds) {
+        char* text = reserve(32);
+        uint64_t magnitude = (uint64_t)nanoseconds;
+        if (nanoseconds < 0) {
+            *text++ = '-';
+            magnitude = 0 - magnitude;
+        }
+        text = std::to_chars(text, text + 24, magnitude / 1000000000).ptr;
+        *text++ = '.';
+        uint32_t fraction = (uint32_t)(magnitude % 1000000000);
+        for (int d = 8; d >= 0; d--) {
+            text[d] = (char)('0' + fraction % 10);
+            fraction /= 10;
+        }
+        text[9] = ',';
+        size_ = text + 10 - buffer_.data();
+    }
+
+    void addInteger(uint64_t value) {
+        char* text = reserve(32);
+        text = std::to_chars(text, text + 31, value).ptr;
+        *text++ = ',';
+        size_ = text - buffer_.data();
+    }
+
+    void addDouble(double value) {
+        char* text = reserve(32);
+        text = std::to_chars(text, text + 31, value).ptr;
+        *text++ = ',';
+        size_ = text - buffer_.data();
+    }
+
+    void endLine() {
+        *reserve(1) = '\n';
+        size_++;
+    }
+
+    const char* data() const { return buffer_.data(); }   //!< The text (without a file)
+    size_t size() const { return size_; }                 //!< Bytes of text
+    void clear() { size_ = 0; }                           //!< Forget the text, the buffer is kept
+
+protected:
+
+    /**
+     * @brief Makes room for bytes more bytes, writes the buffer first if there is a file, otherwise grows it.
+     * A failed write is remembered (failed_), flush() and close() return it.
+     * @return              Where the text goes.
+     */
+    char* reserve(size_t bytes) {
+        if (size_ + bytes > buffer_.size()) {
+            flush();
+            if (size_ + bytes > buffer_.size()) buffer_.resize(2 * buffer_.size() + bytes);
+        }
+        return buffer_.data() + size_;
+    }
+};
+
+#endif
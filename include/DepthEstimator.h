@@ -0,0 +1,112 @@
+#ifndef DEPTHESTIMATOR_H
+#define DEPTHESTIMATOR_H
+
+// basic libraries
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include <memory>
+
+#include "EnvelopeDetector.h"
+#include "WorkerPool.h"
+
+#define DEPTH_VALUES 2                      //!< Values per probe, the same as DATA_DEPTH: depth and amplitude
+#define DEPTH_NOECHO -1.0                   //!< Depth of a probe which sees no echo above the threshold
+
+/**
+ * @brief DepthEstimator finds the echo (the bone) in every probe line of a raw frame, so DATA_RAW gives the depths
+ * without the ultrasound PC computing them. For every probe: the envelope (EnvelopeDetector), the brightest sample
+ * inside the window of the probe, and if it is above the threshold a parabola through it and its two neighbours for the
+ * position between the samples (on the log-compressed envelope that is a gaussian fit of the echo).
+ *
+ * The result is probes x DEPTH_VALUES double like a DATA_DEPTH frame: the depth (offset + position * spacing, in samples
+ * if nothing is configured, DEPTH_NOECHO if there is no echo) and the amplitude of the echo in dB against the reference
+ * of the envelope. The probes are independent, so they are shared between the threads of a WorkerPool.
+ */
+class DepthEstimator
+{
+
+private:
+    int samples_;                           //!< Values per probe
+    int probes_;                            //!< Number of probes
+    std::vector<int> windowfirst_;          //!< First sample searched, per probe
+    std::vector<int> windowlast_;           //!< Last sample searched, per probe
+    double threshold_ = -40.0;              //!< An echo has to be at least this many dB against the reference
+    double spacing_ = 1.0;                  //!< Depth of one sample
+    double offset_ = 0.0;                   //!< Depth of sample 0
+
+    // the frame being estimated
+    const uint16_t* raw_ = nullptr;         //!< The raw values
+    double* depth_ = nullptr;               //!< The output
+
+    // the workers
+    std::vector<std::unique_ptr<EnvelopeDetector>> detectors_; //!< One per thread of pool_
+    std::vector<std::vector<uint16_t>> envelopes_; //!< One envelope line per thread
+    WorkerPool pool_;                       //!< The threads taking the probes of a frame, stopped before the detectors go
+
+public:
+
+    /**
+     * @brief Constructor of the estimator, starts the helper threads. The window is the whole line.
+     *
+     * @param samples       Values per probe.
+     * @param probes        Number of probes.
+     * @param threads       Threads working on a frame at the same time, including the calling thread.
+     */
+    DepthEstimator(int samples, int probes, int threads);
+
+    /**
+     * @brief Where the echo is searched, the same for every probe. Samples outside of the line are clipped.
+     *
+     * @param first         First sample, e.g. behind the ringing of the transducer.
+     * @param last          Last sample.
+     */
+    void setWindow(int first, int last);
+
+    /**
+     * @brief Where the echo is searched for one probe, e.g. around the depth of the last frame.
+     */
+    void setWindow(int probe, int first, int last);
+
+    /**
+     * @brief The weakest echo that counts, weaker ones give DEPTH_NOECHO.
+     * @param decibel       dB against the reference of the envelope, e.g. -40.
+     */
+    void setThreshold(double decibel);
+
+    /**
+     * @brief Converts the position of the echo into a depth, depth = offset + position * spacing.
+     * For mm: spacing is the speed of sound / (2 * the sampling frequency).
+     *
+     * @param spacing       Depth of one sample.
+     * @param offset        Depth of the first sample.
+     */
+    void setScale(double spacing, double offset);
+
+    /**
+     * @brief Configures the envelope of every thread (see EnvelopeDetector::setFilter() and setCompression()).
+     */
+    void setEnvelope(double center, double bandwidth, double range);
+
+    /**
+     * @brief Estimates the depths of a frame, returns when all probes are done. Only from one thread.
+     *
+     * @param raw           probes x samples raw values.
+     * @param depth         Receives probes x DEPTH_VALUES values.
+     */
+    void estimate(const uint16_t* raw, double* depth);
+
+    int getThreadCount();                   //!< Threads including the calling thread
+
+protected:
+
+    /**
+     * @brief Estimates the depth of one probe of the frame.
+     *
+     * @param p             The probe.
+     * @param thread        Which detector to use.
+     */
+    void estimateProbe(int p, int thread);
+};
+
+#endif
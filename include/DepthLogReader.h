@@ -0,0 +1,109 @@
+#ifndef DEPTHLOGREADER_H
+#define DEPTHLOGREADER_H
+
+// basic libraries
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "AModeDepthLog.h"
+#include "AModeRecording.h"
+
+/**
+ * @brief A view of one block of a depth log, the columns point directly into the memory mapped file.
+ * It stays valid as long as the DepthLogReader which created it is open.
+ */
+struct DepthLogBlock
+{
+    uint64_t firstframe = 0;                //!< Ordinal of the first frame of the block
+    uint32_t framecount = 0;                //!< Frames in the block, the length of every column
+    const int64_t* timestamp = nullptr;     //!< Timestamp column, see DepthLogHeader::clock
+    const uint64_t* index = nullptr;        //!< Index column
+    const double* values = nullptr;         //!< First value column, the others follow
+
+    /**
+     * @brief One value column, framecount values long.
+     * @param column        probe * values + value.
+     */
+    const double* column(int column) const { return values + (size_t)column * framecount; }
+};
+
+/**
+ * @brief DepthLogReader opens a depth log (see AModeDepthLog.h) for offline analysis or for the export to text.
+ * The file is mapped and only the block headers are read by open(), after that the blocks can be read from
+ * any number of threads at the same time.
+ *
+ * @code
+ * DepthLogReader reader;
+ * reader.open("C:\\data", "depth");
+ * for (int b = 0; b < reader.getBlockCount(); b++) {
+ *     const DepthLogBlock& block = reader.getBlock(b);
+ *     const double* depth = block.column(5 * 2);    // depth of probe 5 for all frames of the block
+ * }
+ * @endcode
+ */
+class DepthLogReader
+{
+
+private:
+    const char* data_ = nullptr;            //!< Start of the mapping
+    uint64_t size_ = 0;                     //!< Bytes of the file
+    const DepthLogHeader* header_ = nullptr;//!< Header at the start of data_
+    std::vector<DepthLogBlock> blocks_;     //!< All complete blocks, in order
+    uint64_t framecount_ = 0;               //!< Frames in all blocks
+    std::string metadata_;                  //!< "key=value\n" text of the trailer, empty if there is none
+#ifdef _WIN32
+    void* filehandle_ = nullptr;            //!< HANDLE of the file
+    void* maphandle_ = nullptr;             //!< HANDLE of the mapping
+#endif
+
+public:
+
+    DepthLogReader();
+
+    ~DepthLogReader();
+
+    /**
+     * @brief Maps <directory>/<name>.amodedepth and finds its blocks.
+     *
+     * @param directory     Directory of the file.
+     * @param name          Name of the file, without extension.
+     * @return              A flag indicating the status. -1 if the file doesn't exist or is not a depth log.
+     */
+    int open(std::string directory, std::string name);
+
+    /**
+     * @brief Unmaps the file, the blocks are not valid anymore.
+     */
+    void close();
+
+    /**
+     * @brief One block.
+     * @param block         From 0 to getBlockCount() - 1.
+     */
+    const DepthLogBlock& getBlock(int block);
+
+    /**
+     * @brief A value of the metadata in the trailer (written by DepthLogWriter::close()).
+     * @param key           Name.
+     * @return              The value, empty if the key is not there or the log has no trailer (not closed, or version 1).
+     */
+    std::string getMetadata(std::string key);
+
+    int getBlockCount();                    //!< Complete blocks in the file
+    uint64_t getFrameCount();               //!< Frames in all blocks
+    int getProbes();                        //!< Number of probes
+    int getValues();                        //!< Values per probe
+    int getColumnCount();                   //!< Value columns, probes * values
+    const DepthLogHeader* getHeader();      //!< Header of the file, nullptr if not open
+
+    /**
+     * @brief Converts a timestamp of the log to the wall clock, with the anchor in the header.
+     * @param timestamp     Timestamp, same clock as the log.
+     * @return              Nanoseconds since 1970.
+     */
+    int64_t toWallTime(int64_t timestamp);
+};
+
+#endif
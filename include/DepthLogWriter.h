@@ -0,0 +1,107 @@
+#ifndef DEPTHLOGWRITER_H
+#define DEPTHLOGWRITER_H
+
+// basic libraries
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <utility>
+
+#include "AModeDepthLog.h"
+
+/**
+ * @brief DepthLogWriter writes the DATA_DEPTH frames of a session in the columnar format described in AModeDepthLog.h.
+ * A frame is scattered into the columns of the block being collected, which is already laid out as it goes to disk,
+ * so a full block is one fwrite(). Nothing is formatted and nothing is allocated after open().
+ * Not thread safe, it is used only by the writer thread of FrameRecorder.
+ */
+class DepthLogWriter
+{
+
+private:
+    FILE* file_ = nullptr;                  //!< The log being written
+    DepthLogHeader header_;                 //!< Header of the file
+    int columns_ = 0;                       //!< Value columns, probes * values
+
+    // the block being collected
+    std::vector<char> block_;               //!< DepthLogBlockHeader and the columns of a full block
+    uint32_t blockframes_ = 4096;           //!< Frames of a full block
+    uint32_t buffered_ = 0;                 //!< Frames in block_
+
+    std::vector<std::pair<std::string, std::string>> metadata_; //!< Written in the trailer by close()
+
+    // for statistics
+    uint64_t countframe_ = 0;               //!< Frames written (and buffered) in the session
+    uint64_t countbyte_ = 0;                //!< Bytes written to the file
+
+public:
+
+    DepthLogWriter();
+
+    ~DepthLogWriter();
+
+    /**
+     * @brief Frames per block, call before open(). Bigger blocks mean fewer writes, but more frames lost after a crash.
+     * @param blockframes   Frames, at least 1.
+     */
+    void setBlockFrames(uint32_t blockframes);
+
+    /**
+     * @brief Creates <directory>/<name>.amodedepth and writes its header.
+     *
+     * @param directory     Directory of the file, it has to exist.
+     * @param name          Name of the file, without extension.
+     * @param probes        Number of probes.
+     * @param values        Values per probe.
+     * @param clock         What the timestamps are, RECORDING_CLOCK_WALL or RECORDING_CLOCK_MONOTONIC.
+     * @param clockorigin   Timestamp when the session started.
+     * @param wallorigin    Nanoseconds since 1970 at clockorigin.
+     * @return              A flag indicating the status. -1 if the file can't be created.
+     */
+    int open(std::string directory, std::string name, int probes, int values, int clock, int64_t clockorigin, int64_t wallorigin);
+
+    /**
+     * @brief Adds one frame to the block, writes the block when it's full.
+     *
+     * @param timestamp     When the frame arrived.
+     * @param index         Index sent by the machine.
+     * @param values        probes * values doubles, probe after probe.
+     * @return              A flag indicating the status. -1 if writing failed.
+     */
+    int write(int64_t timestamp, uint64_t index, const double* values);
+
+    /**
+     * @brief Adds (or replaces) one line of the metadata, which is written in the trailer when the log is closed.
+     *
+     * @param key           Name, without '=' and newline.
+     * @param value         Value, without newline.
+     */
+    void setMetadata(std::string key, std::string value);
+
+    /**
+     * @brief Writes the last (shorter) block and the trailer with the metadata and closes the file.
+     * @return              A flag indicating the status. -1 if writing failed.
+     */
+    int close();
+
+    bool isOpen();                          //!< A file is open
+    uint64_t getFrameCount();               //!< Frames written in the session
+    uint64_t getByteCount();                //!< Bytes written to the file
+
+protected:
+
+    /**
+     * @brief Writes the frames collected in the block, the columns are moved together first if it's not full.
+     * @return              A flag indicating the status. -1 if writing failed.
+     */
+    int flushBlock();
+
+    /**
+     * @brief Writes the trailer with the metadata.
+     * @return              A flag indicating the status. -1 if writing failed.
+     */
+    int writeMetadata();
+};
+
+#endif
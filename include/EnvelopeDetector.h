@@ -0,0 +1,130 @@
+#ifndef ENVELOPEDETECTOR_H
+#define ENVELOPEDETECTOR_H
+
+// basic libraries
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+// which code computes the envelope
+#define ENVELOPE_AUTO -1                    //!< AVX2 if the CPU has it, otherwise scalar
+#define ENVELOPE_SCALAR 0                   //!< Plain C++, the reference
+#define ENVELOPE_AVX2 1                     //!< 8 samples at once with AVX2 and FMA
+
+/**
+ * @brief EnvelopeDetector turns a raw frame (DATA_RAW, probes x samples uint16_t) into an envelope frame of the same size.
+ * Every probe line is band-pass filtered and Hilbert transformed at the same time by a pair of FIR filters
+ * (the in-phase filter is a windowed band-pass, the quadrature filter the same band-pass shifted by 90 degrees),
+ * the envelope is the magnitude of both, and it is log-compressed into uint16_t:
+ * 0 is -range dB or less, 65535 is the reference amplitude (0 dB) or more.
+ *
+ * The filters are symmetric around the sample, so the envelope is not delayed against the raw line.
+ * The AVX2 code gives the same values as the scalar code up to rounding (at most 1 of 65535),
+ * the scalar code is the reference. One detector is for one thread, it has its own scratch memory.
+ */
+class EnvelopeDetector
+{
+
+private:
+    int samples_;                           //!< Values per probe
+    int probes_;                            //!< Number of probes
+    int taps_ = 31;                         //!< Length of the filters, odd
+    double center_ = 0.12;                  //!< Center frequency of the pass band, relative to the sampling frequency
+    double bandwidth_ = 0.08;               //!< Width of the pass band, relative to the sampling frequency
+    double range_ = 60.0;                   //!< Dynamic range in dB of the compressed envelope
+    double reference_ = 2048.0;             //!< Amplitude that is 0 dB, half of the 12 bit ADC
+    int implementation_ = ENVELOPE_SCALAR;  //!< ENVELOPE_SCALAR or ENVELOPE_AVX2
+
+    std::vector<float> filteri_;            //!< In-phase filter, taps_ values
+    std::vector<float> filterq_;            //!< Quadrature filter, taps_ values
+    std::vector<float> line_;               //!< One probe line as float with taps_/2 zeros on both sides
+    float scale_ = 0.0f;                    //!< Compressed value = scale_ * ln(envelope^2) + offset_
+    float offset_ = 0.0f;                   //!< See scale_
+
+public:
+
+    /**
+     * @brief Constructor of the detector, with the default filter (see setFilter()) and ENVELOPE_AUTO.
+     *
+     * @param samples       Values per probe.
+     * @param probes        Number of probes.
+     */
+    EnvelopeDetector(int samples, int probes);
+
+    /**
+     * @brief Designs the filters. The frequencies are relative to the sampling frequency, so 0.12 is 12% of it
+     * (the burst of the simulator), the pass band has to stay between 0 and 0.5.
+     *
+     * @param center        Center frequency of the echo.
+     * @param bandwidth     Width of the pass band around center.
+     * @param taps          Length of the filters, longer is sharper and slower, even numbers are made odd.
+     */
+    void setFilter(double center, double bandwidth, int taps = 31);
+
+    /**
+     * @brief Configures the log-compression.
+     *
+     * @param range         Dynamic range in dB, everything range below the reference is 0.
+     * @param reference     Amplitude of the echo that is 65535 (0 dB).
+     */
+    void setCompression(double range, double reference = 2048.0);
+
+    /**
+     * @brief Chooses the code, e.g. ENVELOPE_SCALAR to compare with the reference.
+     *
+     * @param implementation ENVELOPE_AUTO, ENVELOPE_SCALAR or ENVELOPE_AVX2.
+     * @return              A flag indicating the status. -1 if this CPU (or build) has no AVX2, then it stays as it was.
+     */
+    int setImplementation(int implementation);
+
+    /**
+     * @brief Computes the envelope of a whole frame.
+     *
+     * @param raw           probes x samples values, as the machine sends them.
+     * @param envelope      Receives probes x samples compressed values, may not be raw.
+     */
+    void process(const uint16_t* raw, uint16_t* envelope);
+
+    /**
+     * @brief Computes the envelope of one probe line, e.g. when the probes of a frame are shared between threads.
+     *
+     * @param raw           samples values of the probe.
+     * @param envelope      Receives samples compressed values.
+     */
+    void processLine(const uint16_t* raw, uint16_t* envelope);
+
+    /**
+     * @brief Checks if this CPU can run ENVELOPE_AVX2 (AVX2 and FMA, and the OS saves the registers).
+     */
+    static bool hasAvx2();
+
+    /**
+     * @brief Converts a compressed value back to dB against the reference, 0 is -range, 65535 is 0 dB.
+     */
+    double toDecibel(double value);
+
+    int getImplementation();                //!< ENVELOPE_SCALAR or ENVELOPE_AVX2
+    int getSamples();                       //!< Values per probe
+    int getProbes();                        //!< Number of probes
+    int getTaps();                          //!< Length of the filters
+
+protected:
+
+    /**
+     * @brief Copies one probe line into line_ as float.
+     */
+    void loadLine(const uint16_t* raw);
+
+    /**
+     * @brief Filters, detects and compresses line_ into one probe line, plain C++.
+     * @param first         First sample, the ones before are left as they are.
+     */
+    void processScalar(uint16_t* envelope, int first);
+
+    /**
+     * @brief Same as processScalar() with AVX2, only call it if hasAvx2().
+     */
+    void processAvx2(uint16_t* envelope);
+};
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef FRAMECLOCK_H
+#define FRAMECLOCK_H
+
+// basic libraries
+#include <stdint.h>
+#include <chrono>
+
+#define FRAMECLOCK_STEP 1000000             //!< Nanoseconds the wall clock has to jump before fromWall() takes a new anchor
+
+/**
+ * @brief FrameClock is where the timestamps of the frames come from. They are nanoseconds of a monotonic clock
+ * (CLOCK_MONOTONIC on linux, QueryPerformanceCounter on windows), which never jumps when NTP corrects the
+ * wall clock and has no rounding like the double of rtb::getTime().
+ *
+ * To get back to the wall clock the object keeps one pair (monotonic, wall) taken at the same moment, the anchor.
+ * Everything converted with the same anchor keeps the distances of the monotonic clock.
+ */
+class FrameClock
+{
+
+private:
+    int64_t monotonicorigin_ = 0;           //!< now() at the anchor
+    int64_t wallorigin_ = 0;                //!< wallNow() at the anchor
+
+public:
+
+    /**
+     * @brief Constructor, takes the anchor.
+     */
+    FrameClock();
+
+    /**
+     * @brief Takes a new anchor, timestamps converted before and after are not comparable anymore.
+     */
+    void anchor();
+
+    /**
+     * @brief Nanoseconds of the monotonic clock, only for differences and for the frames.
+     */
+    static int64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /**
+     * @brief Nanoseconds since 1970 of the wall clock.
+     */
+    static int64_t wallNow() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    /**
+     * @brief Converts a time of the wall clock (e.g. a receive timestamp of the kernel) to the monotonic clock with the
+     * anchor. The difference of the clocks read again for every call would be off by the time between the two readings,
+     * and two times in order could come out the other way round. So only if the wall clock jumped by more than
+     * FRAMECLOCK_STEP since the anchor (NTP, the user), a new anchor is taken.
+     *
+     * @param wall          Nanoseconds since 1970.
+     * @return              Nanoseconds of the monotonic clock.
+     */
+    int64_t fromWall(int64_t wall);
+
+    /**
+     * @brief Converts a timestamp of a frame to the wall clock with the anchor.
+     * @param monotonic     Nanoseconds of the monotonic clock.
+     * @return              Nanoseconds since 1970.
+     */
+    int64_t toWall(int64_t monotonic);
+
+    /**
+     * @brief Same as toWall() in seconds, like rtb::getTime().
+     */
+    double toWallSeconds(int64_t monotonic);
+
+    int64_t getMonotonicOrigin();           //!< now() at the anchor
+    int64_t getWallOrigin();                //!< wallNow() at the anchor
+};
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef FRAMECODEC_H
+#define FRAMECODEC_H
+
+// basic libraries
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#define CODEC_BLOCK 32                      //!< Residuals packed with the same bit width
+#define CODEC_PREDICT_SAMPLE 0              //!< Residual is the difference to the previous sample of the same probe
+#define CODEC_PREDICT_FRAME 1               //!< Residual is the difference to the same sample of the previous frame
+#define CODEC_FLAG_KEYFRAME 1               //!< The frame doesn't use the previous frame, decoding can start here
+
+/**
+ * @brief FrameCodec compresses one DATA_RAW frame (uint16_t values, probe after probe) without loss.
+ * This is RECORDING_CODEC_PACK16 in the .amode recording.
+ *
+ * Every probe line is predicted either from its previous sample (the echo changes slowly along the line)
+ * or from the same line of the previous frame (the probe doesn't move much between frames), whichever gives
+ * the smaller residuals. The residuals are zigzag coded (small negative numbers become small positive numbers)
+ * and packed in blocks of CODEC_BLOCK values with the number of bits of the biggest value in the block, so a quiet
+ * block takes a few bits per value and a noisy one never takes more than 17 bits.
+ *
+ * The encoded frame is:
+ *
+ *   uint8 flags                            CODEC_FLAG_KEYFRAME
+ *   for every probe:
+ *     uint8 predictor                      CODEC_PREDICT_SAMPLE or CODEC_PREDICT_FRAME
+ *     uint16 first                         only for CODEC_PREDICT_SAMPLE, the first value of the line
+ *     for every block:
+ *       uint8 width                        bits per value, 0..17
+ *       uint32 * width                     CODEC_BLOCK values of width bits, little endian, the last block is padded with zero
+ *
+ * One FrameCodec has its own scratch memory, use one per thread.
+ */
+class FrameCodec
+{
+
+private:
+    int samples_;                           //!< Values per probe
+    int probes_;                            //!< Number of probes
+    int blocks_;                            //!< Blocks per probe
+    std::vector<uint32_t> residual_;        //!< Zigzag residuals of one probe, padded to whole blocks
+    std::vector<uint32_t> residualframe_;   //!< Same for CODEC_PREDICT_FRAME, the encoder tries both
+    bool fixedlayout_ = true;               //!< Use the code generated for RawLayout if the geometry is the standard one
+
+public:
+
+    /**
+     * @brief Constructor of the codec.
+     *
+     * @param samples       Values per probe.
+     * @param probes        Number of probes.
+     */
+    FrameCodec(int samples, int probes);
+
+    /**
+     * @brief The biggest encoded frame, the output of encode() should have this size.
+     * @return              The number of bytes.
+     */
+    size_t getMaxEncodedSize();
+
+    /**
+     * @brief Encodes one frame.
+     *
+     * @param values        samples*probes values.
+     * @param previous      The previous frame, nullptr to make a keyframe.
+     * @param output        Receives the encoded frame, at least getMaxEncodedSize() bytes.
+     * @return              The encoded size in bytes, 0 if it is not smaller than the values (store them as they are then).
+     */
+    size_t encode(const uint16_t* values, const uint16_t* previous, char* output);
+
+    /**
+     * @brief Decodes one frame.
+     *
+     * @param input         The encoded frame.
+     * @param inputsize     Bytes of the encoded frame.
+     * @param previous      The decoded previous frame, can be nullptr for a keyframe.
+     * @param values        Receives samples*probes values.
+     * @return              A flag indicating the status. -1 if the input is broken or the previous frame is missing.
+     */
+    int decode(const char* input, size_t inputsize, const uint16_t* previous, uint16_t* values);
+
+    /**
+     * @brief Checks if an encoded frame can be decoded without the previous frame.
+     * @param input         The encoded frame.
+     * @return              True for a keyframe.
+     */
+    static bool isKeyframe(const char* input);
+
+    /**
+     * @brief Chooses between the code generated for the standard geometry (RawLayout, the default if the geometry is 30x1500)
+     * and the code for any geometry, e.g. to compare them. Both give the same bytes.
+     *
+     * @param flag          True for the standard geometry.
+     * @return              False if the geometry is not the standard one, then the code for any geometry is used anyway.
+     */
+    bool setFixedLayout(bool flag);
+
+protected:
+
+    /**
+     * @brief encode() for one layout (see FrameLayout.h), generated for RawLayout and CustomRawLayout.
+     */
+    template <class Layout>
+    size_t encodeLayout(const Layout& layout, const uint16_t* values, const uint16_t* previous, char* output);
+
+    /**
+     * @brief decode() for one layout.
+     */
+    template <class Layout>
+    int decodeLayout(const Layout& layout, const char* input, size_t inputsize, const uint16_t* previous, uint16_t* values);
+
+    /**
+     * @brief Packs one block of CODEC_BLOCK residuals.
+     * @return              Pointer behind the packed block.
+     */
+    static char* packBlock(const uint32_t* residual, int width, char* output);
+
+    /**
+     * @brief Unpacks one block of CODEC_BLOCK residuals.
+     * @return              Pointer behind the packed block.
+     */
+    static const char* unpackBlock(const char* input, int width, uint32_t* residual);
+};
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef FRAMECOMPRESSOR_H
+#define FRAMECOMPRESSOR_H
+
+// basic libraries
+#include <stdint.h>
+#include <vector>
+#include <memory>
+#include <atomic>
+
+#include "FramePool.h"
+#include "FrameCodec.h"
+#include "WorkerPool.h"
+#include "AModeRecording.h"
+
+/**
+ * @brief FrameCompressor encodes a batch of DATA_RAW frames with FrameCodec on several threads.
+ * One frame is a lot of work for one core at the full stream rate, but the frames of a batch are independent
+ * (a frame is predicted from the previous raw frame, which is already there, not from its encoded version),
+ * so they are shared between the threads of a WorkerPool, the calling thread helps too.
+ * Every keyinterval-th frame is a keyframe, so a reader never has to decode more than keyinterval frames
+ * to get to a random frame.
+ */
+class FrameCompressor
+{
+
+private:
+    int samples_;                           //!< Values per probe
+    int probes_;                            //!< Number of probes
+    int keyinterval_;                       //!< Distance between keyframes
+    size_t framesize_;                      //!< Bytes of a raw frame
+
+    // the batch being encoded
+    const std::vector<FrameRef>* batch_ = nullptr; //!< Frames of the batch
+    FrameRef previous_;                     //!< Last frame of the previous batch, held until the next batch is done
+    std::vector<std::vector<char>> encoded_;//!< Output of every frame of the batch
+    std::vector<uint32_t> encodedsize_;     //!< Bytes in encoded_, 0 if the frame is stored raw
+    uint64_t batchfirst_ = 0;               //!< Number of the first frame of the batch in the session
+
+    // the workers
+    std::vector<std::unique_ptr<FrameCodec>> codecs_; //!< One codec per thread of pool_
+    WorkerPool pool_;                       //!< The threads encoding the frames of a batch, stopped before the codecs go
+
+    // for statistics
+    std::atomic<uint64_t> countnanosecond_{ 0 }; //!< Time spent in FrameCodec::encode() by all threads
+    uint64_t countframe_ = 0;               //!< Frames encoded
+    uint64_t countrawbyte_ = 0;             //!< Bytes before encoding
+    uint64_t countstoredbyte_ = 0;          //!< Bytes after encoding (raw size for frames which didn't get smaller)
+
+public:
+
+    /**
+     * @brief Constructor of the compressor, starts the helper threads.
+     *
+     * @param samples       Values per probe.
+     * @param probes        Number of probes.
+     * @param threads       Threads encoding at the same time, including the calling thread.
+     * @param keyinterval   Every keyinterval-th frame is a keyframe.
+     */
+    FrameCompressor(int samples, int probes, int threads, int keyinterval);
+
+    /**
+     * @brief Encodes the first count frames of batch, returns when all of them are done.
+     * The frames must come in the order they are written, and the batch must not change until the next compress().
+     *
+     * @param batch         The frames.
+     * @param count         How many frames of batch are used.
+     */
+    void compress(const std::vector<FrameRef>& batch, size_t count);
+
+    /**
+     * @brief Gives the last frame of the last batch back to the pool, after the last compress().
+     * The pool can be gone before the compressor, it must not hold a slot of it then.
+     */
+    void finish();
+
+    /**
+     * @brief The payload to write for frame i of the last batch.
+     * @return              The encoded frame, or the raw data if encoding didn't make it smaller.
+     */
+    const char* getPayload(size_t i);
+
+    uint32_t getPayloadSize(size_t i);      //!< Bytes of getPayload(i)
+    uint32_t getCodec(size_t i);            //!< RECORDING_CODEC_PACK16 or RECORDING_CODEC_NONE for getPayload(i)
+
+    double getCompressionRatio();           //!< Raw bytes / stored bytes of all frames
+    double getEncodeTime();                 //!< Average microseconds of CPU per frame
+    uint64_t getFrameCount();               //!< Frames encoded
+
+protected:
+
+    /**
+     * @brief Encodes frame i of the batch.
+     * @param i             Position in the batch.
+     * @param codec         The codec of the thread.
+     */
+    void encodeFrame(size_t i, FrameCodec& codec);
+};
+
+#endif
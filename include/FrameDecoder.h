@@ -0,0 +1,128 @@
+#ifndef FRAMEDECODER_H
+#define FRAMEDECODER_H
+
+// basic libraries
+#include <stdint.h>
+#include <vector>
+
+/**
+ * @brief FrameDecoder reassembles the packets (header+index+data) of the A-mode Ultrasound Machine from the TCP stream.
+ * TCP doesn't keep the boundary of the packets that the machine sends, one recv() can return a piece of a packet,
+ * and the rest comes with the next recv(). The decoder keeps a staging buffer of exactly one packet and tells the
+ * caller where to receive and how many bytes are still missing, so recv() never reads across two packets.
+ *
+ * The packet can be assembled directly in memory of the caller (setBuffer()), e.g. a slot of FramePool,
+ * so the complete packet doesn't need to be copied anywhere.
+ *
+ * The header of every packet should be the same, so the first header is remembered as sync word. If a header
+ * doesn't match, the stream is misaligned (should not happen with TCP, but a buggy sender or a reconnect can do it),
+ * and the decoder skips bytes until it finds the sync word again. This assumes the machine doesn't put anything
+ * that changes into the header, if it does, turn the check off (setSyncCheck(), AModeUSConnection::setHeaderSync()).
+ *
+ * Usage:
+ * @code
+ * int iResult = recv(socket, decoder.writePointer(), decoder.writeSize(), 0);
+ * if (iResult > 0 && decoder.commit(iResult)) process(decoder.frame());
+ * @endcode
+ */
+class FrameDecoder
+{
+
+private:
+    int headersize_;                        //!< The number of bytes of the header
+    int indexsize_;                         //!< The number of bytes of the index
+    int datasize_;                          //!< The number of bytes of the data
+    int framesize_;                         //!< headersize_ + indexsize_ + datasize_
+
+    std::vector<char> ownbuffer_;           //!< Staging buffer of the decoder, used if setBuffer() was not called
+    char* buffer_;                          //!< Where the current packet is assembled, exactly one packet
+    int filled_ = 0;                        //!< How many bytes of the current packet are already in buffer_
+
+    bool synccheck_ = true;                 //!< Check the header of every packet against syncword_
+    bool synclocked_ = false;               //!< syncword_ is valid
+    char syncword_[8];                      //!< The header we expect (headers longer than 8 bytes are only checked partially)
+    int synclength_;                        //!< min(headersize_, 8)
+    bool resyncing_ = false;                //!< Currently searching for the sync word
+
+    long countframe_ = 0;                   //!< Complete packets
+    long countresync_ = 0;                  //!< How many times the stream was misaligned
+    long countskipped_ = 0;                 //!< Bytes thrown away while searching for the sync word
+
+public:
+
+    /**
+     * @brief Constructor of the decoder.
+     *
+     * @param headersize    The number of bytes of the header.
+     * @param indexsize     The number of bytes of the index.
+     * @param datasize      The number of bytes of the data.
+     */
+    FrameDecoder(int headersize, int indexsize, int datasize);
+
+    /**
+     * @brief Where the next recv() should put the bytes.
+     * @return              Pointer inside the staging buffer.
+     */
+    char* writePointer();
+
+    /**
+     * @brief How many bytes the next recv() may read, which is what is missing of the current packet.
+     * @return              The number of bytes.
+     */
+    int writeSize();
+
+    /**
+     * @brief Tell the decoder that recv() wrote some bytes to writePointer().
+     *
+     * @param bytes         The number of bytes recv() returned.
+     * @return              True if there is a complete packet in frame(). It stays valid until the next recv().
+     */
+    bool commit(int bytes);
+
+    /**
+     * @brief The complete packet (header+index+data), only valid after commit() returned true.
+     * @return              Pointer to the packet.
+     */
+    const char* frame();
+
+    /**
+     * @brief The size of a complete packet.
+     * @return              The number of bytes (header+index+data).
+     */
+    int frameSize();
+
+    /**
+     * @brief Assemble the next packets in the given memory instead of the own buffer.
+     * Call it after commit() returned true, a partial packet would be copied over.
+     *
+     * @param buffer        At least frameSize() bytes, nullptr to go back to the own buffer.
+     */
+    void setBuffer(char* buffer);
+
+    /**
+     * @brief Forget the partial packet and the sync word, use this after reconnecting.
+     */
+    void reset();
+
+    /**
+     * @brief Enable or disable the header check. Enabled by default.
+     * Disable it if the machine is configured to send a header that changes between packets.
+     *
+     * @param flag          Set true to check the header.
+     */
+    void setSyncCheck(bool flag);
+
+    long getFrameCount();                   //!< Number of complete packets
+    long getResyncCount();                  //!< Number of times the stream was misaligned
+    long getSkippedBytes();                 //!< Number of bytes thrown away while resynchronising
+
+protected:
+
+    /**
+     * @brief Checks the header which was just completed, and shifts the buffer if it is not the sync word.
+     * @return              True if the header is fine.
+     */
+    bool checkHeader();
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef FRAMEHISTORY_H
+#define FRAMEHISTORY_H
+
+// basic libraries
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// the frames which are passed around without copying
+#include "FramePool.h"
+
+/**
+ * @brief FrameHistory keeps the last frames in memory, as references to the slots of the pool, so nothing is copied.
+ * The ring is allocated in the constructor and never grows, when it is full the oldest frame goes back to the pool.
+ * Before the trigger of an event recording it holds what happened before the trigger, afterwards it is the backlog
+ * which goes to the recorder behind the live frames (see AModeUSConnection::setPreTrigger()).
+ * Only for the thread that reads the socket, there is no lock.
+ */
+class FrameHistory
+{
+
+private:
+    std::vector<FrameRef> ring_;            //!< The frames, capacity references, never resized
+    size_t first_ = 0;                      //!< Position of the oldest frame
+    size_t count_ = 0;                      //!< Frames in the ring
+    long countoverwritten_ = 0;             //!< Frames pushed out by push() because the ring was full
+
+public:
+
+    /**
+     * @brief Constructor of the history, allocates the ring.
+     * @param capacity      Most frames held, the pool needs that many slots more.
+     */
+    FrameHistory(size_t capacity);
+
+    /**
+     * @brief Adds the newest frame, the oldest one is given back to the pool if the ring is full.
+     *
+     * @param frame         The frame, the history holds another reference to it.
+     * @return              False if the oldest frame was pushed out.
+     */
+    bool push(const FrameRef& frame);
+
+    /**
+     * @brief Takes the oldest frame out of the history.
+     * @return              The frame, empty if the history is empty.
+     */
+    FrameRef pop();
+
+    /**
+     * @brief Gives the frames older than timestamp back to the pool, e.g. the ones before the pre-trigger window.
+     *
+     * @param timestamp     FrameClock::now() of the oldest frame to keep.
+     * @return              The number of frames thrown away.
+     */
+    size_t dropBefore(int64_t timestamp);
+
+    /**
+     * @brief Gives all frames back to the pool.
+     */
+    void clear();
+
+    size_t size();                          //!< Frames in the history now
+    size_t getCapacity();                   //!< Most frames held
+    long getOverwriteCount();               //!< Frames pushed out because the ring was full
+};
+
+#endif
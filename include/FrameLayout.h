@@ -0,0 +1,49 @@
+#ifndef FRAMELAYOUT_H
+#define FRAMELAYOUT_H
+
+/**
+ * @brief The geometry of a DATA_RAW frame (uint16_t values) known at compile time. FrameCodec is written against a
+ * layout and generated once per layout, so for the standard 30x1500 frame every loop of the codec has a constant
+ * length and the compiler can unroll and vectorise it. For SAMPLES = 0 the geometry is given in the constructor
+ * instead (the custom (samples, probes) constructor of the connection), the code is the same but the loops are not
+ * constant. Only the codec uses it, the receive and record paths work on the geometry of the connection.
+ *
+ * @tparam SAMPLES      Values per probe, 0 if only known at runtime.
+ * @tparam PROBES       Number of probes, 0 if only known at runtime.
+ */
+template <int SAMPLES = 0, int PROBES = 0>
+struct FrameLayout
+{
+    static constexpr int samples() { return SAMPLES; }                      //!< Values per probe
+    static constexpr int probes() { return PROBES; }                        //!< Number of probes
+};
+
+/**
+ * @brief The same layout with the geometry only known at runtime.
+ */
+template <>
+struct FrameLayout<0, 0>
+{
+    int samples_;                           //!< Values per probe
+    int probes_;                            //!< Number of probes
+
+    FrameLayout(int samples, int probes) : samples_(samples), probes_(probes) {}
+
+    int samples() const { return samples_; }
+    int probes() const { return probes_; }
+};
+
+typedef FrameLayout<1500, 30> RawLayout;    //!< DATA_RAW as the machine sends it
+typedef FrameLayout<> CustomRawLayout;      //!< DATA_RAW with the geometry of the custom constructor
+
+/**
+ * @brief Calls function with the layout of a DATA_RAW frame of samples x probes, the standard one if it is one.
+ * @return              What function returns.
+ */
+template <typename Function>
+auto withRawLayout(int samples, int probes, bool allowfixed, Function function) -> decltype(function(RawLayout())) {
+    if (allowfixed && samples == RawLayout::samples() && probes == RawLayout::probes()) return function(RawLayout());
+    return function(CustomRawLayout(samples, probes));
+}
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef FRAMEPOOL_H
+#define FRAMEPOOL_H
+
+// basic libraries
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <atomic>
+#include <utility>
+
+#define FRAMEPOOL_ALIGNMENT 64              //!< The values of every slot start on a cache line
+
+/**
+ * @brief One packet of the A-mode Ultrasound Machine (header+index+data) with the time it arrived.
+ * The memory is allocated once by FramePool, the socket receives directly into packet.
+ */
+struct FrameSlot
+{
+    std::atomic<int> refcount{ 0 };         //!< Number of FrameRef pointing here, 0 means the slot is free
+    int64_t timestamp = 0;                  //!< When the first bytes arrived, nanoseconds of FrameClock::now() (from the kernel if it can)
+    uint64_t index = 0;                     //!< Index sent by the machine (2 bytes for DATA_RAW, 8 bytes for DATA_DEPTH)
+    char* packet = nullptr;                 //!< The whole packet, as it came from the socket
+    int packetsize = 0;                     //!< Bytes of the packet
+    const char* data = nullptr;             //!< The values behind header and index, uint16_t for DATA_RAW, double for DATA_DEPTH
+    int datasize = 0;                       //!< Bytes of the values
+    std::vector<char> storage;              //!< Memory of packet, a bit bigger so data can be aligned
+#ifdef AMODE_ENABLE_STATS
+    int64_t pushtime = 0;                   //!< statsNow() when it was pushed into the queue of the recorder
+#endif
+};
+
+/**
+ * @brief A reference to a FrameSlot, this is what is passed between threads instead of copying the frame.
+ * Copying the reference only counts up, the slot goes back to the pool when the last reference is gone.
+ * Nobody should write into a slot which was handed to another thread.
+ */
+class FrameRef
+{
+
+private:
+    FrameSlot* slot_ = nullptr;             //!< The slot, nullptr if empty
+
+public:
+
+    FrameRef() {}
+
+    /**
+     * @brief Takes over a slot whose refcount was already counted for this reference (used by FramePool).
+     * @param slot          The slot.
+     */
+    explicit FrameRef(FrameSlot* slot) : slot_(slot) {}
+
+    FrameRef(const FrameRef& other) : slot_(other.slot_) {
+        if (slot_ != nullptr) slot_->refcount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    FrameRef(FrameRef&& other) noexcept : slot_(other.slot_) {
+        other.slot_ = nullptr;
+    }
+
+    FrameRef& operator=(FrameRef other) noexcept {
+        std::swap(slot_, other.slot_);
+        return *this;
+    }
+
+    ~FrameRef() {
+        reset();
+    }
+
+    /**
+     * @brief Gives the slot back, the reference is empty afterwards.
+     */
+    void reset() {
+        // everything written to the slot before this must be visible to the next one who takes it from the pool
+        if (slot_ != nullptr) slot_->refcount.fetch_sub(1, std::memory_order_acq_rel);
+        slot_ = nullptr;
+    }
+
+    friend void swap(FrameRef& a, FrameRef& b) noexcept {
+        std::swap(a.slot_, b.slot_);
+    }
+
+    bool empty() const { return slot_ == nullptr; }                 //!< No slot
+    FrameSlot* operator->() const { return slot_; }                 //!< The slot
+    FrameSlot& operator*() const { return *slot_; }                 //!< The slot
+};
+
+/**
+ * @brief FramePool allocates all the frames in the constructor, nothing is allocated while streaming.
+ * Only one thread (the one reading the socket) takes slots from the pool, every other thread only
+ * holds FrameRef which it got from that thread. When all slots are used, acquire() returns an empty reference,
+ * so the pool has to be bigger than everything that can hold frames at the same time (queues, batches, ...).
+ */
+class FramePool
+{
+
+private:
+    std::vector<FrameSlot> slots_;          //!< All slots, never resized
+    std::atomic<long> countempty_{ 0 };     //!< How many times acquire() found no free slot
+
+public:
+
+    /**
+     * @brief Constructor of the pool, allocates all slots.
+     *
+     * @param slots         Number of frames.
+     * @param headersize    The number of bytes of the header.
+     * @param indexsize     The number of bytes of the index.
+     * @param datasize      The number of bytes of the data.
+     */
+    FramePool(size_t slots, int headersize, int indexsize, int datasize);
+
+    /**
+     * @brief Takes a free slot. Only from one thread.
+     * @return              Reference to the slot, empty if all slots are in use.
+     */
+    FrameRef acquire();
+
+    size_t getSlotCount();                  //!< Number of slots
+    size_t getFreeCount();                  //!< Slots nobody holds now
+    long getEmptyCount();                   //!< How many times acquire() failed
+};
+
+#endif
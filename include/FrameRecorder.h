@@ -0,0 +1,244 @@
+#ifndef FRAMERECORDER_H
+#define FRAMERECORDER_H
+
+// basic libraries
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include <opencv2/opencv.hpp>
+
+#include "FramePool.h"
+#include "SpscQueue.h"
+#include "RecordingWriter.h"
+#include "DepthLogWriter.h"
+#include "CsvFormatter.h"
+#include "FrameCompressor.h"
+#include "TiffWriter.h"
+#include "PipelineStats.h"
+#include "FrameClock.h"
+#include "ThreadCompat.h"
+
+#ifndef DATA_RAW
+#define DATA_RAW 0
+#define DATA_DEPTH 1
+#endif
+
+// how the frames are stored
+#define RECORD_BINARY 0                     //!< One .amode file per segment, see AModeRecording.h (DATA_RAW and DATA_DEPTH)
+#define RECORD_TIFF 1                       //!< One <timestamp>_<index>.tiff per frame (DATA_RAW only)
+#define RECORD_CSV 2                        //!< One line per frame in a .csv (DATA_DEPTH only)
+#define RECORD_COLUMNS 3                    //!< One .amodedepth file, the frames in columns, see AModeDepthLog.h (DATA_DEPTH only)
+
+/**
+ * @brief FrameRecorder writes the frames to disk on its own thread.
+ * The thread that reads the socket only pushes the frames into a lock-free queue, so when the disk is slow
+ * the socket is still read and the machine doesn't throttle. What happens when the queue is full is
+ * decided by the queue policy (QUEUE_BLOCK, QUEUE_DROP_OLDEST, QUEUE_DROP_NEWEST).
+ * With RECORD_BINARY (default for DATA_RAW) the frames are appended to segment files by RecordingWriter,
+ * RECORD_TIFF stores one .tiff per frame, RECORD_COLUMNS (default for DATA_DEPTH) collects the depths in blocks of
+ * columns written by DepthLogWriter, RECORD_CSV one line per frame in a .csv file (formatted by CsvFormatter).
+ * DATA_RAW frames in RECORD_BINARY can be compressed without loss (setCompression()), then the writer thread takes
+ * all the frames waiting in the queue as one batch and FrameCompressor encodes them in parallel.
+ * RECORD_TIFF frames can be written the same way by several threads (setTiffThreads()), TiffWriter writes a batch in parallel.
+ */
+class FrameRecorder
+{
+
+private:
+    // variables that stores amode spesifications
+    int datamode_;                          //!< DATA_RAW or DATA_DEPTH
+    int samples_;                           //!< The number of sample points in the signal
+    int probes_;                            //!< The number of ultrasound probes
+    bool usedataindex_ = false;             //!< Put the index in the file name (RECORD_TIFF) or in the second column (RECORD_CSV)
+    int recordformat_;                      //!< RECORD_BINARY, RECORD_TIFF, RECORD_CSV or RECORD_COLUMNS
+
+    // where to write
+    std::string recorddirectory_;           //!< Directory of the files
+    std::string recordname_;                //!< Name of the .csv, .amodedepth or of the .amode segments, without extension
+    CsvFormatter csv_;                      //!< Formats and writes the .csv
+    RecordingWriter writer_;                //!< Writes the .amode segments
+    DepthLogWriter depthlog_;               //!< Writes the .amodedepth
+    FrameClock clock_;                      //!< Anchored in start(), converts the timestamps of the frames to the wall clock
+    double starttime_ = 0;                  //!< rtb::getTime() of start(), for the metadata
+
+    // the writer thread
+    SpscQueue<FrameRef> queue_;             //!< Frames waiting to be written, only references to the slots of the pool
+    std::thread thread_;                    //!< The writer thread
+    std::atomic<bool> stop_{ false };       //!< Set by stop(), the thread writes what is left then finishes
+    std::atomic<long> countwrite_{ 0 };     //!< Frames written to disk
+    int threadcore_ = -1;                   //!< Core the writer thread is pinned to, -1 anywhere
+    int threadpriority_ = 0;                //!< SCHED_FIFO priority of the writer thread, 0 normal
+    FrameRef current_;                      //!< The frame being written, swapped out of the queue
+
+    // the compression
+    int compressthreads_ = 0;               //!< Threads for FrameCompressor, 0 writes the frames as they are
+    int keyinterval_ = 64;                  //!< Distance between keyframes
+    std::unique_ptr<FrameCompressor> compressor_; //!< Created in start() if compressthreads_ > 0
+    std::vector<FrameRef> batch_;           //!< Frames swapped out of the queue to be compressed or written together
+
+    // the .tiff files written in parallel
+    int tiffthreads_ = 0;                   //!< Threads for TiffWriter, 0 writes the .tiff files on the writer thread alone
+    std::unique_ptr<TiffWriter> tiff_;      //!< Created in start() if tiffthreads_ > 0
+
+#ifdef AMODE_ENABLE_STATS
+    PipelineStats* stats_ = nullptr;        //!< Where the queue wait and the write time go, can be nullptr
+#endif
+
+    // metadata from other threads
+    std::mutex metadatamutex_;              //!< Protects metadata_
+    std::vector<std::pair<std::string, std::string>> metadata_; //!< Lines for the writer, see setMetadata()
+
+public:
+
+    /**
+     * @brief Constructor of the recorder, nothing is written until start().
+     *
+     * @param datamode          DATA_RAW or DATA_DEPTH.
+     * @param samples           The number of point samples from the signals.
+     * @param probes            The number of probes/transducers.
+     * @param queuecapacity     How many frames can wait for the disk.
+     * @param queuepolicy       What to do when the queue is full, QUEUE_BLOCK, QUEUE_DROP_OLDEST or QUEUE_DROP_NEWEST.
+     */
+    FrameRecorder(int datamode, int samples, int probes, size_t queuecapacity, int queuepolicy);
+
+    /**
+     * @brief How the frames are stored, call before start().
+     * @param format        RECORD_BINARY, RECORD_TIFF (DATA_RAW only), RECORD_CSV or RECORD_COLUMNS (DATA_DEPTH only).
+     */
+    void setFormat(int format);
+
+    ~FrameRecorder();
+
+    /**
+     * @brief Compress the frames with RECORDING_CODEC_PACK16 (DATA_RAW and RECORD_BINARY only), call before start().
+     *
+     * @param threads       Threads encoding in parallel, 0 disables the compression.
+     * @param keyinterval   Every keyinterval-th frame can be decoded without the frames before it.
+     */
+    void setCompression(int threads, int keyinterval = 64);
+
+    /**
+     * @brief Write the .tiff files on several threads (RECORD_TIFF only), call before start().
+     * The files are the same, the writer thread takes the frames waiting in the queue as one batch and TiffWriter
+     * writes them in parallel.
+     *
+     * @param threads       Threads writing in parallel, 0 writes them one after the other on the writer thread.
+     */
+    void setTiffThreads(int threads);
+
+    /**
+     * @brief How the .amode segments go to the disk (RECORD_BINARY only), call before start(). See RecordingWriter::setBackend().
+     *
+     * @param backend       FILEWRITER_AUTO (default), FILEWRITER_BUFFERED or FILEWRITER_IOURING.
+     * @param direct        Bypass the page cache with O_DIRECT (io_uring only).
+     */
+    void setBackend(int backend, bool direct = false);
+
+    /**
+     * @brief Where the writer thread runs, call before start(). See pinThread() and setRealtimePriority().
+     *
+     * @param core          Core the writer thread is pinned to, -1 (default) anywhere.
+     * @param priority      SCHED_FIFO priority, 0 (default) normal scheduling.
+     */
+    void setThread(int core, int priority = 0);
+
+#ifdef AMODE_ENABLE_STATS
+    /**
+     * @brief Measure STATS_QUEUEWAIT and STATS_WRITE, call before start().
+     * @param stats         The histograms, they have to live longer than the recorder runs. nullptr measures nothing.
+     */
+    void setStats(PipelineStats* stats);
+#endif
+
+    /**
+     * @brief Name the .tiff files <timestamp>_<index>.tiff (DATA_RAW) or add the index column (DATA_DEPTH).
+     * @param flag          Set true to use index.
+     */
+    void useDataIndex(bool flag);
+
+    /**
+     * @brief Where the frames are written.
+     *
+     * @param directory     Directory of the files, it has to exist.
+     * @param name          Name of the .csv, .amodedepth or of the .amode segments, without extension (not used by RECORD_TIFF).
+     */
+    void setPath(std::string directory, std::string name);
+
+    /**
+     * @brief Opens the file (RECORD_BINARY, RECORD_CSV, RECORD_COLUMNS) and starts the writer thread.
+     * @return              A flag indicating the status. -1 if the file can't be opened.
+     */
+    int start();
+
+    /**
+     * @brief Called from the thread that reads the socket. Puts a reference to the frame into the queue,
+     * the frame itself is not copied and the disk is never touched.
+     *
+     * @param frame         The frame.
+     * @return              True if the frame will be written, false if it was dropped.
+     */
+    bool push(const FrameRef& frame);
+
+    /**
+     * @brief Writes everything that is still in the queue, then stops the thread and closes the file.
+     */
+    void stop();
+
+    size_t getQueueDepth();                 //!< Frames waiting in the queue now
+    size_t getMaxQueueDepth();              //!< Highest number of frames that were waiting
+    long getDropCount();                    //!< Frames dropped because the queue was full
+    long getWriteCount();                   //!< Frames written to disk
+    double getCompressionRatio();           //!< Raw bytes / written bytes, 1 if not compressed (valid after stop())
+    double getEncodeTime();                 //!< Microseconds of CPU to encode one frame, 0 if not compressed (valid after stop())
+
+    /**
+     * @brief Adds a line to the metadata of the .amode segments (RECORD_BINARY), of the trailer of the depth log
+     * (RECORD_COLUMNS) or of the <name>.meta file (RECORD_TIFF and RECORD_CSV, see writeSidecar()).
+     * Can be called from any thread at any time before stop(), the writer thread owns the writer, so the line is kept
+     * aside and given to the writer in start() or in stop(), which means it is at least in the last segment.
+     *
+     * @param key           Name.
+     * @param value         Value.
+     */
+    void setMetadata(std::string key, std::string value);
+
+protected:
+
+    /**
+     * @brief Gives the metadata from setMetadata() to the writer of the .amode and to the depth log.
+     */
+    void applyMetadata();
+
+    /**
+     * @brief Writes <name>.meta next to the .csv or in the directory of the .tiff files, which have no place for the
+     * metadata, "key=value\n" lines like the footer of the .amode segments.
+     * @return              A flag indicating the status. -1 if the file couldn't be written.
+     */
+    int writeSidecar();
+
+    /**
+     * @brief The writer thread, takes the frames from the queue until stop().
+     */
+    void writeLoop();
+
+    /**
+     * @brief Takes everything which waits in the queue, compresses it and writes it (or writes it with TiffWriter).
+     * @return              The number of frames written, 0 if the queue was empty.
+     */
+    size_t writeBatch();
+
+    /**
+     * @brief Writes one frame to disk.
+     * @param frame         The frame.
+     */
+    void writeFrame(const FrameRef& frame);
+};
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef FRAMEREDUCER_H
+#define FRAMEREDUCER_H
+
+// basic libraries
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * @brief FrameReducer cuts a raw frame (DATA_RAW, probes x samples uint16_t) down to the region of interest,
+ * before anything else sees it: only some of the probes, only a window of every line, and optionally only every
+ * decimation-th sample of the window.
+ *
+ * The reduced frame is still a rectangle (probes x samples), so it is recorded, published and processed like any
+ * frame of the machine, only with a smaller geometry. That is why every probe has its own first sample (the bone
+ * is at another depth under every probe) but all windows have the same length.
+ *
+ * Before decimating, the lines are low-pass filtered (windowed sinc, cut off at the new Nyquist frequency, gain 1
+ * at 0 Hz), the samples next to the window are used for it as far as the line goes. The raw lines carry the echo
+ * at its RF frequency (12% of the sampling frequency in the simulator), a factor which puts the new Nyquist
+ * frequency below the echo (here more than 3) keeps only the baseline, decimate the envelope for more.
+ * One reducer is for one thread, it has its own scratch memory.
+ */
+class FrameReducer
+{
+
+private:
+    int samples_;                           //!< Values per probe of the frame of the machine
+    int probes_;                            //!< Number of probes of the frame of the machine
+
+    std::vector<int> keep_;                 //!< The probes kept, in the order of the reduced frame
+    std::vector<int> first_;                //!< First sample of the window, one per kept probe
+    int length_;                            //!< Samples of every window
+    int decimation_ = 1;                    //!< Every decimation_-th sample of the window is kept
+    int taps_ = 1;                          //!< Length of the low-pass, odd
+
+    std::vector<float> filter_;             //!< The low-pass, taps_ values
+    std::vector<float> line_;               //!< The window of one probe with taps_/2 samples on both sides, as float
+
+public:
+
+    /**
+     * @brief Constructor of the reducer, it keeps everything until it is configured.
+     *
+     * @param samples       Values per probe of the frames of the machine.
+     * @param probes        Number of probes of the frames of the machine.
+     */
+    FrameReducer(int samples, int probes);
+
+    /**
+     * @brief The probes to keep, the probe mask. Call it before setWindow(), it resets the windows to the whole line.
+     *
+     * @param probes        Numbers of the probes (from 0), in the order they have in the reduced frame. Empty keeps all.
+     * @return              A flag indicating the status. -1 if a probe doesn't exist, then nothing changes.
+     */
+    int setProbes(const std::vector<int>& probes);
+
+    /**
+     * @brief The window of every kept probe.
+     *
+     * @param first         First sample, one for all probes or one per kept probe. Empty starts at 0.
+     * @param length        Samples of every window, -1 up to the end of the line (of the window which ends first).
+     * @return              A flag indicating the status. -1 if a window doesn't fit in the line, then nothing changes.
+     */
+    int setWindow(const std::vector<int>& first, int length = -1);
+
+    /**
+     * @brief Keep only every factor-th sample of the windows, after the anti-alias filter.
+     *
+     * @param factor        1 keeps all samples (and there is no filter).
+     * @param taps          Length of the low-pass, 0 for 8 * factor + 1, longer is sharper and slower.
+     * @return              A flag indicating the status. -1 if the factor is less than 1 or longer than the window.
+     */
+    int setDecimation(int factor, int taps = 0);
+
+    /**
+     * @brief Reduces a whole frame.
+     *
+     * @param raw           probes x samples values, as the machine sends them.
+     * @param reduced       Receives getProbes() x getSamples() values.
+     */
+    void process(const uint16_t* raw, uint16_t* reduced);
+
+    /**
+     * @brief Nothing is taken away, the reducer would only copy the frame.
+     */
+    bool isIdentity();
+
+    int getSamples();                       //!< Values per probe of the reduced frame
+    int getProbes();                        //!< Number of probes of the reduced frame
+    int getDecimation();                    //!< Every how many samples one is kept
+    int getTaps();                          //!< Length of the low-pass, 1 without decimation
+    int getLength();                        //!< Samples of a window before the decimation
+
+    /**
+     * @brief The kept probes as text, e.g. "0,1,2,7", for the metadata of the recording.
+     */
+    std::string getProbesText();
+
+    /**
+     * @brief The first sample of every window as text, e.g. "300,310,290,350".
+     */
+    std::string getWindowText();
+
+protected:
+
+    /**
+     * @brief Designs the low-pass for decimation_ with taps_ taps.
+     */
+    void designFilter();
+};
+
+#endif
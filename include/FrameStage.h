@@ -0,0 +1,120 @@
+#ifndef FRAMESTAGE_H
+#define FRAMESTAGE_H
+
+// basic libraries
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <functional>
+
+#include "FrameSubscriber.h"
+#include "FramePool.h"
+
+/**
+ * @brief What a stage computes, from the raw frame into the values of the output frame (output.packet, output.datasize bytes).
+ */
+typedef std::function<void(const FrameSlot& input, FrameSlot& output)> FrameProcess;
+
+/**
+ * @brief FrameStage computes a new frame from every raw frame of a connection on its own thread, while streaming
+ * (the envelope, the depth, ...). It is a subscriber of the raw frames like any other, so if it is too slow it loses
+ * raw frames and the socket never waits. The output frames have their own pool and their own subscribers, with the same
+ * timestamp and index as the raw frame they come from, so a consumer can match them with the raw frames (or the recording).
+ */
+class FrameStage
+{
+
+private:
+    std::string name_;                      //!< For the console, e.g. "envelope"
+    int outputsize_;                        //!< Bytes of an output frame
+    FrameProcess process_;                  //!< Only called from the thread of input_
+    std::unique_ptr<FrameSubscriber> input_; //!< Gets the raw frames, its thread calls process_
+    std::unique_ptr<FramePool> pool_;       //!< The output frames, created in start()
+    std::vector<std::unique_ptr<FrameSubscriber>> subscribers_; //!< Get the output frames
+    bool running_ = false;                  //!< Between start() and stop()
+    int64_t budget_ = 0;                    //!< Nanoseconds from the arrival of the raw frame until the output is there, 0 is no budget
+
+    std::atomic<long> countprocess_{ 0 };   //!< Output frames computed
+    std::atomic<long> countempty_{ 0 };     //!< Raw frames without output, because the pool was empty
+    std::atomic<long> countlate_{ 0 };      //!< Output frames that were later than budget_
+    std::atomic<int64_t> processtime_{ 0 }; //!< Nanoseconds spent in process_, for the mean
+    std::atomic<int64_t> maxlatency_{ 0 };  //!< Longest time from arrival to output
+
+public:
+
+    /**
+     * @brief Constructor of the stage.
+     *
+     * @param name          Name for the console.
+     * @param outputsize    Bytes of an output frame.
+     * @param capacity      How many raw frames can wait for the stage.
+     */
+    FrameStage(std::string name, int outputsize, size_t capacity = 8);
+
+    ~FrameStage();
+
+    /**
+     * @brief What the stage computes. Before start().
+     */
+    void setProcess(FrameProcess process);
+
+    /**
+     * @brief Output frames which are not there this long after the raw frame arrived are counted as late.
+     * @param microseconds  The budget, 0 (default) counts nothing.
+     */
+    void setLatencyBudget(double microseconds);
+
+    /**
+     * @brief A subscriber of the output frames, pulled with pop(). Only before start().
+     *
+     * @param capacity      How many output frames can wait for the subscriber.
+     * @param policy        QUEUE_DROP_OLDEST or QUEUE_DROP_NEWEST.
+     */
+    FrameSubscriber* subscribe(size_t capacity, int policy);
+
+    /**
+     * @brief A subscriber of the output frames with a callback on its own thread. Only before start().
+     *
+     * @param callback      Gets the output frame.
+     * @param capacity      How many output frames can wait for the callback.
+     * @param policy        QUEUE_DROP_OLDEST or QUEUE_DROP_NEWEST.
+     */
+    FrameSubscriber* subscribe(FrameCallback callback, size_t capacity, int policy);
+
+    /**
+     * @brief Allocates the output frames and starts the threads.
+     */
+    void start();
+
+    /**
+     * @brief Called from the thread that reads the socket, never waits.
+     * @param frame         The raw frame.
+     */
+    void push(const FrameRef& frame);
+
+    /**
+     * @brief Computes what is still waiting, then stops all threads and prints the counters.
+     */
+    void stop();
+
+    std::string getName();                  //!< Name for the console
+    size_t getCapacity();                   //!< Raw frames that can wait, the pool of the connection has to hold them
+    long getProcessCount();                 //!< Output frames computed
+    long getDropCount();                    //!< Raw frames dropped because the stage was too slow
+    long getEmptyCount();                   //!< Raw frames dropped because nobody gave the output frames back
+    long getLateCount();                    //!< Output frames over the latency budget
+    double getMeanTime();                   //!< Mean microseconds for one frame in process_
+    double getMaxLatency();                 //!< Longest microseconds from the arrival of a raw frame to its output
+
+protected:
+
+    /**
+     * @brief Called from the thread of input_ for every raw frame.
+     */
+    void process(const FrameSlot& frame);
+};
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef FRAMESUBSCRIBER_H
+#define FRAMESUBSCRIBER_H
+
+// basic libraries
+#include <stdio.h>
+#include <atomic>
+#include <thread>
+#include <functional>
+
+#include "FramePool.h"
+#include "SpscQueue.h"
+
+/**
+ * @brief What a subscriber callback gets, the slot of the pool (values in frame.data) which it must not change.
+ */
+typedef std::function<void(const FrameSlot& frame)> FrameCallback;
+
+/**
+ * @brief FrameSubscriber is one consumer of the frames of an AModeUSConnection, next to the recorder.
+ * The thread that reads the socket pushes a reference to every frame into the queue of every subscriber,
+ * the frame itself is never copied, all subscribers look at the same slot of the pool.
+ * The queue never blocks (QUEUE_DROP_OLDEST or QUEUE_DROP_NEWEST), so a slow subscriber only loses its own frames,
+ * it doesn't slow down the socket or the other subscribers.
+ *
+ * Either pull the frames with pop() from one thread of your own, or give a callback, then the subscriber has
+ * its own thread which calls it for every frame.
+ */
+class FrameSubscriber
+{
+
+private:
+    SpscQueue<FrameRef> queue_;             //!< Frames waiting for this subscriber
+    FrameCallback callback_;                //!< Called from thread_, empty for a subscriber that is pulled
+    std::thread thread_;                    //!< Calls callback_
+    std::atomic<bool> stop_{ false };       //!< Set by stop(), the thread delivers what is left then finishes
+    std::atomic<long> countdeliver_{ 0 };   //!< Frames given to the callback or taken with pop()
+    FrameRef current_;                      //!< The frame the callback is looking at
+
+public:
+
+    /**
+     * @brief Constructor of a subscriber which is pulled with pop().
+     *
+     * @param capacity      How many frames can wait for the subscriber.
+     * @param policy        QUEUE_DROP_OLDEST (the latest frames are kept) or QUEUE_DROP_NEWEST, QUEUE_BLOCK is not allowed.
+     */
+    FrameSubscriber(size_t capacity, int policy);
+
+    /**
+     * @brief Constructor of a subscriber with a callback, the thread for it is started in start().
+     *
+     * @param callback      Called for every frame from the thread of the subscriber.
+     * @param capacity      How many frames can wait for the callback.
+     * @param policy        QUEUE_DROP_OLDEST or QUEUE_DROP_NEWEST, QUEUE_BLOCK is not allowed.
+     */
+    FrameSubscriber(FrameCallback callback, size_t capacity, int policy);
+
+    ~FrameSubscriber();
+
+    /**
+     * @brief Starts the thread of the callback, nothing for a subscriber that is pulled.
+     */
+    void start();
+
+    /**
+     * @brief Called from the thread that reads the socket, never waits.
+     * @param frame         The frame.
+     * @return              True if the frame is queued for the subscriber, false if it was dropped.
+     */
+    bool push(const FrameRef& frame);
+
+    /**
+     * @brief Takes the next frame, only for a subscriber without callback and only from one thread.
+     * The reference which frame had before is given back first.
+     *
+     * @param frame         Receives the reference, keep it only as long as you need the frame, the pool is not endless.
+     * @return              False if there is no frame.
+     */
+    bool pop(FrameRef& frame);
+
+    /**
+     * @brief Delivers what is still in the queue to the callback, then stops its thread.
+     */
+    void stop();
+
+    size_t getQueueDepth();                 //!< Frames waiting now
+    size_t getCapacity();                   //!< Frames that can wait
+    long getDeliverCount();                 //!< Frames the subscriber got
+    long getDropCount();                    //!< Frames dropped because the subscriber was too slow
+
+protected:
+
+    /**
+     * @brief The thread of the callback.
+     */
+    void deliverLoop();
+};
+
+#endif
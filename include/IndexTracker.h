@@ -0,0 +1,113 @@
+#ifndef INDEXTRACKER_H
+#define INDEXTRACKER_H
+
+// basic libraries
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <atomic>
+
+#define INDEXTRACKER_MAXRANGES 1024         //!< Missing ranges which are kept, the later ones are only counted
+#define INDEXTRACKER_REORDERWINDOW 16       //!< How many of the last ranges are searched for a frame that comes late
+
+/**
+ * @brief A run of frames that never arrived, by the index of the machine.
+ */
+struct IndexRange
+{
+    uint64_t first;                         //!< Index of the first missing frame (wrapped like the index of the machine)
+    uint64_t count;                         //!< Number of missing frames
+    double timestamp;                       //!< When the gap was noticed (the frame after it arrived)
+};
+
+/**
+ * @brief IndexTracker follows the index that the machine puts in every packet and counts what went wrong.
+ * The index goes up by one for every frame and wraps around (16 bits for DATA_RAW, 64 bits for DATA_DEPTH).
+ * A jump forward is a gap (frames lost before they reached us, e.g. on the network), an index that
+ * was already seen is a duplicate, and an index from a gap that arrives later is a reordered frame.
+ * Frames which were received but not recorded are not counted here, the recorder counts those,
+ * so the two numbers tell network loss from a disk that can't keep up.
+ *
+ * update() is called from the thread that reads the socket. The counters can be read from any thread,
+ * getMissingRanges() only when the streaming stopped.
+ */
+class IndexTracker
+{
+
+private:
+    int indexbits_;                         //!< Width of the index
+    uint64_t mask_;                         //!< 2^indexbits_ - 1
+    bool started_ = false;                  //!< The first index was seen
+    uint64_t expected_ = 0;                 //!< The index the next frame should have
+
+    std::vector<IndexRange> ranges_;        //!< Missing ranges, oldest first (at most INDEXTRACKER_MAXRANGES)
+
+    // running totals
+    std::atomic<long> countreceived_{ 0 };  //!< Frames with an index
+    std::atomic<long> countmissing_{ 0 };   //!< Frames in gaps which didn't arrive (yet)
+    std::atomic<long> countgap_{ 0 };       //!< Number of jumps forward
+    std::atomic<long> countduplicate_{ 0 }; //!< Frames with an index that was already seen
+    std::atomic<long> countreorder_{ 0 };   //!< Frames that came after a later frame
+
+    // loss rate per second
+    double secondstart_ = 0.0;              //!< Start of the current second
+    long secondreceived_ = 0;               //!< Frames in the current second
+    long secondmissing_ = 0;                //!< Missing frames noticed in the current second
+    std::atomic<double> lossrate_{ 0.0 };   //!< Missing / expected frames of the last complete second
+    std::atomic<double> maxlossrate_{ 0.0 };//!< Highest lossrate_ of the session
+
+public:
+
+    /**
+     * @brief Constructor of the tracker.
+     * @param indexbits     Width of the index, 16 for DATA_RAW, 64 for DATA_DEPTH.
+     */
+    IndexTracker(int indexbits);
+
+    /**
+     * @brief Forget everything, e.g. for a new session.
+     */
+    void reset();
+
+    /**
+     * @brief Checks the index of a frame that just arrived.
+     *
+     * @param index         The index the machine sent.
+     * @param timestamp     When the frame arrived, seconds of any clock that doesn't jump.
+     */
+    void update(uint64_t index, double timestamp);
+
+    long getReceivedCount();                //!< Frames seen
+    long getMissingCount();                 //!< Frames which never arrived
+    long getGapCount();                     //!< Jumps forward
+    long getDuplicateCount();               //!< Frames seen twice
+    long getReorderCount();                 //!< Frames that came late
+    double getLossRate();                   //!< Fraction of the frames of the last complete second that are missing
+    double getMaxLossRate();                //!< Highest getLossRate() of the session
+
+    /**
+     * @brief The missing ranges, at most INDEXTRACKER_MAXRANGES. Only when update() is not called anymore.
+     */
+    const std::vector<IndexRange>& getMissingRanges();
+
+    /**
+     * @brief The missing ranges as text, "first-last,first-last,..." with the wrapped index of the machine.
+     * @param maxranges     Only the first maxranges ranges.
+     */
+    std::string getMissingRangesText(size_t maxranges);
+
+protected:
+
+    /**
+     * @brief A frame older than expected_ arrived, looks if it fills one of the last gaps.
+     * @return              True if it was missing, false if it is a duplicate.
+     */
+    bool fillGap(uint64_t index);
+
+    /**
+     * @brief Counts a frame for the loss rate, closes the second when it is over.
+     */
+    void countSecond(double timestamp, long received, long missing);
+};
+
+#endif
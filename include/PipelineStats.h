@@ -0,0 +1,198 @@
+#ifndef PIPELINESTATS_H
+#define PIPELINESTATS_H
+
+// Everything in this file only exists when the project is built with AMODE_ENABLE_STATS
+// (cmake -DAMODE_ENABLE_STATS=ON), otherwise the streaming has no instrumentation at all.
+#ifdef AMODE_ENABLE_STATS
+
+// basic libraries
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#define STATS_SUBBITS 5                     //!< 2^STATS_SUBBITS buckets between two powers of two, about 3% resolution
+#define STATS_BUCKETS ((65 - STATS_SUBBITS) << STATS_SUBBITS) //!< Buckets that cover every uint64_t
+
+// the stages of the pipeline which are measured
+#define STATS_INTERARRIVAL 0                //!< Between two complete packets
+#define STATS_RECEIVE 1                     //!< From the first bytes of a packet out of recv() until the packet is complete
+#define STATS_QUEUEWAIT 2                   //!< From the push into the queue of the recorder until the writer thread takes it
+#define STATS_WRITE 3                       //!< Writing one frame, with its share of the encoding if compressed
+#define STATS_STAGES 4
+
+/**
+ * @brief Nanoseconds of a monotonic clock, only for differences.
+ */
+inline int64_t statsNow() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief A histogram with log-linear buckets (like HdrHistogram), the memory is fixed in the object.
+ * Values below 2^STATS_SUBBITS have their own bucket, above that every power of two is split in
+ * 2^STATS_SUBBITS buckets, so the error of a percentile is at most about 3% of the value.
+ *
+ * Only one thread records into a histogram, any thread can read it at the same time
+ * (the counts are atomic, a reader only may see a frame in the count but not yet in the buckets).
+ */
+class LatencyHistogram
+{
+
+private:
+    std::atomic<uint64_t> buckets_[STATS_BUCKETS]; //!< Values per bucket
+    std::atomic<uint64_t> count_{ 0 };      //!< Values recorded
+    std::atomic<uint64_t> sum_{ 0 };        //!< Sum of the values, for the mean
+    std::atomic<uint64_t> max_{ 0 };        //!< Largest value, exact
+
+public:
+
+    LatencyHistogram();
+
+    /**
+     * @brief Adds a value, only from one thread. No locks and no allocation.
+     * @param value         Nanoseconds, negative values are counted as 0.
+     */
+    void record(int64_t value) {
+        uint64_t v = (value > 0) ? (uint64_t)value : 0;
+        std::atomic<uint64_t>& bucket = buckets_[bucketIndex(v)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        sum_.store(sum_.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+        if (v > max_.load(std::memory_order_relaxed)) max_.store(v, std::memory_order_relaxed);
+        count_.store(count_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /**
+     * @brief The value below which the fraction q of the values are, the upper end of its bucket.
+     * @param q             0..1, e.g. 0.99.
+     * @return              Nanoseconds, 0 if empty.
+     */
+    uint64_t getPercentile(double q);
+
+    uint64_t getCount();                    //!< Values recorded
+    uint64_t getMax();                      //!< Largest value
+    double getMean();                       //!< Average value
+
+    /**
+     * @brief Forget all values, only when nobody records.
+     */
+    void reset();
+
+    /**
+     * @brief The bucket of a value.
+     */
+    static int bucketIndex(uint64_t value) {
+        if (value < (1u << STATS_SUBBITS)) return (int)value;
+        int msb = 63 - countLeadingZeros(value);
+        int shift = msb - STATS_SUBBITS;
+        return (shift << STATS_SUBBITS) + (int)(value >> shift);
+    }
+
+    /**
+     * @brief The largest value which is counted in a bucket.
+     */
+    static uint64_t bucketUpper(int index);
+
+protected:
+
+    static int countLeadingZeros(uint64_t value) {
+#if defined(_MSC_VER)
+        unsigned long bit;
+        _BitScanReverse64(&bit, value);
+        return 63 - (int)bit;
+#else
+        return __builtin_clzll(value);
+#endif
+    }
+};
+
+/**
+ * @brief PipelineStats has a histogram for every stage of the streaming (STATS_INTERARRIVAL, ...)
+ * and writes their percentiles as one json object per line, every interval seconds from its own thread and once
+ * more in stop(), so the threads that stream never format or write anything.
+ *
+ * {"time":1700000000.123,"final":false,"profile":"default","unit":"ns","stages":{"interarrival":{"count":..,"mean":..,"p50":..,"p99":..,"p999":..,"max":..},...}}
+ */
+class PipelineStats
+{
+
+private:
+    LatencyHistogram histograms_[STATS_STAGES]; //!< One per stage
+
+    // the thread that writes the percentiles
+    std::string path_;                      //!< File the lines are appended to, empty is stdout
+    std::string profile_ = "default";       //!< How the connection received, so the lines of two profiles can be told apart
+    double interval_ = -1.0;                //!< Seconds between two lines, 0 only writes in stop(), -1 not started
+    std::thread thread_;                    //!< Reporting thread
+    std::mutex mutex_;                      //!< For the condition variable
+    std::condition_variable condition_;     //!< Wakes the reporting thread in stop()
+    bool stop_ = false;                     //!< Set by stop()
+
+public:
+
+    ~PipelineStats();
+
+    /**
+     * @brief Adds a value to the histogram of a stage, the stage must always be recorded from the same thread.
+     *
+     * @param stage         STATS_INTERARRIVAL, STATS_RECEIVE, STATS_QUEUEWAIT or STATS_WRITE.
+     * @param value         Nanoseconds.
+     */
+    void record(int stage, int64_t value) {
+        histograms_[stage].record(value);
+    }
+
+    /**
+     * @brief The histogram of a stage.
+     */
+    LatencyHistogram& getHistogram(int stage);
+
+    /**
+     * @brief Starts the reporting thread.
+     *
+     * @param path          File the json lines are appended to, empty writes to stdout.
+     * @param interval      Seconds between two lines, 0 only writes the final line.
+     */
+    void start(std::string path, double interval);
+
+    /**
+     * @brief Name of the receive profile in every line ("profile"), e.g. "default" or "busypoll".
+     */
+    void setProfile(std::string profile);
+
+    /**
+     * @brief Stops the reporting thread and writes the final line.
+     */
+    void stop();
+
+    /**
+     * @brief All stages as one json object, without newline.
+     * @param final         The value of "final", true for the line at the end of the session.
+     */
+    std::string toJson(bool final);
+
+    static const char* getStageName(int stage); //!< Name of a stage in the json
+
+protected:
+
+    /**
+     * @brief Appends a line to path_ (or stdout).
+     */
+    void writeLine(bool final);
+
+    /**
+     * @brief The reporting thread.
+     */
+    void reportLoop();
+};
+
+#endif
+
+#endif
@@ -0,0 +1,240 @@
+#ifndef RECORDINGREADER_H
+#define RECORDINGREADER_H
+
+// basic libraries
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <memory>
+
+#include "AModeRecording.h"
+#include "FrameCodec.h"
+
+/**
+ * @brief A view of one recorded frame, it points directly into the memory mapped file, nothing is copied.
+ * It stays valid as long as the RecordingReader which created it is open.
+ */
+struct FrameView
+{
+    int64_t timestamp = 0;                  //!< When the frame arrived, see RecordingHeader::clock
+    uint64_t index = 0;                     //!< Index sent by the machine
+    long ordinal = -1;                      //!< Position of the frame in the session, starting from 0
+    int samples = 0;                        //!< Values per probe
+    int probes = 0;                         //!< Number of probes
+    uint32_t codec = RECORDING_CODEC_NONE;  //!< RECORDING_CODEC_NONE if payload can be read directly
+    uint32_t payloadsize = 0;               //!< Bytes of the payload
+    const char* payload = nullptr;          //!< The values, probe after probe
+
+    /**
+     * @brief The values of one probe, samples values long. Only for frames with RECORDING_CODEC_NONE.
+     * @tparam T        uint16_t for DATA_RAW, double for DATA_DEPTH.
+     */
+    template <typename T>
+    const T* line(int probe) const { return (const T*)payload + (size_t)probe * samples; }
+};
+
+/**
+ * @brief RecordingReader opens a session recorded in the .amode format (see AModeRecording.h) for offline analysis.
+ * All segments are memory mapped, so reading a frame is only looking up its position in the index,
+ * by ordinal it is O(1), by device index it is nearly O(1) since the frames are almost always consecutive,
+ * by timestamp it is a binary search. Use Iterator to go through the whole session, it tells the OS to
+ * read ahead so the scan is not slowed down by page faults.
+ *
+ * Usage:
+ * @code
+ * RecordingReader reader;
+ * reader.open("D:\\amodestream\\log", "1667213412.123456");
+ * FrameView frame;
+ * for (RecordingReader::Iterator it = reader.begin(); it.next(frame);) {
+ *     const uint16_t* line = frame.line<uint16_t>(0);
+ * }
+ * // if the session was compressed
+ * std::vector<uint16_t> values;
+ * reader.decode(1234, values);
+ * @endcode
+ */
+class RecordingReader
+{
+
+private:
+    /**
+     * @brief One mapped segment file.
+     */
+    struct Segment
+    {
+        const char* data = nullptr;             //!< Start of the mapping
+        uint64_t size = 0;                      //!< Bytes of the file
+        const RecordingHeader* header = nullptr;//!< Header at the start of data
+        const RecordingIndexEntry* index = nullptr; //!< Index from the footer, or indexcopy.data() if it was rebuilt
+        std::vector<RecordingIndexEntry> indexcopy; //!< Index rebuilt by scanning, when the footer is missing
+        long firstframe = 0;                    //!< Ordinal of the first frame
+        long framecount = 0;                    //!< Number of frames
+        std::string metadata;                   //!< Metadata text of this segment
+#ifdef _WIN32
+        void* filehandle = nullptr;             //!< HANDLE of the file
+        void* maphandle = nullptr;              //!< HANDLE of the mapping
+#endif
+    };
+
+    std::vector<Segment> segments_;         //!< All segments of the session, in order
+    long framecount_ = 0;                   //!< Frames in the whole session
+    int datamode_ = 0;                      //!< DATA_RAW or DATA_DEPTH
+    int samples_ = 0;                       //!< Values per probe
+    int probes_ = 0;                        //!< Number of probes
+    int valuesize_ = 0;                     //!< Bytes per value
+    int indexbits_ = 64;                    //!< Width of the device index, it wraps around after 2^indexbits_
+
+    // for RECORDING_CODEC_PACK16
+    std::unique_ptr<FrameCodec> codec_;     //!< Created in open() for DATA_RAW
+    std::vector<uint16_t> decoded_;         //!< The last decoded frame, the next one is predicted from it
+    std::vector<uint16_t> decoding_;        //!< The frame being decoded
+    long decodedordinal_ = -1;              //!< Ordinal of decoded_, -1 if there is none
+
+public:
+
+    /**
+     * @brief Goes through the frames one after another and asks the OS to read the next part of the file in advance.
+     */
+    class Iterator
+    {
+    private:
+        RecordingReader* reader_;           //!< The reader
+        long ordinal_;                      //!< Next frame
+        long last_;                         //!< One after the last frame
+        uint64_t prefetched_ = 0;           //!< File position up to which the prefetch was requested
+        int segment_ = -1;                  //!< Segment of prefetched_
+
+    public:
+        Iterator(RecordingReader* reader, long first, long last);
+
+        /**
+         * @brief Gets the next frame.
+         * @param frame     Receives the view.
+         * @return          False when there are no more frames.
+         */
+        bool next(FrameView& frame);
+    };
+
+    RecordingReader();
+
+    ~RecordingReader();
+
+    /**
+     * @brief Opens a session, all the segments <name>_0000.amode, <name>_0001.amode, ... are mapped.
+     *
+     * @param directory     Directory of the segments.
+     * @param name          Name of the session.
+     * @return              A flag indicating the status. -1 if there is something wrong.
+     */
+    int open(std::string directory, std::string name);
+
+    /**
+     * @brief Unmaps everything, all FrameView become invalid.
+     */
+    void close();
+
+    /**
+     * @brief Gets a frame by its position in the session. O(1).
+     *
+     * @param ordinal       Position, 0 .. getFrameCount()-1.
+     * @param frame         Receives the view.
+     * @return              False if ordinal is out of range.
+     */
+    bool frame(long ordinal, FrameView& frame);
+
+    /**
+     * @brief Gets the values of a DATA_RAW frame, also if it was compressed (RECORDING_CODEC_PACK16).
+     * A compressed frame may need the frames before it up to the last keyframe, so going through the frames
+     * in order is fast, jumping around decodes up to a keyinterval of frames for every jump.
+     *
+     * @param ordinal       Position, 0 .. getFrameCount()-1.
+     * @param values        Receives samples*probes values.
+     * @return              A flag indicating the status. -1 if the frame can't be decoded.
+     */
+    int decode(long ordinal, std::vector<uint16_t>& values);
+
+    /**
+     * @brief Finds the frame with the index the machine sent.
+     * The raw index is only 16 bits, so it repeats every 65536 frames, the search starts at from.
+     *
+     * @param index         The device index.
+     * @param from          The first ordinal that is considered.
+     * @return              The ordinal of the frame, -1 if there is no such frame.
+     */
+    long findIndex(uint64_t index, long from = 0);
+
+    /**
+     * @brief Finds the first frame with timestamp >= the given timestamp. Binary search.
+     *
+     * @param timestamp     Timestamp, same clock as the recording.
+     * @return              The ordinal, getFrameCount() if all frames are older.
+     */
+    long findTimestamp(int64_t timestamp);
+
+    /**
+     * @brief Iterator over all frames.
+     */
+    Iterator begin();
+
+    /**
+     * @brief Iterator over the frames with from <= timestamp < to.
+     */
+    Iterator range(int64_t from, int64_t to);
+
+    /**
+     * @brief A value from the metadata of the last segment.
+     *
+     * @param key           Name.
+     * @return              The value, empty if the key doesn't exist.
+     */
+    std::string getMetadata(std::string key);
+
+    long getFrameCount();                   //!< Frames in the session
+    int getSegmentCount();                  //!< Segment files in the session
+    int getDataMode();                      //!< DATA_RAW or DATA_DEPTH
+    int getSamples();                       //!< Values per probe
+    int getProbes();                        //!< Number of probes
+    int getValueSize();                     //!< Bytes per value
+    const RecordingHeader* getHeader();     //!< Header of the first segment, nullptr if not open
+
+    /**
+     * @brief Converts a timestamp of the recording to the wall clock, with the anchor in the header.
+     * @param timestamp     Timestamp, same clock as the recording.
+     * @return              Nanoseconds since 1970.
+     */
+    int64_t toWallTime(int64_t timestamp);
+
+protected:
+
+    /**
+     * @brief Maps a segment file and reads its index.
+     * @return              A flag indicating the status. -1 if the file doesn't exist or is not a segment.
+     */
+    int openSegment(std::string filepath, Segment& segment);
+
+    /**
+     * @brief Unmaps a segment file.
+     */
+    void closeSegment(Segment& segment);
+
+    /**
+     * @brief Builds the index by walking from record to record, for segments without footer (crashed session).
+     */
+    void rebuildIndex(Segment& segment);
+
+    /**
+     * @brief Finds the segment of an ordinal.
+     * @return              Position in segments_.
+     */
+    int findSegment(long ordinal);
+
+    /**
+     * @brief Asks the OS to read a part of the segment in advance.
+     */
+    void prefetch(int segment, uint64_t offset, uint64_t size);
+
+    friend class Iterator;
+};
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef RECORDINGWRITER_H
+#define RECORDINGWRITER_H
+
+// basic libraries
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <utility>
+#include <stdint.h>
+
+#include "AModeRecording.h"
+#include "AsyncFileWriter.h"
+
+/**
+ * @brief RecordingWriter writes a session in the binary format described in AModeRecording.h.
+ * The records are collected in a big buffer which is written when it is full, so the disk sees large sequential
+ * appends, and there is only one file create per segment instead of one per frame. The buffers are written by
+ * AsyncFileWriter, with io_uring (if the kernel has it) a few of them are on their way to the disk while the next
+ * one is filled, and every segment is preallocated, so a write() doesn't wait for the disk or the filesystem.
+ * Not thread safe, it is used only by the writer thread of FrameRecorder.
+ */
+class RecordingWriter
+{
+
+private:
+    // where to write
+    std::string directory_;                 //!< Directory of the segments
+    std::string name_;                      //!< Segments are called <name_>_<segment>.amode
+    AsyncFileWriter file_;                  //!< The segment being written
+    RecordingHeader header_;                //!< Header of the session, segment and firstframe change per segment
+    bool preallocate_ = true;               //!< Reserve the blocks of a whole segment when it is created
+
+    // the write buffer
+    size_t buffered_ = 0;                   //!< Bytes used in the buffer of file_
+    size_t buffersize_ = 8 << 20;           //!< Size of a buffer (default 8 MB)
+    int inflight_ = 4;                      //!< Buffers being written at the same time (io_uring only)
+
+    // the segment
+    uint64_t segmentsize_ = 1ull << 30;     //!< Start a new segment after this many bytes (default 1 GB)
+    uint64_t segmentoffset_ = 0;            //!< Bytes in the current segment (written and buffered)
+    std::vector<RecordingIndexEntry> index_;//!< Index of the current segment
+    std::vector<std::pair<std::string, std::string>> metadata_; //!< Written at the end of every segment
+
+    // for statistics
+    uint64_t countframe_ = 0;               //!< Frames written in the whole session
+    uint64_t countbyte_ = 0;                //!< Bytes written in the whole session
+
+public:
+
+    RecordingWriter();
+
+    ~RecordingWriter();
+
+    /**
+     * @brief Size of the write buffer, call before open().
+     * @param buffersize    Bytes, should be a few frames at least.
+     */
+    void setBufferSize(size_t buffersize);
+
+    /**
+     * @brief How the buffers go to the disk, call before open().
+     *
+     * @param backend       FILEWRITER_AUTO (default, io_uring if the kernel has it), FILEWRITER_BUFFERED or FILEWRITER_IOURING.
+     * @param direct        Bypass the page cache with O_DIRECT (io_uring only).
+     * @param inflight      Buffers being written at the same time (io_uring only, default 4).
+     * @param preallocate   Reserve the space of a whole segment when it is created (linux only, default true).
+     */
+    void setBackend(int backend, bool direct = false, int inflight = 4, bool preallocate = true);
+
+    /**
+     * @brief A new segment is started when the current one is bigger than this, or when it has as many frames as an
+     * uncompressed segment of this size (the index is allocated for that many when the segment is opened).
+     * @param segmentsize   Bytes.
+     */
+    void setSegmentSize(uint64_t segmentsize);
+
+    /**
+     * @brief Starts the session and creates the first segment.
+     *
+     * @param directory     Directory of the segments, it has to exist.
+     * @param name          Name of the session, the segments are called <name>_0000.amode, <name>_0001.amode, ...
+     * @param datamode      DATA_RAW or DATA_DEPTH.
+     * @param samples       Values per probe.
+     * @param probes        Number of probes.
+     * @param valuesize     Bytes per value.
+     * @param clock         What the timestamps are, RECORDING_CLOCK_WALL or RECORDING_CLOCK_MONOTONIC.
+     * @param clockorigin   Timestamp when the session started.
+     * @param wallorigin    Nanoseconds since 1970 at clockorigin.
+     * @return              A flag indicating the status. -1 if the file can't be created.
+     */
+    int open(std::string directory, std::string name, int datamode, int samples, int probes, int valuesize,
+        int clock, int64_t clockorigin, int64_t wallorigin);
+
+    /**
+     * @brief Appends one frame.
+     *
+     * @param timestamp     When the frame arrived.
+     * @param index         Index sent by the machine.
+     * @param payload       The values.
+     * @param payloadsize   Bytes of the values.
+     * @param codec         RECORDING_CODEC_NONE or the codec used to compress payload.
+     * @return              A flag indicating the status. -1 if writing failed, also if the segment closed before
+     *                      this frame failed (the frame is in the next segment then).
+     */
+    int write(int64_t timestamp, uint64_t index, const char* payload, uint32_t payloadsize, uint32_t codec = RECORDING_CODEC_NONE);
+
+    /**
+     * @brief Adds (or replaces) one line of the metadata, which is written when a segment is closed.
+     *
+     * @param key           Name, without '=' and newline.
+     * @param value         Value, without newline.
+     */
+    void setMetadata(std::string key, std::string value);
+
+    /**
+     * @brief Writes the index, metadata and footer of the current segment and closes it.
+     * @return              A flag indicating the status. -1 if writing failed.
+     */
+    int close();
+
+    bool isOpen();                          //!< A session is open
+    int getBackend();                       //!< FILEWRITER_BUFFERED or FILEWRITER_IOURING, what the current segment uses
+    uint64_t getFrameCount();               //!< Frames written in the session
+    uint64_t getByteCount();                //!< Bytes written in the session (all segments)
+
+protected:
+
+    /**
+     * @brief Creates the next segment file and writes its header.
+     * @return              A flag indicating the status. -1 if the file can't be created.
+     */
+    int openSegment();
+
+    /**
+     * @brief Writes the index, metadata and footer, then closes the segment file.
+     * @param wait          Wait until everything is on the disk, false when the next segment follows.
+     * @return              A flag indicating the status. -1 if writing failed.
+     */
+    int closeSegment(bool wait);
+
+    /**
+     * @brief Appends bytes to the buffer, the full buffer goes to the file and the rest to the next buffer,
+     * so every write but the last of a segment is a whole buffer (O_DIRECT needs that).
+     * @return              A flag indicating the status. -1 if writing failed.
+     */
+    int append(const void* data, size_t size);
+
+    /**
+     * @brief Writes what is in the buffer to the file, only when the segment is closed.
+     * @return              A flag indicating the status. -1 if writing failed.
+     */
+    int flush();
+};
+
+#endif
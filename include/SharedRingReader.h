@@ -0,0 +1,127 @@
+#ifndef SHAREDRINGREADER_H
+#define SHAREDRINGREADER_H
+
+// basic libraries
+#include <stdio.h>
+#include <string>
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include "AModeSharedRing.h"
+
+// what next() found
+#define SHAREDRING_FRAME 0                  //!< frame is the next frame
+#define SHAREDRING_EMPTY 1                  //!< No new frame yet, try again later
+#define SHAREDRING_CLOSED 2                 //!< The writer closed the ring, open() again for the next session
+
+/**
+ * @brief A frame in the shared ring, only a view: the values are still in the ring and the writer will overwrite
+ * them when it comes round again, check isValid() after using them.
+ */
+struct SharedFrame
+{
+    uint64_t sequence = 0;                  //!< Number of the frame since the writer started
+    int64_t timestamp = 0;                  //!< When the frame arrived, FrameClock::now() of the writer
+    uint64_t index = 0;                     //!< Index sent by the machine
+    const char* data = nullptr;             //!< The values, uint16_t for DATA_RAW, double for DATA_DEPTH
+    uint32_t datasize = 0;                  //!< Bytes of the values
+};
+
+/**
+ * @brief SharedRingReader maps the ring of a SharedRingWriter read-only, for the processes which want the frames live.
+ * Every reader has its own position, a reader which is slower than the writer skips the frames that were
+ * overwritten and counts them in getLostCount(). Nothing here waits, call next() as often as you like.
+ * It doesn't need anything of the connection, only this file, AModeSharedRing.h and the OS.
+ */
+class SharedRingReader
+{
+
+private:
+    std::string name_;                      //!< Name of the shared memory
+    const char* memory_ = nullptr;          //!< The mapping, nullptr if not open
+    size_t size_ = 0;                       //!< Bytes of the mapping
+    const SharedRingHeader* header_ = nullptr; //!< At the beginning of memory_
+    uint64_t next_ = 0;                     //!< Number of the next frame for this reader
+    long countlost_ = 0;                    //!< Frames which were overwritten before this reader got them
+#ifdef _WIN32
+    HANDLE mapping_ = NULL;                 //!< The named file mapping
+#endif
+
+public:
+
+    ~SharedRingReader();
+
+    /**
+     * @brief Maps the ring, the next frame is the newest one which is complete.
+     * @param name          Name the writer created it with.
+     * @return              A flag indicating the status. -1 if there is no such ring (yet).
+     */
+    int open(std::string name);
+
+    /**
+     * @brief Unmaps the ring, all SharedFrame become invalid.
+     */
+    void close();
+
+    /**
+     * @brief Gets the next frame of this reader. If the writer went round the ring since the last call,
+     * the frames that are gone are skipped and counted as lost.
+     *
+     * @param frame         Receives the view.
+     * @return              SHAREDRING_FRAME, SHAREDRING_EMPTY or SHAREDRING_CLOSED.
+     */
+    int next(SharedFrame& frame);
+
+    /**
+     * @brief Jumps to the newest frame, for readers that only want to show what is happening now.
+     *
+     * @param frame         Receives the view.
+     * @return              SHAREDRING_FRAME, SHAREDRING_EMPTY or SHAREDRING_CLOSED.
+     */
+    int latest(SharedFrame& frame);
+
+    /**
+     * @brief Checks that the writer didn't overwrite the frame yet. Call it after using the values,
+     * if it returns false the values might have been a mix of two frames.
+     */
+    bool isValid(const SharedFrame& frame);
+
+    /**
+     * @brief Copies the values and checks that they are one frame.
+     * @param buffer        At least frame.datasize bytes.
+     * @return              False if the frame was overwritten.
+     */
+    bool copy(const SharedFrame& frame, void* buffer);
+
+    /**
+     * @brief Checks if the process that writes still runs, the ring stops without SHAREDRING_CLOSED when it crashed.
+     * It asks the OS, so call it when next() was empty for a while, not for every frame.
+     */
+    bool isWriterAlive();
+
+    long getLostCount();                    //!< Frames this reader lost because it was too slow
+    uint64_t getPublishedCount();           //!< Frames the writer published
+    int getDataMode();                      //!< DATA_RAW or DATA_DEPTH
+    int getSamples();                       //!< Values per probe
+    int getProbes();                        //!< Number of probes
+    int getSlotCount();                     //!< Frames the ring holds
+    const SharedRingHeader* getHeader();    //!< The header, nullptr if not open
+
+protected:
+
+    /**
+     * @brief The slot of frame n.
+     */
+    const SharedSlotHeader* slot(uint64_t n);
+
+    /**
+     * @brief Reads frame n if it is (still) in the ring.
+     * @return              True if frame has frame n.
+     */
+    bool read(uint64_t n, SharedFrame& frame);
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef SHAREDRINGWRITER_H
+#define SHAREDRINGWRITER_H
+
+// basic libraries
+#include <stdio.h>
+#include <string>
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include "AModeSharedRing.h"
+#include "FramePool.h"
+
+/**
+ * @brief SharedRingWriter creates the shared memory ring (see AModeSharedRing.h) and publishes the frames into it.
+ * Only one thread publishes. The values are copied once into the ring, the readers don't copy anything.
+ */
+class SharedRingWriter
+{
+
+private:
+    std::string name_;                      //!< Name of the shared memory, without the leading /
+    char* memory_ = nullptr;                //!< The mapping, nullptr if not open
+    size_t size_ = 0;                       //!< Bytes of the mapping
+    SharedRingHeader* header_ = nullptr;    //!< At the beginning of memory_
+    uint64_t published_ = 0;                //!< Frames published, same as header_->published
+#ifdef _WIN32
+    HANDLE mapping_ = NULL;                 //!< The named file mapping
+#endif
+
+public:
+
+    ~SharedRingWriter();
+
+    /**
+     * @brief Creates the ring, a ring with the same name which is still there (e.g. after a crash) is replaced.
+     *
+     * @param name          Name of the ring, the readers open it with the same name.
+     * @param datamode      DATA_RAW or DATA_DEPTH.
+     * @param samples       Values per probe.
+     * @param probes        Number of probes.
+     * @param valuesize     Bytes per value.
+     * @param slots         Frames the ring holds, a reader can be that many frames behind.
+     * @param clockorigin   FrameClock::now() at wallorigin, so readers can get the wall time.
+     * @param wallorigin    Nanoseconds since 1970 at clockorigin.
+     * @return              A flag indicating the status. -1 if the shared memory can't be created.
+     */
+    int open(std::string name, int datamode, int samples, int probes, int valuesize, int slots, int64_t clockorigin, int64_t wallorigin);
+
+    /**
+     * @brief Copies a frame into the next slot, the readers see it as soon as this returns.
+     * @param frame         The frame, frame.datasize has to fit in a slot.
+     */
+    void publish(const FrameSlot& frame);
+
+    /**
+     * @brief Tells the readers that nothing comes anymore and removes the ring, readers which still have it
+     * mapped keep it until they close it.
+     */
+    void close();
+
+    bool isOpen();                          //!< The ring exists
+    uint64_t getPublishedCount();           //!< Frames published
+};
+
+#endif
@@ -0,0 +1,227 @@
+#ifndef SOCKETCOMPAT_H
+#define SOCKETCOMPAT_H
+
+// The connection was originally written against Winsock only. This header maps the handful of
+// Winsock names we use onto BSD sockets, so the same code also runs on Linux (e.g. against the
+// loopback simulator). On Windows it only pulls in Winsock, nothing changes there.
+
+#ifdef _WIN32
+
+// these libraries is for windows connection
+#include <winsock2.h>
+#include <ws2tcpip.h>
+// need to connect the lib that is needed by winsock
+#pragma comment(lib, "Ws2_32.lib")
+#pragma comment (lib, "Mswsock.lib")
+#pragma comment (lib, "AdvApi32.lib")
+
+// winsock never raises SIGPIPE, so the flag we pass to send() on posix is meaningless here
+#define MSG_NOSIGNAL        0
+
+#else
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <poll.h>
+
+typedef int SOCKET;
+
+#define INVALID_SOCKET      (-1)
+#define SOCKET_ERROR        (-1)
+#define SD_RECEIVE          SHUT_RD
+#define SD_SEND             SHUT_WR
+#define SD_BOTH             SHUT_RDWR
+
+#define closesocket         close
+#define ZeroMemory(p, n)    memset((p), 0, (n))
+
+// there is no library to initialize on posix, keep the same call sites working
+typedef struct { int unused; } WSADATA;
+#define MAKEWORD(a, b)      0
+inline int WSAStartup(int, WSADATA*) { return 0; }
+inline int WSACleanup() { return 0; }
+inline int WSAGetLastError() { return errno; }
+
+// same name as on windows, so poll() can be used on both
+#define WSAPoll             poll
+
+#endif
+
+/**
+ * @brief recv() on the socket returns immediately instead of waiting for data, it fails with socketWouldBlock() then.
+ * @return              0 if it worked, SOCKET_ERROR if not.
+ */
+inline int setNonBlocking(SOCKET socket) {
+#ifdef _WIN32
+    u_long mode = 1;
+    return ioctlsocket(socket, FIONBIO, &mode);
+#else
+    int flags = fcntl(socket, F_GETFL, 0);
+    if (flags < 0) return SOCKET_ERROR;
+    return fcntl(socket, F_SETFL, flags | O_NONBLOCK);
+#endif
+}
+
+/**
+ * @brief Undoes setNonBlocking(), recv() waits for data again.
+ * @return              0 if it worked, SOCKET_ERROR if not.
+ */
+inline int setBlocking(SOCKET socket) {
+#ifdef _WIN32
+    u_long mode = 0;
+    return ioctlsocket(socket, FIONBIO, &mode);
+#else
+    int flags = fcntl(socket, F_GETFL, 0);
+    if (flags < 0) return SOCKET_ERROR;
+    return fcntl(socket, F_SETFL, flags & ~O_NONBLOCK);
+#endif
+}
+
+/**
+ * @brief The last connect() on a non-blocking socket didn't fail, it is still going on (wait until it is writable).
+ */
+inline bool socketConnectPending() {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EINPROGRESS;
+#endif
+}
+
+/**
+ * @brief recv() waits at most this long for data, then it fails (socketWouldBlock() on posix, WSAETIMEDOUT on windows).
+ * @param milliseconds  0 waits forever.
+ * @return              0 if it worked, SOCKET_ERROR if not.
+ */
+inline int setReceiveTimeout(SOCKET socket, int milliseconds) {
+#ifdef _WIN32
+    DWORD timeout = milliseconds;
+#else
+    struct timeval timeout = { milliseconds / 1000, (milliseconds % 1000) * 1000 };
+#endif
+    return setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+}
+
+/**
+ * @brief Asks for a kernel buffer of bytes for the received data, so a late reader finds the packets there
+ * instead of the sender being throttled (linux doubles the value and caps it at net.core.rmem_max).
+ * @return              The size the kernel really took, 0 if it failed.
+ */
+inline int setReceiveBufferSize(SOCKET socket, int bytes) {
+    if (setsockopt(socket, SOL_SOCKET, SO_RCVBUF, (const char*)&bytes, sizeof(bytes)) != 0) return 0;
+    int size = 0;
+    socklen_t length = sizeof(size);
+    if (getsockopt(socket, SOL_SOCKET, SO_RCVBUF, (char*)&size, &length) != 0) return 0;
+    return size;
+}
+
+/**
+ * @brief Sends small segments right away instead of collecting them (Nagle), TCP_NODELAY.
+ * @return              0 if it worked, SOCKET_ERROR if not.
+ */
+inline int setNoDelay(SOCKET socket) {
+    int flag = 1;
+    return setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, (const char*)&flag, sizeof(flag));
+}
+
+/**
+ * @brief Acknowledges the received segments right away instead of delaying the ack (TCP_QUICKACK, linux only).
+ * The kernel falls back to delayed acks by itself, so it has to be set again now and then.
+ * @return              True if the socket has it.
+ */
+inline bool setQuickAck(SOCKET socket) {
+#if defined(TCP_QUICKACK) && !defined(_WIN32)
+    int flag = 1;
+    return setsockopt(socket, IPPROTO_TCP, TCP_QUICKACK, &flag, sizeof(flag)) == 0;
+#else
+    (void)socket;
+    return false;
+#endif
+}
+
+/**
+ * @brief Lets a recv() without data poll the network card for a while before it gives up or sleeps (SO_BUSY_POLL, linux only,
+ * above net.core.busy_read only with CAP_NET_ADMIN). On loopback there is no card, it does nothing there.
+ * @return              True if the socket has it.
+ */
+inline bool setBusyPoll(SOCKET socket, int microseconds) {
+#if defined(SO_BUSY_POLL) && !defined(_WIN32)
+    return setsockopt(socket, SOL_SOCKET, SO_BUSY_POLL, &microseconds, sizeof(microseconds)) == 0;
+#else
+    (void)socket;
+    (void)microseconds;
+    return false;
+#endif
+}
+
+/**
+ * @brief The last call on a non-blocking socket failed only because there was no data.
+ */
+inline bool socketWouldBlock() {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+#include <stdint.h>
+
+/**
+ * @brief Asks the kernel to timestamp every packet when it arrives (SO_TIMESTAMPNS, linux only).
+ * @return              True if the socket delivers timestamps to recvTimestamped().
+ */
+inline bool enableReceiveTimestamps(SOCKET socket) {
+#if defined(SO_TIMESTAMPNS) && !defined(_WIN32)
+    int flag = 1;
+    return setsockopt(socket, SOL_SOCKET, SO_TIMESTAMPNS, &flag, sizeof(flag)) == 0;
+#else
+    (void)socket;
+    return false;
+#endif
+}
+
+/**
+ * @brief recv() which also gives the time the kernel received the data, if enableReceiveTimestamps() worked.
+ * On tcp the kernel gives the time of the last segment that was copied, so it is still a bit late for a big read.
+ *
+ * @param wall          Receives the time in nanoseconds since 1970 (wall clock), 0 if there is none.
+ * @return              Same as recv().
+ */
+inline int recvTimestamped(SOCKET socket, char* buffer, int size, int64_t* wall) {
+    *wall = 0;
+#if defined(SO_TIMESTAMPNS) && !defined(_WIN32)
+    struct iovec iov = { buffer, (size_t)size };
+    char control[CMSG_SPACE(sizeof(struct timespec))];
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    int result = (int)recvmsg(socket, &message, 0);
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&message); result > 0 && cmsg != NULL; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            struct timespec time;
+            memcpy(&time, CMSG_DATA(cmsg), sizeof(time));
+            *wall = (int64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+        }
+    }
+    return result;
+#else
+    return recv(socket, buffer, size, 0);
+#endif
+}
+
+#endif
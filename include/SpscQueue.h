@@ -0,0 +1,165 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+// basic libraries
+#include <stdint.h>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <utility>
+
+// what push() does when the queue is full
+#define QUEUE_BLOCK 0                       //!< wait until the consumer makes room (nothing is lost)
+#define QUEUE_DROP_OLDEST 1                 //!< throw away the oldest frame that is not read yet
+#define QUEUE_DROP_NEWEST 2                 //!< throw away the frame that is pushed
+
+/**
+ * @brief Bounded lock-free queue for one producer thread and one consumer thread.
+ * All slots are allocated in the constructor and reused, so if T reuses its memory on assignment
+ * (e.g. std::vector with enough capacity) pushing and popping doesn't allocate anything.
+ *
+ * The consumer swaps the element out of its slot, so it holds a slot only for the time of a swap.
+ * For QUEUE_DROP_OLDEST the producer also advances the read position, that's why the read position is
+ * claimed with compare-exchange, and why the slot that the consumer is swapping is published in reading_,
+ * the producer must never write into that slot even if it dropped everything behind it. A consumer which lost the
+ * compare-exchange takes its announcement back before it looks again, and a producer that finds the slot busy
+ * only waits for the swap, it has already made room, so with QUEUE_DROP_OLDEST only one element is dropped per push().
+ *
+ * @tparam T    Element type, needs to be default constructible, assignable and swappable.
+ */
+template <typename T>
+class SpscQueue
+{
+
+private:
+    static constexpr uint64_t NONE = UINT64_MAX;
+
+    std::vector<T> slots_;                  //!< capacity_ + 1 slots, one extra for the one the consumer is reading
+    uint64_t capacity_;                     //!< Maximum number of unread elements
+    int policy_;                            //!< QUEUE_BLOCK, QUEUE_DROP_OLDEST or QUEUE_DROP_NEWEST
+
+    alignas(64) std::atomic<uint64_t> head_{ 0 };       //!< Next position the producer writes (only the producer writes it)
+    alignas(64) std::atomic<uint64_t> tail_{ 0 };       //!< Next position to read
+    alignas(64) std::atomic<uint64_t> reading_{ NONE }; //!< Position the consumer is reading, NONE if nothing
+
+    alignas(64) std::atomic<long> countpush_{ 0 };      //!< Elements accepted by push()
+    std::atomic<long> countdrop_{ 0 };                  //!< Elements thrown away because the queue was full
+    std::atomic<uint64_t> maxdepth_{ 0 };               //!< Highest number of unread elements seen
+    std::atomic<bool> closed_{ false };                 //!< A blocked push() gives up when this is set
+
+public:
+
+    /**
+     * @brief Constructor of the queue.
+     *
+     * @param capacity      Maximum number of unread elements.
+     * @param policy        What to do when the queue is full, QUEUE_BLOCK, QUEUE_DROP_OLDEST or QUEUE_DROP_NEWEST.
+     */
+    SpscQueue(size_t capacity, int policy) {
+        capacity_ = (capacity > 0) ? capacity : 1;
+        policy_ = policy;
+        slots_.resize(capacity_ + 1);
+    }
+
+    /**
+     * @brief Producer only. Copies the element into the queue.
+     *
+     * @param item          The element.
+     * @return              True if the element is in the queue, false if it was dropped (full queue or closed).
+     */
+    template <typename U>
+    bool push(U&& item) {
+
+        uint64_t head = head_.load(std::memory_order_relaxed);
+
+        while (true) {
+            uint64_t tail = tail_.load();
+            uint64_t reading = reading_.load();
+
+            // room for one more unread element, and the slot we write is not the one the consumer reads
+            bool fullqueue = (head - tail >= capacity_);
+            bool slotbusy = (reading != NONE && head - reading > capacity_);
+            if (!fullqueue && !slotbusy) break;
+
+            if (policy_ == QUEUE_DROP_OLDEST && fullqueue) {
+                // take the oldest one away from the consumer, if the consumer was faster then just look again
+                if (tail_.compare_exchange_weak(tail, tail + 1)) countdrop_++;
+                continue;
+            }
+
+            // the consumer is in the middle of a swap (or about to take back a claim that failed), the oldest one is
+            // already dropped, dropping this one too would lose two, it is free in a moment
+            if (policy_ == QUEUE_DROP_OLDEST) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            if (policy_ == QUEUE_BLOCK && !closed_.load(std::memory_order_relaxed)) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            // QUEUE_DROP_NEWEST, or QUEUE_BLOCK after close()
+            countdrop_++;
+            return false;
+        }
+
+        slots_[head % (capacity_ + 1)] = std::forward<U>(item);
+        head_.store(head + 1, std::memory_order_release);
+        countpush_++;
+
+        uint64_t depth = head + 1 - tail_.load(std::memory_order_relaxed);
+        if (depth > maxdepth_.load(std::memory_order_relaxed)) maxdepth_.store(depth, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * @brief Consumer only. Takes the oldest element by swapping it with item, so item has to be
+     * an element that can be given to the queue in exchange (for std::vector with the same capacity
+     * nothing is allocated and nothing is copied).
+     *
+     * @param item          Receives the element, its old content goes into the queue.
+     * @return              True if there was an element, false if the queue is empty.
+     */
+    bool pop(T& item) {
+        uint64_t tail = tail_.load();
+        while (true) {
+            if (tail == head_.load(std::memory_order_acquire)) {
+                reading_.store(NONE);
+                return false;
+            }
+
+            // announce the slot before taking it, so the producer doesn't overwrite it after a drop
+            reading_.store(tail);
+            if (tail_.compare_exchange_weak(tail, tail + 1)) {
+                using std::swap;
+                swap(item, slots_[tail % (capacity_ + 1)]);
+                reading_.store(NONE, std::memory_order_release);
+                return true;
+            }
+
+            // the producer dropped it first, the announcement is stale until the next one
+            reading_.store(NONE);
+        }
+    }
+
+    /**
+     * @brief Wake up a producer that waits in push() with QUEUE_BLOCK, it drops from now on.
+     */
+    void close() {
+        closed_ = true;
+    }
+
+    size_t size() {
+        uint64_t head = head_.load(std::memory_order_acquire);
+        uint64_t tail = tail_.load(std::memory_order_acquire);
+        return (head > tail) ? (size_t)(head - tail) : 0;
+    }
+
+    size_t capacity() { return (size_t)capacity_; }                         //!< Maximum number of unread elements
+    long getPushCount() { return countpush_.load(); }                       //!< Elements accepted by push()
+    long getDropCount() { return countdrop_.load(); }                       //!< Elements thrown away
+    size_t getMaxDepth() { return (size_t)maxdepth_.load(); }               //!< Highest number of unread elements seen
+};
+
+#endif
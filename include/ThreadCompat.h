@@ -0,0 +1,52 @@
+#ifndef THREADCOMPAT_H
+#define THREADCOMPAT_H
+
+// Where and how urgently a thread runs, for the low latency profile of the connection. std::thread has nothing
+// for it, this maps the two things we need onto pthreads on linux and onto the thread API on windows.
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/**
+ * @brief Keeps the calling thread on one core, so the scheduler doesn't move it (and its cache) around.
+ * @param core          Number of the core, counted from 0.
+ * @return              0 if it worked, -1 if not (e.g. there is no such core).
+ */
+inline int pinThread(int core) {
+    if (core < 0 || core >= 64) return -1;
+#ifdef _WIN32
+    return (SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << core) != 0) ? 0 : -1;
+#elif defined(__linux__)
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(core, &cpus);
+    return (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0) ? 0 : -1;
+#else
+    return -1;
+#endif
+}
+
+/**
+ * @brief Runs the calling thread with a real time priority (SCHED_FIFO), nothing of normal priority takes the core from it.
+ * On linux this needs root or CAP_SYS_NICE, on windows it is THREAD_PRIORITY_TIME_CRITICAL whatever priority is.
+ * A thread like this must never spin without end, it would freeze its core.
+ *
+ * @param priority      1 (lowest) to 99.
+ * @return              0 if it worked, -1 if not (e.g. not allowed).
+ */
+inline int setRealtimePriority(int priority) {
+#ifdef _WIN32
+    (void)priority;
+    return SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) ? 0 : -1;
+#else
+    struct sched_param parameter;
+    parameter.sched_priority = priority;
+    return (pthread_setschedparam(pthread_self(), SCHED_FIFO, &parameter) == 0) ? 0 : -1;
+#endif
+}
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef TIFFWRITER_H
+#define TIFFWRITER_H
+
+// basic libraries
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+
+#include <opencv2/opencv.hpp>
+
+#include "FramePool.h"
+#include "FrameClock.h"
+#include "WorkerPool.h"
+
+/**
+ * @brief TiffWriter encodes and writes a batch of DATA_RAW frames as <timestamp>_<index>.tiff (or <timestamp>.tiff)
+ * on several threads, the same files RECORD_TIFF always wrote, one per frame.
+ * cv::imwrite() is most of the time of a frame (the encoding and a file of its own), but the frames are independent,
+ * so they are shared between the threads of a WorkerPool.
+ * The name of the file comes from the frame, so it doesn't matter in which order the files are written,
+ * and the batch is finished before the next one starts, the slots of the frames go back to the pool in order.
+ */
+class TiffWriter
+{
+
+private:
+    int samples_;                           //!< Values per probe
+    int probes_;                            //!< Number of probes
+    std::string directory_;                 //!< Where the .tiff files go
+    bool usedataindex_ = false;             //!< The index is in the name of the file
+    FrameClock clock_;                      //!< The anchor of the recorder, for the timestamp in the name
+
+    // the batch being written
+    const std::vector<FrameRef>* batch_ = nullptr; //!< Frames of the batch
+
+    // the workers, the image header and the name are reused for every frame
+    struct Worker
+    {
+        cv::Mat image;                      //!< Header over the values of the frame, nothing is copied
+        std::string filepath;               //!< Path of the file of the frame
+    };
+    std::vector<Worker> workers_;           //!< One per thread of pool_
+    WorkerPool pool_;                       //!< The threads writing the frames of a batch, stopped before the workers go
+
+    // for statistics
+    std::atomic<long> countfailed_{ 0 };    //!< Frames cv::imwrite() couldn't write
+
+public:
+
+    /**
+     * @brief Constructor of the writer, starts the helper threads.
+     *
+     * @param samples       Values per probe.
+     * @param probes        Number of probes.
+     * @param threads       Threads writing at the same time, including the calling thread.
+     */
+    TiffWriter(int samples, int probes, int threads);
+
+    /**
+     * @brief Where the files go and how they are named, call before the first write().
+     *
+     * @param directory     Directory of the files, it has to exist.
+     * @param usedataindex  Name the files <timestamp>_<index>.tiff instead of <timestamp>.tiff.
+     * @param clock         Converts the timestamps of the frames to the wall clock of the name.
+     */
+    void setPath(std::string directory, bool usedataindex, const FrameClock& clock);
+
+    /**
+     * @brief Writes the first count frames of batch, returns when all files are written.
+     *
+     * @param batch         The frames.
+     * @param count         How many frames of batch are used.
+     */
+    void write(const std::vector<FrameRef>& batch, size_t count);
+
+    long getFailCount();                    //!< Frames which couldn't be written
+    int getThreadCount();                   //!< Threads writing, including the calling thread
+
+protected:
+
+    /**
+     * @brief Writes frame i of the batch.
+     *
+     * @param i             Position in the batch.
+     * @param worker        The header and the name of the thread.
+     */
+    void writeFrame(size_t i, Worker& worker);
+};
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+// basic libraries
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+/**
+ * @brief WorkerPool runs count independent items (the frames of a batch, the probes of a frame, ...) on a few threads
+ * and returns when all of them are done. The threads are started once in the constructor and sleep between the runs.
+ * Every thread takes the next item until there is none left, the calling thread takes items too, so a pool of
+ * one thread has no helper and costs nothing. The function gets the number of the thread, for what every thread
+ * needs of its own (a codec, an envelope line, ...), the calling thread is the last one.
+ * Only one thread calls run().
+ */
+class WorkerPool
+{
+
+private:
+    std::vector<std::thread> threads_;      //!< Helper threads, one less than getThreadCount()
+    std::mutex mutex_;                      //!< Protects the run, generation_, active_ and stop_
+    std::condition_variable wake_;          //!< Wakes the helpers for a new run
+    std::condition_variable done_;          //!< Wakes the calling thread when the helpers left the run
+    uint64_t generation_ = 0;               //!< Incremented for every run
+    int active_ = 0;                        //!< Helpers taking items of the run
+    bool stop_ = false;                     //!< The helpers finish
+
+    // the run
+    const std::function<void(size_t, int)>* function_ = nullptr; //!< What to do with an item
+    size_t count_ = 0;                      //!< Items of the run
+    std::atomic<size_t> next_{ 0 };         //!< Next item to take
+
+public:
+
+    /**
+     * @brief Constructor of the pool, starts the helper threads.
+     * @param threads       Threads working at the same time, including the calling thread.
+     */
+    WorkerPool(int threads);
+
+    ~WorkerPool();
+
+    /**
+     * @brief Calls function(item, thread) for every item from 0 to count - 1, returns when all of them are done.
+     *
+     * @param count         Number of items.
+     * @param function      Called once per item, on any thread of the pool, thread is from 0 to getThreadCount() - 1.
+     */
+    void run(size_t count, const std::function<void(size_t, int)>& function);
+
+    int getThreadCount();                   //!< Threads including the calling thread
+
+protected:
+
+    /**
+     * @brief The helper threads, wait for a run and take items of it.
+     * @param thread        Number of the thread, given to the function.
+     */
+    void workLoop(int thread);
+
+    /**
+     * @brief Takes items of the run until there is none left.
+     * @param thread        Number of the thread, given to the function.
+     */
+    void takeItems(int thread);
+};
+
+#endif
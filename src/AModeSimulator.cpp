@@ -0,0 +1,268 @@
+#include "AModeSimulator.h"
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include <thread>
+
+AModeSimulator::AModeSimulator(std::string port, int mode) {
+    port_ = port;
+    ListenSocket_ = INVALID_SOCKET;
+    ClientSocket_ = INVALID_SOCKET;
+
+    switch (mode) {
+    case DATA_DEPTH:
+        probes_ = 30;
+        samples_ = 2;
+        datamode_ = DATA_DEPTH;
+        indexsize_ = 8;
+        break;
+
+    case DATA_RAW:
+    default:
+        probes_ = 30;
+        samples_ = 1500;
+        datamode_ = DATA_RAW;
+        indexsize_ = 2;
+        break;
+    }
+    datalength_ = samples_ * probes_;
+
+    generatePackets();
+}
+
+
+AModeSimulator::AModeSimulator(std::string port, int samples, int probes, int mode) {
+    port_ = port;
+    ListenSocket_ = INVALID_SOCKET;
+    ClientSocket_ = INVALID_SOCKET;
+
+    samples_ = samples;
+    probes_ = probes;
+    datamode_ = mode;
+    indexsize_ = (mode == DATA_DEPTH) ? 8 : 2;
+    datalength_ = samples_ * probes_;
+
+    generatePackets();
+}
+
+
+AModeSimulator::~AModeSimulator() {
+    if (ListenSocket_ != INVALID_SOCKET) {
+        closesocket(ListenSocket_);
+        WSACleanup();
+    }
+}
+
+
+void AModeSimulator::setFrameRate(double framerate) {
+    framerate_ = framerate;
+}
+
+
+void AModeSimulator::setFrameCount(long framecount) {
+    framecount_ = framecount;
+}
+
+
+void AModeSimulator::setIndexSkip(long skipevery) {
+    skipevery_ = skipevery;
+}
+
+
+long AModeSimulator::getFrameSent() {
+    return countsent_;
+}
+
+
+int AModeSimulator::getPacketSize() {
+    return (int)packets_.front().size();
+}
+
+
+void AModeSimulator::generatePackets() {
+
+    int valuesize = (datamode_ == DATA_RAW) ? sizeof(uint16_t) : sizeof(double);
+    uint32_t bodysize = indexsize_ + valuesize * datalength_;
+
+    // fixed seed, every run sends the same signals
+    std::mt19937 rng(6340);
+    std::normal_distribution<double> noise(0.0, 12.0);
+
+    packets_.resize(packetvariation_);
+    for (int f = 0; f < packetvariation_; f++) {
+
+        std::vector<char>& packet = packets_[f];
+        packet.assign(headersize_ + bodysize, 0);
+        memcpy(packet.data(), &bodysize, sizeof(uint32_t));
+        char* data = packet.data() + headersize_ + indexsize_;
+
+        // every probe sees one echo (the bone), which moves slowly like a muscle contracting
+        double phase = 2.0 * M_PI * f / packetvariation_;
+
+        for (int p = 0; p < probes_; p++) {
+            double depth = 0.35 + 0.1 * p / probes_ + 0.05 * sin(phase + p);
+
+            if (datamode_ == DATA_RAW) {
+                // 12 bit adc around the middle, the echo is a gaussian windowed burst
+                uint16_t* line = (uint16_t*)data + (size_t)p * samples_;
+                double center = depth * samples_;
+                double width = samples_ / 150.0 + 1.0;
+                for (int s = 0; s < samples_; s++) {
+                    double d = (s - center) / width;
+                    double echo = 1500.0 * exp(-d * d) * sin(2.0 * M_PI * 0.12 * s);
+                    double value = 2048.0 + echo + noise(rng);
+                    line[s] = (uint16_t)(value < 0.0 ? 0.0 : (value > 4095.0 ? 4095.0 : value));
+                }
+            }
+            else {
+                // the machine sends the depth already, fill everything the probe has with it
+                double* line = (double*)data + (size_t)p * samples_;
+                for (int s = 0; s < samples_; s++) line[s] = depth * 50.0 + s;
+            }
+        }
+    }
+}
+
+
+int AModeSimulator::listenTCP() {
+    int iResult;
+
+    WSADATA wsaData;
+    iResult = WSAStartup(MAKEWORD(2, 2), &wsaData);
+    if (iResult != 0) {
+        printf("WSAStartup failed: %d\n", iResult);
+        return -1;
+    }
+
+    struct addrinfo* result, hints;
+
+    ZeroMemory(&hints, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+    hints.ai_flags = AI_PASSIVE;
+
+    iResult = getaddrinfo(NULL, port_.c_str(), &hints, &result);
+    if (iResult != 0) {
+        printf("getaddrinfo failed: %d\n", iResult);
+        WSACleanup();
+        return -1;
+    }
+
+    ListenSocket_ = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+    if (ListenSocket_ == INVALID_SOCKET) {
+        printf("Error at socket(): %ld\n", (long)WSAGetLastError());
+        freeaddrinfo(result);
+        WSACleanup();
+        return -1;
+    }
+
+    // we restart the simulator a lot while testing, don't wait for TIME_WAIT
+    int reuse = 1;
+    setsockopt(ListenSocket_, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+    iResult = bind(ListenSocket_, result->ai_addr, (int)result->ai_addrlen);
+    freeaddrinfo(result);
+    if (iResult == SOCKET_ERROR) {
+        printf("bind failed: %ld\n", (long)WSAGetLastError());
+        closesocket(ListenSocket_);
+        ListenSocket_ = INVALID_SOCKET;
+        WSACleanup();
+        return -1;
+    }
+
+    if (listen(ListenSocket_, 1) == SOCKET_ERROR) {
+        printf("listen failed: %ld\n", (long)WSAGetLastError());
+        closesocket(ListenSocket_);
+        ListenSocket_ = INVALID_SOCKET;
+        WSACleanup();
+        return -1;
+    }
+
+    printf("A-Mode simulator listening on port %s\n", port_.c_str());
+    return 0;
+}
+
+
+void AModeSimulator::closeTCP() {
+    if (ListenSocket_ == INVALID_SOCKET) return;
+    closesocket(ListenSocket_);
+    ListenSocket_ = INVALID_SOCKET;
+    WSACleanup();
+    printf("A-Mode simulator closed port %s\n", port_.c_str());
+}
+
+
+void AModeSimulator::advanceIndex(long frames) {
+    dataindex_ += frames;
+}
+
+
+int AModeSimulator::sendAll(const char* buffer, int buffersize) {
+    int sent = 0;
+    while (sent < buffersize) {
+        int iResult = send(ClientSocket_, buffer + sent, buffersize - sent, MSG_NOSIGNAL);
+        if (iResult == SOCKET_ERROR) return SOCKET_ERROR;
+        sent += iResult;
+    }
+    return sent;
+}
+
+
+void AModeSimulator::stop() {
+    stop_ = true;
+}
+
+
+void AModeSimulator::operator()() {
+
+    if (ListenSocket_ == INVALID_SOCKET) {
+        printf("A-Mode simulator is not listening, call listenTCP() first\n");
+        return;
+    }
+
+    ClientSocket_ = accept(ListenSocket_, NULL, NULL);
+    if (ClientSocket_ == INVALID_SOCKET) {
+        printf("accept failed: %ld\n", (long)WSAGetLastError());
+        return;
+    }
+    printf("A-Mode simulator client connected\n");
+
+    countsent_ = 0;
+
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now();
+    std::chrono::nanoseconds period(0);
+    if (framerate_ > 0.0) period = std::chrono::nanoseconds((long long)(1e9 / framerate_));
+
+    while (!stop_ && (framecount_ == 0 || countsent_ < framecount_)) {
+
+        // the index is the only thing that changes between two equal packets
+        std::vector<char>& packet = packets_[dataindex_ % packetvariation_];
+        memcpy(packet.data() + headersize_, &dataindex_, indexsize_);
+
+        if (sendAll(packet.data(), (int)packet.size()) == SOCKET_ERROR) {
+            printf("A-Mode simulator send failed: %ld\n", (long)WSAGetLastError());
+            break;
+        }
+        dataindex_++;
+        countsent_++;
+
+        // the frame with this index is "lost"
+        if (skipevery_ > 0 && countsent_ % skipevery_ == 0) dataindex_++;
+
+        if (period.count() > 0) {
+            deadline += period;
+            std::this_thread::sleep_until(deadline);
+        }
+    }
+
+    printf("A-Mode simulator sent %ld frames\n", (long)countsent_);
+
+    // same as the machine, the client sees the end of the stream as recv() returning 0
+    shutdown(ClientSocket_, SD_SEND);
+    closesocket(ClientSocket_);
+    ClientSocket_ = INVALID_SOCKET;
+}
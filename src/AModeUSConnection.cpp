@@ -12,6 +12,7 @@ AModeUSConnection::AModeUSConnection(std::string ip, std::string port, int mode)
         samples_ = 1500;
         datamode_ = DATA_RAW;
         indexsize_ = 2;
+        recordformat_ = RECORD_BINARY;
         break;
 
         // this mode will encode the received data as depth data
@@ -20,9 +21,12 @@ AModeUSConnection::AModeUSConnection(std::string ip, std::string port, int mode)
         samples_ = 2;
         datamode_ = DATA_DEPTH;
         indexsize_ = 8;
+        recordformat_ = RECORD_COLUMNS;
         break;
     }
     datalength_ = samples_ * probes_;
+    roisamples_ = samples_;
+    roiprobes_ = probes_;
 
     connectTCP(&ConnectSocket_);
 
@@ -34,15 +38,21 @@ AModeUSConnection::AModeUSConnection(std::string ip, std::string port, int sampl
     port_ = port;
     ConnectSocket_ = INVALID_SOCKET;
 
+    // custom geometry is only possible with raw data
     samples_ = samples;
     probes_ = probes;
+    datamode_ = DATA_RAW;
+    indexsize_ = 2;
+    recordformat_ = RECORD_BINARY;
     datalength_ = samples_ * probes_;
+    roisamples_ = samples_;
+    roiprobes_ = probes_;
 
     connectTCP(&ConnectSocket_);
 }
 
 
-int AModeUSConnection::connectTCP(SOCKET* ConnectSocket) {
+int AModeUSConnection::connectTCP(SOCKET* ConnectSocket, bool quiet) {
     // variable to store the status flag
     int iResult;
 
@@ -75,7 +85,7 @@ int AModeUSConnection::connectTCP(SOCKET* ConnectSocket) {
     *ConnectSocket = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
 
     if (*ConnectSocket == INVALID_SOCKET) {
-        printf("Error at socket(): %ld\n", WSAGetLastError());
+        printf("Error at socket(): %ld\n", (long)WSAGetLastError());
         freeaddrinfo(result);
         WSACleanup();
         // synch::setStop(true);
@@ -83,8 +93,24 @@ int AModeUSConnection::connectTCP(SOCKET* ConnectSocket) {
     }
 
     // STEP 3: CONNECT TO THE SOCKET
+    // without blocking, when the machine is off a blocking connect() waits for the timeout of the OS (minutes)
+    setNonBlocking(*ConnectSocket);
     iResult = connect(*ConnectSocket, result->ai_addr, (int)result->ai_addrlen);
-    if (iResult == SOCKET_ERROR) {
+    if (iResult == SOCKET_ERROR && socketConnectPending()) {
+        struct pollfd fd;
+        fd.fd = *ConnectSocket;
+        fd.events = POLLOUT;
+        fd.revents = 0;
+
+        // writable means connected or refused, SO_ERROR tells which
+        int error = 0;
+        socklen_t errorsize = sizeof(error);
+        if (WSAPoll(&fd, 1, (int)(connecttimeout_ * 1000.0)) == 1
+            && getsockopt(*ConnectSocket, SOL_SOCKET, SO_ERROR, (char*)&error, &errorsize) == 0 && error == 0) {
+            iResult = 0;
+        }
+    }
+    if (iResult == SOCKET_ERROR || setBlocking(*ConnectSocket) != 0) {
         closesocket(*ConnectSocket);
         *ConnectSocket = INVALID_SOCKET;
     }
@@ -92,18 +118,154 @@ int AModeUSConnection::connectTCP(SOCKET* ConnectSocket) {
     freeaddrinfo(result);
 
     if (*ConnectSocket == INVALID_SOCKET) {
-        printf("Unable to connect to server!\n");
+        if (!quiet) printf("Unable to connect to server!\n");
         WSACleanup();
         // synch::setStop(true);
         return -1;
     }
 
+    // the time the packet reached the machine is better than the time we came around to read it
+    kerneltimestamps_ = enableReceiveTimestamps(*ConnectSocket);
+
     printf("Connection to A-Mode Ultrasound Machine success\n");
     return 0;
 }
 
 
 
+int AModeUSConnection::reconnect() {
+
+    // the time to the first frame starts when the connection was lost, not when we start connecting
+    if (lostat_ == 0) lostat_ = FrameClock::now();
+    closeTCP();
+
+    // whatever was received of the packet is lost, the next packet starts on a new stream
+    if (decoder_) decoder_->reset();
+#ifdef AMODE_ENABLE_STATS
+    statsarrival_ = 0;
+#endif
+
+    double backoff = backoffmin_;
+    bool quiet = false;
+    while ((FrameClock::now() - lostat_) * 1e-9 < reconnecttimeout_) {
+        // connected on the side, stop() must never see a socket which is half set up
+        SOCKET connected = INVALID_SOCKET;
+        if (connectTCP(&connected, quiet) == 0) {
+            {
+                std::lock_guard<std::mutex> lock(socketmutex_);
+                ConnectSocket_ = connected;
+            }
+            tuneSocket();
+            printf("A-Mode reconnected after %.3f s\n", (FrameClock::now() - lostat_) * 1e-9);
+            return 0;
+        }
+
+        // the user can still quit while the machine is gone
+        if (userquit_ || synch::getStop()) {
+            userquit_ = true;
+            break;
+        }
+        quiet = true;
+        std::this_thread::sleep_for(std::chrono::duration<double>(backoff));
+        backoff = std::min(2.0 * backoff, backoffmax_);
+    }
+
+    printf("A-Mode gave up reconnecting after %.1f s\n", reconnecttimeout_);
+    return -1;
+}
+
+
+void AModeUSConnection::tuneSocket() {
+
+    if (ConnectSocket_ == INVALID_SOCKET) return;
+
+    // a blocking recv() comes back after stalltimeout_ without data, busy polling checks the time itself
+    if (stalltimeout_ > 0.0 && !busypoll_) setReceiveTimeout(ConnectSocket_, (int)(stalltimeout_ * 1000.0));
+    if (!lowlatency_) return;
+
+    int valuesize = (datamode_ == DATA_RAW) ? sizeof(uint16_t) : sizeof(double);
+    int buffersize = 0;
+    if (bufferframes_ > 0) buffersize = setReceiveBufferSize(ConnectSocket_, bufferframes_ * (headersize_ + indexsize_ + valuesize * datalength_));
+    setNoDelay(ConnectSocket_);
+    setQuickAck(ConnectSocket_);
+    if (busypoll_) {
+        setNonBlocking(ConnectSocket_);
+        setBusyPoll(ConnectSocket_, 50);
+    }
+    printf("A-Mode low latency: receive buffer %d KB, %s\n", buffersize / 1024, busypoll_ ? "busy polling" : "blocking recv()");
+}
+
+
+std::string AModeUSConnection::getProfileName() {
+
+    std::string name = busypoll_ ? "busypoll" : (lowlatency_ ? "lowlatency" : "default");
+    if (receivecore_ >= 0) name += ",pinned";
+    if (threadpriority_ > 0) name += ",fifo";
+    return name;
+}
+
+
+void AModeUSConnection::closeTCP() {
+
+    std::lock_guard<std::mutex> lock(socketmutex_);
+    if (ConnectSocket_ == INVALID_SOCKET) return;
+
+    // disconnect the socket, we want everything is clean after this program is stopped
+    // https://docs.microsoft.com/en-us/windows/win32/winsock/disconnecting-the-client
+    if (shutdown(ConnectSocket_, SD_SEND) == SOCKET_ERROR) {
+        printf("shutdown failed: %d\n", WSAGetLastError());
+    }
+    closesocket(ConnectSocket_);
+    ConnectSocket_ = INVALID_SOCKET;
+    WSACleanup();
+}
+
+
+
+int AModeUSConnection::getFrameCount() {
+    return countdata_;
+}
+
+
+IndexTracker* AModeUSConnection::getIndexTracker() {
+    return tracker_.get();
+}
+
+
+SOCKET AModeUSConnection::getSocket() {
+    return ConnectSocket_;
+}
+
+
+long AModeUSConnection::getResyncCount() {
+    if (!decoder_) return 0;
+    return decoder_->getResyncCount();
+}
+
+
+long AModeUSConnection::getReconnectCount() {
+    return countreconnect_;
+}
+
+
+double AModeUSConnection::getReconnectTime(bool worst) {
+    return worst ? maxfirstframe_ : lastfirstframe_;
+}
+
+
+
+void AModeUSConnection::stop() {
+
+    userquit_ = true;
+
+    // a recv() which waits for the machine comes back with 0 right away, whatever the frame rate is.
+    // the socket is only closed by the receiving thread, this only wakes it up
+    std::lock_guard<std::mutex> lock(socketmutex_);
+    if (ConnectSocket_ != INVALID_SOCKET) shutdown(ConnectSocket_, SD_BOTH);
+}
+
+
+
 bool AModeUSConnection::isConnected() {
     if (ConnectSocket_ != INVALID_SOCKET) return true;
     else return false;
@@ -111,6 +273,103 @@ bool AModeUSConnection::isConnected() {
 
 
 
+void AModeUSConnection::setConnectTimeout(double connect, double stall) {
+
+    connecttimeout_ = connect;
+    stalltimeout_ = stall;
+}
+
+
+
+void AModeUSConnection::setReconnect(double timeout, double backoffmin, double backoffmax) {
+
+    reconnecttimeout_ = timeout;
+    backoffmin_ = backoffmin;
+    backoffmax_ = (backoffmax > backoffmin) ? backoffmax : backoffmin;
+}
+
+
+
+void AModeUSConnection::setLowLatency(bool busypoll, int bufferframes) {
+
+    lowlatency_ = true;
+    busypoll_ = busypoll;
+    bufferframes_ = bufferframes;
+}
+
+
+
+void AModeUSConnection::setThreads(int receivecore, int writercore, int priority) {
+
+    receivecore_ = receivecore;
+    writercore_ = writercore;
+    threadpriority_ = priority;
+}
+
+
+
+void AModeUSConnection::setHeaderSync(bool flag) {
+
+    headersync_ = flag;
+}
+
+
+
+int AModeUSConnection::setRegionOfInterest(std::vector<int> probes, std::vector<int> first, int length, int decimation) {
+
+    if (datamode_ != DATA_RAW) {
+        printf("A-Mode region of interest: only for DATA_RAW\n");
+        return -1;
+    }
+    if (envelope_ || depth_) {
+        printf("A-Mode region of interest: set it before subscribeEnvelope() and subscribeDepth()\n");
+        return -1;
+    }
+
+    std::unique_ptr<FrameReducer> reducer(new FrameReducer(samples_, probes_));
+    if (reducer->setProbes(probes) != 0 || reducer->setWindow(first, length) != 0 || reducer->setDecimation(decimation) != 0) {
+        printf("A-Mode region of interest: does not fit in %d probes x %d samples\n", probes_, samples_);
+        return -1;
+    }
+
+    roisamples_ = reducer->getSamples();
+    roiprobes_ = reducer->getProbes();
+    printf("A-Mode region of interest: %d probes x %d samples of %d x %d, %.1f%% of every frame\n",
+        roiprobes_, roisamples_, probes_, samples_, 100.0 * roiprobes_ * roisamples_ / datalength_);
+
+    // a region which is the whole frame would only copy it
+    if (reducer->isIdentity()) reducer.reset();
+    reducer_ = std::move(reducer);
+    return 0;
+}
+
+
+
+void AModeUSConnection::setPreTrigger(double seconds, double framerate, bool external) {
+
+    pretrigger_ = (seconds > 0.0) ? seconds : 0.0;
+    pretriggerrate_ = (framerate > 0.0) ? framerate : 1000.0;
+    externaltrigger_ = external;
+}
+
+
+
+void AModeUSConnection::trigger() {
+
+    // the time of the first trigger, the receiving thread takes the window before it
+    int64_t none = 0;
+    triggerrequest_.compare_exchange_strong(none, FrameClock::now());
+}
+
+
+
+bool AModeUSConnection::isTriggered() {
+
+    return triggerrequest_.load() != 0;
+}
+
+
+
 void AModeUSConnection::setRecord(bool flag) {
 
     setrecord_ = flag;
@@ -124,6 +383,135 @@ void AModeUSConnection::useDataIndex(bool flag) {
 }
 
 
+
+void AModeUSConnection::setRecordFormat(int format) {
+
+    recordformat_ = format;
+}
+
+
+
+void AModeUSConnection::setRecordCompression(int threads) {
+
+    compressthreads_ = threads;
+}
+
+
+
+void AModeUSConnection::setRecordTiffThreads(int threads) {
+
+    tiffthreads_ = threads;
+}
+
+
+
+void AModeUSConnection::setRecordBackend(int backend, bool direct) {
+
+    recordbackend_ = backend;
+    recorddirect_ = direct;
+}
+
+
+
+FrameSubscriber* AModeUSConnection::subscribe(size_t capacity, int policy) {
+
+    subscribers_.emplace_back(new FrameSubscriber(capacity, policy));
+    return subscribers_.back().get();
+}
+
+
+
+FrameSubscriber* AModeUSConnection::subscribe(FrameCallback callback, size_t capacity, int policy) {
+
+    subscribers_.emplace_back(new FrameSubscriber(callback, capacity, policy));
+    return subscribers_.back().get();
+}
+
+
+
+FrameSubscriber* AModeUSConnection::subscribeEnvelope(size_t capacity, int policy) {
+
+    FrameStage* stage = rawStage(envelope_, "envelope", (int)sizeof(uint16_t) * roisamples_ * roiprobes_);
+    return (stage != nullptr) ? stage->subscribe(capacity, policy) : nullptr;
+}
+
+
+
+FrameSubscriber* AModeUSConnection::subscribeEnvelope(FrameCallback callback, size_t capacity, int policy) {
+
+    FrameStage* stage = rawStage(envelope_, "envelope", (int)sizeof(uint16_t) * roisamples_ * roiprobes_);
+    return (stage != nullptr) ? stage->subscribe(callback, capacity, policy) : nullptr;
+}
+
+
+
+void AModeUSConnection::setEnvelopeFilter(double center, double bandwidth, double range) {
+
+    envelopecenter_ = center;
+    envelopebandwidth_ = bandwidth;
+    enveloperange_ = range;
+}
+
+
+
+FrameSubscriber* AModeUSConnection::subscribeDepth(size_t capacity, int policy) {
+
+    FrameStage* stage = rawStage(depth_, "depth", (int)sizeof(double) * DEPTH_VALUES * roiprobes_);
+    return (stage != nullptr) ? stage->subscribe(capacity, policy) : nullptr;
+}
+
+
+
+FrameSubscriber* AModeUSConnection::subscribeDepth(FrameCallback callback, size_t capacity, int policy) {
+
+    FrameStage* stage = rawStage(depth_, "depth", (int)sizeof(double) * DEPTH_VALUES * roiprobes_);
+    return (stage != nullptr) ? stage->subscribe(callback, capacity, policy) : nullptr;
+}
+
+
+
+void AModeUSConnection::setDepthEstimation(int first, int last, double threshold, double spacing, double offset) {
+
+    depthfirst_ = first;
+    depthlast_ = last;
+    depththreshold_ = threshold;
+    depthspacing_ = spacing;
+    depthoffset_ = offset;
+}
+
+
+
+void AModeUSConnection::setDepthThreads(int threads, double budget) {
+
+    depththreads_ = threads;
+    depthbudget_ = budget;
+}
+
+
+
+void AModeUSConnection::setSharedRing(std::string name, int slots) {
+
+    sharedname_ = name;
+    sharedslots_ = slots;
+}
+
+
+
+void AModeUSConnection::setStatsOutput(std::string path, double interval) {
+
+    statspath_ = path;
+    statsinterval_ = interval;
+}
+
+
+
+void AModeUSConnection::setRecordQueue(int capacity, int policy) {
+
+    queuecapacity_ = capacity;
+    queuepolicy_ = policy;
+}
+
+
 int AModeUSConnection::setDirectory(std::string directory) {
     // check if the directory is exists
     if (!boost::filesystem::exists(directory)) {
@@ -133,18 +521,9 @@ int AModeUSConnection::setDirectory(std::string directory) {
         }
     }
 
-    // if user specified DATA_DEPTH, we will save it in csv file, so we need to open the stream first
-    // contrast to raw data, it will be saved in .tiff file using opencv imwrite function while streaming (at least for now)
-    if (datamode_ == DATA_DEPTH) {
-
-        // prepare the file name
-        std::string filename = std::to_string(rtb::getTime());
-        if (directory.back() == '\\') fullpath_ = directory + filename + ".csv";
-        else fullpath_ = directory + "\\" + filename + ".csv";
-
-        // open the file stream
-        ofs_.open(fullpath_);
-    }
+    // the name of the .csv file or the .amode segments, the recorder opens them when the streaming starts
+    // (with RECORD_TIFF every frame gets its own name while streaming)
+    recordname_ = std::to_string(rtb::getTime());
 
     recorddirectory_ = directory;
     return 0;
@@ -161,12 +540,10 @@ int AModeUSConnection::setDirectory(std::string directory, std::string filename)
         }
     }
 
-    // if everything goes fine open the csv file
-    if (directory.back() == '\\') fullpath_ = directory + filename + ".csv";
-    else fullpath_ = directory + "\\" + filename + ".csv";
-
-    ofs_.open(fullpath_);
+    // if everything goes fine, the recorder opens the file when the streaming starts
+    recordname_ = filename;
 
+    recorddirectory_ = directory;
     return 0;
 }
 
@@ -186,7 +563,8 @@ int AModeUSConnection::receiveData() {
     ultrasound_frd.resize((datasize - headersize_) / sizeof(uint16_t));
 
     // temporary buffer that we will use for store binary string from socket
-    char* receivebuffer = new char[datasize];
+    std::vector<char> buffer(datasize);
+    char* receivebuffer = buffer.data();
 
     countdata_ = 0;
     double timestamp = rtb::getTime();
@@ -259,76 +637,104 @@ int AModeUSConnection::receiveData() {
 }
 
 
-// A function to receive the data for DATA_RAW mode.
-int AModeUSConnection::receiveData(std::vector<uint16_t>* ultrasound_frd, char* receivebuffer, int receivebuffersize, int datasize, int headerindexsize) {
-    
-    // read data from socket, put it in temporary variable
-    int iResult = recv(ConnectSocket_, receivebuffer, receivebuffersize, 0);
+// A function to receive the data, for DATA_RAW and DATA_DEPTH mode.
+int AModeUSConnection::receiveData(FrameRef* frame) {
+
+    // read data from socket, but never more than what is missing from the current packet,
+    // tcp doesn't preserve the packet boundary so a packet can come in several pieces.
+    // the bytes go directly into the slot of the pool which the decoder assembles the packet in
+    bool packetstart = (decoder_->writeSize() == decoder_->frameSize());
+    int64_t kerneltime = 0;
+    int iResult = kerneltimestamps_
+        ? recvTimestamped(ConnectSocket_, decoder_->writePointer(), decoder_->writeSize(), &kerneltime)
+        : recv(ConnectSocket_, decoder_->writePointer(), decoder_->writeSize(), 0);
 
     // if >0 it means there is something in the socket, we need to read it
     if (iResult > 0) {
 
-        // i just affraid there will be corrupted data so i checked here
-        if (iResult == receivebuffersize) {
+        // the frame has the time of its first bytes, from the kernel if there is one, otherwise right after recv().
+        // the frames are in the order they arrived, so a time before the last frame (a new anchor, or the kernel and
+        // our clock disagreeing by a little) is the time of the last frame, a reader searches the timestamps in order
+        if (packetstart) {
+            int64_t arrival = (kerneltime != 0) ? clock_.fromWall(kerneltime) : FrameClock::now();
+            if (arrival > arrival_) arrival_ = arrival;
+            if (kerneltime != 0) countkerneltime_++;
+        }
 
-            // convert binary string to something else without loop
-            // https://stackoverflow.com/questions/52492229/c-byte-array-to-int
-            // https://en.cppreference.com/w/cpp/string/byte/memcpy
-            memcpy(ultrasound_frd->data(), receivebuffer + headerindexsize, datasize);
+#ifdef AMODE_ENABLE_STATS
+        if (packetstart) statsfirstbyte_ = statsNow();
+#endif
+
+        // only continue when the packet is complete, otherwise wait for the rest in the next call
+        if (decoder_->commit(iResult)) {
+
+#ifdef AMODE_ENABLE_STATS
+            // the decoded time is after the header was checked
+            int64_t decoded = statsNow();
+            if (statsarrival_ != 0) stats_->record(STATS_INTERARRIVAL, decoded - statsarrival_);
+            stats_->record(STATS_RECEIVE, decoded - statsfirstbyte_);
+            statsarrival_ = decoded;
+#endif
+
+            // the index tells if frames were lost on the way, this is what it is sent for
+            uint64_t index = 0;
+            memcpy(&index, decoder_->frame() + headersize_, indexsize_);
+
+            // the kernel goes back to delayed acks by itself
+            if (lowlatency_) setQuickAck(ConnectSocket_);
+            tracker_->update(index, arrival_ * 1e-9);
+
+            // the first frame after a reconnect, this is how long the blip really cost
+            // (a connect can work and the connection is lost again before a frame came, that is still the same blip)
+            if (lostat_ != 0) {
+                countreconnect_++;
+                lastfirstframe_ = (arrival_ - lostat_) * 1e-9;
+                maxfirstframe_ = std::max(maxfirstframe_, lastfirstframe_);
+                lostat_ = 0;
+            }
 
-            // lets print the bytes, not really neccessary actually
-            printf("Amode : (%dB)\n", iResult);
+            // the packet is already where it stays until everyone is done with it, so nothing is copied,
+            // if the pool was empty it was received in the buffer of the decoder and can't be passed on.
+            // with a region of interest only the reduced frame goes into the slot, this is the only copy
+            if (!current_.empty()) {
+                if (reducer_) {
+                    memcpy(current_->packet, decoder_->frame(), headersize_ + indexsize_);
+                    reducer_->process((const uint16_t*)(decoder_->frame() + headersize_ + indexsize_), (uint16_t*)current_->data);
+                }
+                current_->timestamp = arrival_;
+                current_->index = index;
+            }
+            *frame = std::move(current_);
 
             //// printing to console, this is only for debugging, which is veery slow, so keep this commented
-            //for (auto i=ultrasound_frd->begin()+43501; i!=ultrasound_frd->begin()+43601; ++i){
-            //    printf("%d ", (int16_t)*i);
+            //const uint16_t* values = (const uint16_t*)(*frame)->data;
+            //for (int i = 43501; i < 43601; ++i){
+            //    printf("%d ", (int16_t)values[i]);
             //}
             //printf("\n");
 
-
             // record only when the user stated that he wants to record
-            if (setrecord_) {
+            if (recorder_ && !frame->empty()) {
 
-                /*
-                // if this is first data, wait until trigger from qualisys before i write to a file
-                if (firstpass_) {
-                    synch::waitStart();
-                    firstpass_ = false;
-                }
-                */
-
-                // creating a string for the name of the file
-                filename_.str(std::string());
-                if (usedataindex_) {
-
-                    // if using data index, the filename structured as <timestamp>_<index>.tiff
-                    filename_ << recorddirectory_ << "\\"
-                        << std::to_string(rtb::getTime())
-                        << "_" << (int16_t)*ultrasound_frd->data()
-                        << ".tiff";
-
-                    // In a moment, i use opencv to transform our long array to matrix then save it as a .tiff image.
-                    // I tried to save it to .csv but somehow it perform very slowly,
-                    // i think there is an interference with some functions somewhere, but idk.
-                    // This one is working well so i will stick to this.
-                    std::vector<uint16_t> tmp(ultrasound_frd->begin() + 1, ultrasound_frd->end());
-                    cv::Mat amodeimage = cv::Mat(tmp).reshape(1, 30);
-                    cv::imwrite(filename_.str(), amodeimage);
-                }
-
-                else {
-                    // if not, only <timestamp>.tiff
-                    filename_ << recorddirectory_ << "\\"
-                        << std::to_string(rtb::getTime())
-                        << ".tiff";
+                // only hand a reference over to the writer thread, the disk is never touched here.
+                // for an event recording we don't wait for the trigger from qualisys like before (synch::waitStart()),
+                // the frames go into the history until it comes, so the ones before it are not lost
+                recordFrame(*frame);
+            }
 
-                    // same explanation above
-                    cv::Mat amodeimage = cv::Mat(*ultrasound_frd).reshape(1, 30);
-                    cv::imwrite(filename_.str(), amodeimage);
-                }
+            // the same frame for everyone else, none of them can make us wait
+            if (!frame->empty()) {
+                for (std::unique_ptr<FrameSubscriber>& subscriber : subscribers_) subscriber->push(*frame);
+                if (envelope_) envelope_->push(*frame);
+                if (depth_) depth_->push(*frame);
 
+                // the other processes, this is the only copy, they read it in place
+                if (shared_) shared_->publish(**frame);
             }
 
+            // the next packet goes into the next free slot
+            nextSlot();
+
             countdata_++;
         }
     }
@@ -339,82 +745,86 @@ int AModeUSConnection::receiveData(std::vector<uint16_t>* ultrasound_frd, char*
         // synch::setStop(true);
     }
 
+    // a non-blocking socket without data, nothing happened
+    else if (socketWouldBlock()) {
+        iResult = RECEIVE_AGAIN;
+    }
+
     // -1 means something happened with the connection
     else {
         printf("recv failed from A-Mode US Machine: %d\n", WSAGetLastError());
         // synch::setStop(true);
     }
 
-    // check if user presed a key
-    userquit_ = this->checkKeyPressed();
-
+    // the user quits with stop() from another thread, nothing is polled here
     return iResult;
 }
 
 
-// A function to receive the data for DATA_DEPTH mode.
-int AModeUSConnection::receiveData(std::vector<double>* ultrasound_frd, char* receivebuffer, int receivebuffersize, int datasize, int headerindexsize) {
-    // read data from socket, put it in temporary variable
-    int iResult = recv(ConnectSocket_, receivebuffer, receivebuffersize, 0);
+void AModeUSConnection::nextSlot() {
 
-    // if >0 it means there is something in the socket, we need to read it
-    if (iResult > 0) {
+    current_ = pool_->acquire();
 
-        // i just affraid there will be corrupted data so i put iResult==datasize here
-        if (iResult == receivebuffersize) {
+    // the slot only has room for the reduced frame, the whole packet is received in the buffer of the decoder
+    decoder_->setBuffer((current_.empty() || reducer_) ? nullptr : current_->packet);
+}
 
-            // convert binary string to something else without loop
-            // https://stackoverflow.com/questions/52492229/c-byte-array-to-int
-            memcpy(ultrasound_frd->data(), receivebuffer + headerindexsize, datasize);
 
-            // lets print the bytes, not really neccessary actually
-            printf("Amode : (%dB)\n", iResult);
+void AModeUSConnection::recordFrame(const FrameRef& frame) {
 
-            //// printing to console, this is only for debugging, which is veery slow, so keep this commented
-            //for (auto i = ultrasound_frd->begin(); i != ultrasound_frd->end(); ++i) {
-            //    printf("%.5f ", *i);
-            //}
-            //printf("\n");
+    if (!history_) {
+        recorder_->push(frame);
+        return;
+    }
 
-            // record only when the user stated that he wants to record
-            if (setrecord_) {
+    // waiting for the trigger, only the last frames are kept, the oldest one goes back to the pool
+    if (triggerat_ == 0) {
+        // the start of the mocap system has its own time, that is the trigger and not when we saw it
+        int64_t none = 0;
+        if (externaltrigger_ && synch::isStarted()) triggerrequest_.compare_exchange_strong(none, synch::getStartTime());
+        int64_t requested = triggerrequest_.load(std::memory_order_acquire);
+        if (requested == 0) {
+            history_->push(frame);
+            return;
+        }
 
-                /*
-                // if this is first data, wait until trigger from qualisys before i write to a file
-                if (firstpass_) {
-                    synch::waitStart();
-                    firstpass_ = false;
-                }
-                */
+        // what is older than the window was only kept in case, the rest is the start of the recording
+        triggerat_ = requested;
+        history_->dropBefore(triggerat_ - (int64_t)(pretrigger_ * 1e9));
+        countpretrigger_ = (long)history_->size();
+        triggerindex_ = frame->index;
+        printf("A-Mode trigger: %ld frames from before it go to the recorder\n", countpretrigger_);
+    }
 
-                // first column is timestamp
-                ofs_ << std::to_string(rtb::getTime()) << ",";
-                // write to csv in style, to make sure it is faster
-                std::copy(ultrasound_frd->begin(), ultrasound_frd->end(), std::ostream_iterator<double>(ofs_, ","));
-                ofs_ << "\n";
+    // the live frames wait behind the backlog, so the recording has them in order
+    if (history_->size() > 0) {
+        if (!history_->push(frame)) counttriggerlost_++;
+        flushHistory(false);
+        return;
+    }
+    recorder_->push(frame);
+}
 
-            }
 
-            countdata_++;
-        }
-    }
+void AModeUSConnection::flushHistory(bool all) {
 
-    // 0 means connection is closed 
-    else if (iResult == 0) {
-        printf("Connection closed from A-Mode US Machine\n");
-        // synch::setStop(true);
+    // never more than what fits in the queue, a full queue would make us wait (QUEUE_BLOCK) or drop the frames
+    while (history_->size() > 0) {
+        if (recorder_->getQueueDepth() < (size_t)queuecapacity_) recorder_->push(history_->pop());
+        else if (all) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        else break;
     }
+}
 
-    // -1 means something happened with the connection
-    else {
-        printf("recv failed from A-Mode US Machine: %d\n", WSAGetLastError());
-        // synch::setStop(true);
-    }
 
-    // check if user presed a key
-    userquit_ = this->checkKeyPressed();
+FrameStage* AModeUSConnection::rawStage(std::unique_ptr<FrameStage>& stage, std::string name, int outputsize) {
 
-    return iResult;
+    if (datamode_ != DATA_RAW) {
+        printf("A-Mode %s: only for DATA_RAW\n", name.c_str());
+        return nullptr;
+    }
+    if (!stage) stage.reset(new FrameStage(name, outputsize));
+    return stage.get();
 }
 
 
@@ -425,121 +835,245 @@ int AModeUSConnection::receiveData(std::vector<double>* ultrasound_frd, char* re
  */
 void AModeUSConnection::operator()() {
 
-    int iResult;
-    double timestamp = 0.0;
-
-    if (datamode_ == DATA_RAW) {
-
-        // construct a vector where we will put the data
-        std::vector<uint16_t> ultrasound_frd;
-
-        int headerindexsize = 0;
-        int datavectorsize = 0;
-        int datasize = 0;
-        if (usedataindex_) {
-            // headerindexsize will be used to skip or not to skip the bytes that represent the index
-            // so if the user specified useDataIndex(true), it means we do not skip the index byte
-            // thus the headerindexsize is only the size of headersize_
-            headerindexsize = headersize_;
-
-            // we should expect how much the size of the data we will get
-            // ultrasound_frd needs to be resized with the index byte
-            datasize = indexsize_ + (sizeof(uint16_t) * datalength_);
-            ultrasound_frd.resize(datasize / sizeof(uint16_t));
-        }
+    // this thread receives, before anything is allocated so the memory is close to its core
+    if (receivecore_ >= 0 && pinThread(receivecore_) != 0) printf("A-Mode: unable to pin the receiving thread to core %d\n", receivecore_);
+    if (threadpriority_ > 0 && setRealtimePriority(threadpriority_) != 0) printf("A-Mode: unable to run the receiving thread with SCHED_FIFO %d\n", threadpriority_);
 
-        else {
-            // if the user specified otherwise, it means we skip the index byte
-            // thus the headerindexsize is the total of headersize_ + indexsize_
-            headerindexsize = headersize_ + indexsize_;
+    startStreaming();
 
-            // ultrasound_frd needs to be resized with the index byte
-            datasize = 0 + (sizeof(uint16_t) * datalength_);
-            ultrasound_frd.resize(datasize / sizeof(uint16_t));
-        }
+    // the last complete frame, the values are frame->data, uint16_t for DATA_RAW and double for DATA_DEPTH
+    FrameRef frame;
+    int bytereceived = 0;
+
+    // the machine wasn't there when the constructor connected, that is not a lost connection
+    if (ConnectSocket_ == INVALID_SOCKET && reconnecttimeout_ > 0.0) {
+        reconnect();
+        lostat_ = 0;
+    }
+    int64_t idlesince = 0;
 
-        // temporary buffer that we will use for store binary string from socket
-        // the A-mode ultrasound machine always send full data (header+index+data)
-        // so we need to accomodate the full data
-        int receivebuffersize = (sizeof(uint16_t) * datalength_) + headersize_ + indexsize_;
-        char* receivebuffer = new char[receivebuffersize];
-        int bytereceived = 0;
-
-        countdata_ = 0;
-        timestamp = rtb::getTime();
-
-        // main loop to receive the data,
-        // we will do this until there is an error or one of the system is stop
-        do {
-            bytereceived = receiveData(&ultrasound_frd, receivebuffer, receivebuffersize, datasize, headerindexsize);
-        // } while (bytereceived > 0 && !synch::getStop());
-        } while (bytereceived > 0 && !userquit_);
-    }
-
-    else if (datamode_ == DATA_DEPTH) {
-
-        // construct a vector where we will put the data
-        std::vector<double> ultrasound_frd;
-
-        int headerindexsize = 0;
-        int datavectorsize = 0;
-        int datasize = 0;
-        if (usedataindex_) {
-            // headerindexsize will be used to skip or not to skip the bytes that represent the index
-            // so if the user specified useDataIndex(true), it means we do not skip the index byte
-            // thus the headerindexsize is only the size of headersize_
-            headerindexsize = headersize_;
-
-            // we should expect how much the size of the data we will get
-            // ultrasound_frd needs to be resized with the index byte
-            datasize = indexsize_ + (sizeof(double) * datalength_);
-            ultrasound_frd.resize(datasize / sizeof(double));
+    // main loop to receive the data,
+    // we will do this until there is an error or one of the system is stop
+    do {
+        bytereceived = receiveData(&frame);
+
+        // busy polling and nothing there yet, ask again right away, unless it is silent for longer than stalltimeout_
+        if (bytereceived == RECEIVE_AGAIN && busypoll_) {
+            if (idlesince == 0) idlesince = FrameClock::now();
+            if (stalltimeout_ <= 0.0 || (FrameClock::now() - idlesince) * 1e-9 < stalltimeout_) {
+                bytereceived = 1;
+                continue;
+            }
         }
+        idlesince = 0;
+
+        // closed, failed or nothing for stalltimeout_ (RECEIVE_AGAIN on a blocking socket), the session goes on if the machine comes back
+        if (bytereceived <= 0 && !userquit_ && reconnecttimeout_ > 0.0 && reconnect() == 0) bytereceived = 1;
+    } while (bytereceived > 0 && !userquit_ && !synch::getStop());
+
+    frame.reset();
+    stopStreaming();
+}
 
-        else {
-            // if the user specified otherwise, it means we skip the index byte
-            // thus the headerindexsize is the total of headersize_ + indexsize_
-            headerindexsize = headersize_ + indexsize_;
 
-            // ultrasound_frd needs to be resized with the index byte
-            datasize = 0 + (sizeof(double) * datalength_);
-            ultrasound_frd.resize(datasize / sizeof(double));
+void AModeUSConnection::startStreaming() {
+
+#ifdef AMODE_ENABLE_STATS
+    // the histograms are allocated before the first frame, recording a value is only a few stores
+    stats_.reset(new PipelineStats());
+    stats_->setProfile(getProfileName());
+    stats_->start(statspath_, statsinterval_);
+    statsarrival_ = 0;
+#else
+    if (!statspath_.empty() || statsinterval_ > 0.0) {
+        printf("A-Mode statistics: not available, build with -DAMODE_ENABLE_STATS=ON\n");
+    }
+#endif
+
+    // the writer thread, it has to run before the first frame arrives
+    if (setrecord_) {
+        recorder_.reset(new FrameRecorder(datamode_, roisamples_, roiprobes_, queuecapacity_, queuepolicy_));
+        recorder_->useDataIndex(usedataindex_);
+        recorder_->setFormat(recordformat_);
+        recorder_->setCompression(compressthreads_);
+        recorder_->setTiffThreads(tiffthreads_);
+        recorder_->setBackend(recordbackend_, recorddirect_);
+        recorder_->setThread(writercore_, threadpriority_);
+        recorder_->setPath(recorddirectory_, recordname_);
+        if (reducer_) {
+            // samples and probes of the recording are the reduced frame, this is where it came from
+            recorder_->setMetadata("roi.sourcesamples", std::to_string(samples_));
+            recorder_->setMetadata("roi.sourceprobes", std::to_string(probes_));
+            recorder_->setMetadata("roi.probes", reducer_->getProbesText());
+            recorder_->setMetadata("roi.first", reducer_->getWindowText());
+            recorder_->setMetadata("roi.length", std::to_string(reducer_->getLength()));
+            recorder_->setMetadata("roi.decimation", std::to_string(reducer_->getDecimation()));
+            recorder_->setMetadata("roi.taps", std::to_string(reducer_->getTaps()));
         }
+#ifdef AMODE_ENABLE_STATS
+        recorder_->setStats(stats_.get());
+#endif
+        if (recorder_->start() != 0) recorder_.reset();
+    }
 
-        // temporary buffer that we will use for store binary string from socket
-        // the A-mode ultrasound machine always send full data (header+index+data)
-        // so we need to accomodate the full data
-        int receivebuffersize = (sizeof(double) * datalength_) + headersize_ + indexsize_;
-        char* receivebuffer = new char[receivebuffersize];
-        int bytereceived = 0;
+    // all the memory for the frames is allocated here, nothing is allocated while streaming.
+    // the pool has to hold the frames in the queue of the recorder, the ones being written, and the one being received
+    // and every subscriber, its queue (which keeps one more) and the frame it looks at
+    int valuesize = (datamode_ == DATA_RAW) ? sizeof(uint16_t) : sizeof(double);
+    size_t poolsize = queuecapacity_ + 4 * compressthreads_ + 4 * tiffthreads_ + 16;
+    for (std::unique_ptr<FrameSubscriber>& subscriber : subscribers_) {
+        poolsize += subscriber->getCapacity() + 2;
+        subscriber->start();
+    }
 
-        countdata_ = 0;
-        timestamp = rtb::getTime();
+    // the envelope and the depth, their threads get the raw frames like every subscriber
+    if (envelope_) {
+        envelopedetector_.reset(new EnvelopeDetector(roisamples_, roiprobes_));
+        envelopedetector_->setFilter(envelopecenter_, envelopebandwidth_);
+        envelopedetector_->setCompression(enveloperange_);
+        EnvelopeDetector* detector = envelopedetector_.get();
+        envelope_->setProcess([detector](const FrameSlot& input, FrameSlot& output) {
+            detector->process((const uint16_t*)input.data, (uint16_t*)output.packet);
+        });
+        printf("A-Mode envelope: %s, %d taps\n", (detector->getImplementation() == ENVELOPE_AVX2) ? "AVX2" : "scalar", detector->getTaps());
+
+        poolsize += envelope_->getCapacity() + 2;
+        envelope_->start();
+    }
+    if (depth_) {
+        depthestimator_.reset(new DepthEstimator(roisamples_, roiprobes_, depththreads_));
+        depthestimator_->setEnvelope(envelopecenter_, envelopebandwidth_, enveloperange_);
+        depthestimator_->setWindow(depthfirst_, (depthlast_ < 0) ? roisamples_ - 1 : depthlast_);
+        depthestimator_->setThreshold(depththreshold_);
+        depthestimator_->setScale(depthspacing_, depthoffset_);
+        DepthEstimator* estimator = depthestimator_.get();
+        depth_->setProcess([estimator](const FrameSlot& input, FrameSlot& output) {
+            estimator->estimate((const uint16_t*)input.data, (double*)output.packet);
+        });
+        depth_->setLatencyBudget(depthbudget_);
+
+        poolsize += depth_->getCapacity() + 2;
+        depth_->start();
+    }
 
-        // main loop to receive the data,
-        // we will do this until there is an error or one of the system is stop
-        do {
-            bytereceived = receiveData(&ultrasound_frd, receivebuffer, receivebuffersize, datasize, headerindexsize);
-        // } while (bytereceived > 0 && !synch::getStop());
-        } while (bytereceived > 0 && !userquit_);
+    // the history of an event recording holds its frames too, a bit more than the window so it is never short
+    history_.reset();
+    triggerat_ = 0;
+    countpretrigger_ = 0;
+    counttriggerlost_ = 0;
+    if (recorder_ && pretrigger_ > 0.0) {
+        history_.reset(new FrameHistory((size_t)(pretrigger_ * pretriggerrate_ * 1.1) + 64));
+        poolsize += history_->getCapacity();
+        printf("A-Mode trigger: waiting, %.2f s (%d frames) before it are kept\n", pretrigger_, (int)history_->getCapacity());
     }
+    pool_.reset(new FramePool(poolsize, headersize_, indexsize_, valuesize * roisamples_ * roiprobes_));
+
+    // the whole ring is allocated and touched here too
+    if (!sharedname_.empty()) {
+        FrameClock clock;
+        shared_.reset(new SharedRingWriter());
+        if (shared_->open(sharedname_, datamode_, roisamples_, roiprobes_, valuesize, sharedslots_, clock.getMonotonicOrigin(), clock.getWallOrigin()) != 0) shared_.reset();
+    }
+
+    // reassembles the packets from the socket, the A-mode ultrasound machine always send full data (header+index+data)
+    // so the packet is assembled in a slot of the pool which can hold the full data
+    decoder_.reset(new FrameDecoder(headersize_, indexsize_, valuesize * datalength_));
+    decoder_->setSyncCheck(headersync_);
+    nextSlot();
+
+    // 16 bits index for DATA_RAW, 64 bits for DATA_DEPTH
+    tracker_.reset(new IndexTracker(8 * indexsize_));
+    countkerneltime_ = 0;
+    clock_.anchor();
+    arrival_ = 0;
+
+    // the socket options, they are set again after every reconnect
+    tuneSocket();
+
+    countdata_ = 0;
+    starttime_ = rtb::getTime();
+}
+
+
+void AModeUSConnection::stopStreaming() {
+
+    current_.reset();
+
+    // the readers in other processes see that the session is over
+    if (shared_) {
+        printf("A-Mode shared ring: %lu frames published in %s\n", (unsigned long)shared_->getPublishedCount(), sharedname_.c_str());
+        shared_->close();
+    }
+
+    // the callbacks get what is still waiting for them
+    for (size_t i = 0; i < subscribers_.size(); i++) {
+        subscribers_[i]->stop();
+        printf("A-Mode subscriber %d: %ld frames delivered, %ld dropped\n", (int)i, subscribers_[i]->getDeliverCount(), subscribers_[i]->getDropCount());
+    }
+
+    // what the stages computed of the frames that are still waiting, then their subscribers
+    if (envelope_) envelope_->stop();
+    if (depth_) depth_->stop();
 
     double timestamp2 = rtb::getTime();
-    std::cout << timestamp2 << " - " << timestamp << " = " << timestamp2 - timestamp << " (" << (timestamp2 - timestamp) / countdata_ << ")\n";
+    std::cout << timestamp2 << " - " << starttime_ << " = " << timestamp2 - starttime_ << " (" << (timestamp2 - starttime_) / countdata_ << ")\n";
 
-    // disconnect the socket, we want everything is clean after this program is stopped
-    // https://docs.microsoft.com/en-us/windows/win32/winsock/disconnecting-the-client
-    iResult = shutdown(ConnectSocket_, SD_SEND);
-    if (iResult == SOCKET_ERROR) {
-        printf("shutdown failed: %d\n", WSAGetLastError());
-        closesocket(ConnectSocket_);
-        WSACleanup();
+    closeTCP();
+
+    printf("A-Mode index: %ld frames, %ld missing in %ld gaps, %ld duplicates, %ld reordered, worst loss %.2f%% in one second\n",
+        tracker_->getReceivedCount(), tracker_->getMissingCount(), tracker_->getGapCount(),
+        tracker_->getDuplicateCount(), tracker_->getReorderCount(), 100.0 * tracker_->getMaxLossRate());
+    printf("A-Mode clock: %ld of %ld frames timestamped by the kernel\n", countkerneltime_, tracker_->getReceivedCount());
+    if (countreconnect_ > 0) {
+        printf("A-Mode reconnect: %ld times, first frame %.1f ms after the loss (worst %.1f ms)\n",
+            countreconnect_, 1e3 * lastfirstframe_, 1e3 * maxfirstframe_);
     }
-    closesocket(ConnectSocket_);
-    WSACleanup();
 
-    // close the filestream
-    if (ofs_.is_open()) {
-        ofs_.close();
+    // write what is still waiting in the queue, then close the file
+    if (recorder_) {
+        // the loss on the network, the frames lost because the disk was too slow are in "dropped"
+        recorder_->setMetadata("index.received", std::to_string(tracker_->getReceivedCount()));
+        recorder_->setMetadata("index.missing", std::to_string(tracker_->getMissingCount()));
+        recorder_->setMetadata("index.gaps", std::to_string(tracker_->getGapCount()));
+        recorder_->setMetadata("index.duplicates", std::to_string(tracker_->getDuplicateCount()));
+        recorder_->setMetadata("index.reordered", std::to_string(tracker_->getReorderCount()));
+        recorder_->setMetadata("index.maxlossrate", std::to_string(tracker_->getMaxLossRate()));
+        recorder_->setMetadata("index.missingranges", tracker_->getMissingRangesText(INDEXTRACKER_MAXRANGES));
+        recorder_->setMetadata("clock.kernelframes", std::to_string(countkerneltime_));
+        recorder_->setMetadata("connection.reconnects", std::to_string(countreconnect_));
+        recorder_->setMetadata("connection.maxfirstframe", std::to_string(maxfirstframe_));
+        if (history_) {
+            // the backlog which is still there goes to the disk now, we are done with the socket anyway
+            if (triggerat_ != 0) {
+                flushHistory(true);
+                FrameClock clock;
+                recorder_->setMetadata("trigger.time", std::to_string(clock.toWall(triggerat_)));
+                recorder_->setMetadata("trigger.index", std::to_string(triggerindex_));
+                recorder_->setMetadata("trigger.preframes", std::to_string(countpretrigger_));
+                printf("A-Mode trigger: %ld frames before it recorded, %ld lost because the history was full\n",
+                    countpretrigger_, counttriggerlost_);
+            }
+            else {
+                printf("A-Mode trigger: never came, nothing recorded\n");
+            }
+            recorder_->setMetadata("trigger.pretrigger", std::to_string(pretrigger_));
+            recorder_->setMetadata("trigger.lost", std::to_string(counttriggerlost_));
+            history_->clear();
+        }
+
+        recorder_->stop();
+        printf("A-Mode recorder: %ld frames written, %ld dropped, queue peak %d of %d\n",
+            recorder_->getWriteCount(), recorder_->getDropCount(), (int)recorder_->getMaxQueueDepth(), queuecapacity_);
+        if (compressthreads_ > 0) {
+            printf("A-Mode recorder: compression ratio %.2f, %.1f us per frame\n", recorder_->getCompressionRatio(), recorder_->getEncodeTime());
+        }
+    }
+    if (pool_->getEmptyCount() > 0) {
+        printf("A-Mode frame pool: empty %ld times, these frames were not recorded\n", pool_->getEmptyCount());
     }
-}
\ No newline at end of file
+
+#ifdef AMODE_ENABLE_STATS
+    // after the recorder, so the queue wait and the writing of the last frames are in it
+    stats_->stop();
+#endif
+}
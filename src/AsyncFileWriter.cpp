@@ -0,0 +1,468 @@
+#include "AsyncFileWriter.h"
+
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+// the same on every architecture except alpha, older C libraries don't have them
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup 425
+#define __NR_io_uring_enter 426
+#endif
+
+/**
+ * @brief The rings shared with the kernel, and the write of every buffer so a short write can be continued.
+ */
+struct AsyncFileWriter::Ring
+{
+    int fd = -1;                            //!< The io_uring
+    void* sqmap = MAP_FAILED;               //!< Mapping of the submission ring
+    size_t sqmapsize = 0;
+    void* cqmap = MAP_FAILED;               //!< Mapping of the completion ring, the same as sqmap with IORING_FEAT_SINGLE_MMAP
+    size_t cqmapsize = 0;
+    io_uring_sqe* sqes = (io_uring_sqe*)MAP_FAILED; //!< The submission entries
+    size_t sqessize = 0;
+    unsigned* sqtail = nullptr;
+    unsigned* sqmask = nullptr;
+    unsigned* sqarray = nullptr;
+    unsigned* cqhead = nullptr;
+    unsigned* cqtail = nullptr;
+    unsigned* cqmask = nullptr;
+    io_uring_cqe* cqes = nullptr;
+    std::vector<iovec> iov;                 //!< What is left to write of every buffer
+    std::vector<uint64_t> offset;           //!< Where it goes
+    std::vector<int> file;                  //!< Which file, a segment which is closed can still be written
+    std::vector<bool> retry;                //!< The write was short, the rest has to be queued again
+};
+
+static int ioUringSetup(unsigned entries, io_uring_params* params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int ioUringEnter(int fd, unsigned submit, unsigned wait, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, submit, wait, flags, NULL, 0);
+}
+#else
+struct AsyncFileWriter::Ring
+{
+};
+#endif
+
+
+AsyncFileWriter::AsyncFileWriter() {
+}
+
+
+AsyncFileWriter::~AsyncFileWriter() {
+    close();
+    closeRing();
+}
+
+
+void AsyncFileWriter::setBackend(int backend, bool direct) {
+    backend_ = backend;
+    direct_ = direct;
+}
+
+
+void AsyncFileWriter::setBuffers(size_t buffersize, int inflight) {
+    buffersize_ = (buffersize + FILEWRITER_ALIGNMENT - 1) / FILEWRITER_ALIGNMENT * FILEWRITER_ALIGNMENT;
+    if (buffersize_ == 0) buffersize_ = FILEWRITER_ALIGNMENT;
+    inflight_ = (inflight > 0) ? inflight : 1;
+}
+
+
+bool AsyncFileWriter::isOpen() {
+    return file_ != nullptr || fd_ >= 0;
+}
+
+
+size_t AsyncFileWriter::getBufferSize() {
+    return buffersize_;
+}
+
+
+int AsyncFileWriter::getBackend() {
+    return active_;
+}
+
+
+uint64_t AsyncFileWriter::getOffset() {
+    return offset_;
+}
+
+
+char* AsyncFileWriter::getBuffer() {
+    return buffers_[current_];
+}
+
+
+bool AsyncFileWriter::hasIoUring() {
+#ifdef __linux__
+    // only asked once, the answer doesn't change while we run
+    static const bool available = [] {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        int fd = ioUringSetup(1, &params);
+        if (fd < 0) return false;
+        ::close(fd);
+        return true;
+    }();
+    return available;
+#else
+    return false;
+#endif
+}
+
+
+int AsyncFileWriter::open(const std::string& path, uint64_t preallocate) {
+
+    // the file before can still be written while this one starts, if it failed already the next close() tells
+    if (close(false) != 0) closefailed_ = true;
+
+    active_ = backend_;
+    if (active_ == FILEWRITER_AUTO) active_ = hasIoUring() ? FILEWRITER_IOURING : FILEWRITER_BUFFERED;
+
+    // the buffers stay for the next files, only taken again if the configuration changed (when nothing is written from them)
+    size_t count = (active_ == FILEWRITER_IOURING) ? inflight_ : 1;
+    if (active_ != FILEWRITER_IOURING) finishClose(true);
+    if (buffers_.size() != count || memory_.size() != count * buffersize_ + FILEWRITER_ALIGNMENT) {
+        finishClose(true);
+        memory_.assign(count * buffersize_ + FILEWRITER_ALIGNMENT, 0);
+        uintptr_t aligned = ((uintptr_t)memory_.data() + FILEWRITER_ALIGNMENT - 1) / FILEWRITER_ALIGNMENT * FILEWRITER_ALIGNMENT;
+        buffers_.resize(count);
+        for (size_t b = 0; b < count; b++) buffers_[b] = (char*)aligned + b * buffersize_;
+        busy_.assign(count, false);
+        current_ = 0;
+    }
+    offset_ = 0;
+    padded_ = false;
+    failed_ = false;
+    path_ = path;
+
+#ifdef __linux__
+    int fd = -1;
+    if (active_ == FILEWRITER_IOURING) {
+        if (ring_ == nullptr && openRing() != 0) {
+            printf("A-mode recording: no io_uring, %s is written with fwrite()\n", path.c_str());
+            active_ = FILEWRITER_BUFFERED;
+        }
+    }
+    if (active_ == FILEWRITER_IOURING) {
+        ring_->iov.resize(count);
+        ring_->offset.resize(count);
+        ring_->file.resize(count, -1);
+        ring_->retry.resize(count, false);
+
+        // not every filesystem can do O_DIRECT (tmpfs), then through the page cache
+        directopen_ = direct_;
+        fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | (direct_ ? O_DIRECT : 0), 0644);
+        if (fd_ < 0 && direct_) {
+            printf("A-mode recording: %s can't be opened with O_DIRECT, it goes through the page cache\n", path.c_str());
+            directopen_ = false;
+            fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        }
+        fd = fd_;
+    }
+    else
+#endif
+    {
+        directopen_ = false;
+        file_ = fopen(path.c_str(), "wb");
+        // we do the buffering ourselves
+        if (file_ != nullptr) setvbuf(file_, NULL, _IONBF, 0);
+#ifdef __linux__
+        if (file_ != nullptr) fd = fileno(file_);
+#endif
+    }
+
+    if (!isOpen()) {
+        printf("Unable to create %s for A-mode Ultrasound logging\n", path.c_str());
+        return -1;
+    }
+
+    // the blocks are found now and not while streaming, the size stays 0 so a crashed file has no zeros at the end
+    preallocated_ = false;
+#ifdef __linux__
+    if (preallocate > 0) preallocated_ = (fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, (off_t)preallocate) == 0);
+#endif
+
+    return 0;
+}
+
+
+int AsyncFileWriter::submit(size_t size) {
+
+    if (!isOpen()) return -1;
+    if (failed_) return -1;
+
+#ifdef __linux__
+    if (active_ == FILEWRITER_IOURING) {
+        // O_DIRECT writes whole blocks, the padding is cut in close()
+        size_t writesize = size;
+        if (directopen_ && size % FILEWRITER_ALIGNMENT != 0) {
+            writesize = (size + FILEWRITER_ALIGNMENT - 1) / FILEWRITER_ALIGNMENT * FILEWRITER_ALIGNMENT;
+            memset(buffers_[current_] + size, 0, writesize - size);
+            padded_ = true;
+        }
+
+        ring_->iov[current_].iov_base = buffers_[current_];
+        ring_->iov[current_].iov_len = writesize;
+        ring_->offset[current_] = offset_;
+        ring_->file[current_] = fd_;
+        busy_[current_] = true;
+        offset_ += size;
+        if (queueWrite(current_) != 0) return -1;
+
+        // the next buffer may still be on its way to the disk
+        current_ = (current_ + 1) % (int)buffers_.size();
+        int iResult = reap(current_);
+        // only this file counts here, a failure of the file before is told by the next close()
+        finishClose(false);
+        return iResult;
+    }
+#endif
+
+    offset_ += size;
+    if (fwrite(buffers_[current_], 1, size, file_) != size) {
+        printf("A-mode recording: writing %s failed\n", path_.c_str());
+        failed_ = true;
+        return -1;
+    }
+    return 0;
+}
+
+
+int AsyncFileWriter::close(bool wait) {
+
+    if (!isOpen()) {
+        finishClose(wait);
+    }
+#ifdef __linux__
+    else if (fd_ >= 0) {
+        // only one file can be closing, the one before has to be finished first
+        finishClose(true);
+
+        // the writes in flight belong to the closing file now, and so do their failures
+        closingfd_ = fd_;
+        closingpath_ = path_;
+        closingsize_ = offset_;
+        closingtruncate_ = padded_ || preallocated_;
+        closingfailed_ = failed_;
+        fd_ = -1;
+        failed_ = false;
+        finishClose(wait);
+
+        // what is known to have failed already is told now, the rest when it is finished
+        if (closingfd_ >= 0 && closingfailed_) {
+            closefailed_ = true;
+            closingfailed_ = false;
+        }
+    }
+#endif
+    else {
+#ifdef __linux__
+        if (preallocated_ && ftruncate(fileno(file_), (off_t)offset_) != 0) failed_ = true;
+#endif
+        if (fclose(file_) != 0) failed_ = true;
+        file_ = nullptr;
+        if (failed_) closefailed_ = true;
+    }
+
+    int iResult = closefailed_ ? -1 : 0;
+    closefailed_ = false;
+    return iResult;
+}
+
+
+int AsyncFileWriter::finishClose(bool wait) {
+
+    int iResult = 0;
+#ifdef __linux__
+    if (closingfd_ < 0) return 0;
+
+    for (size_t b = 0; b < busy_.size(); b++) {
+        if (!busy_[b] || ring_->file[b] != closingfd_) continue;
+        if (!wait) return 0;
+        // a failure of its writes goes to closingfailed_, not to the open file
+        reap((int)b);
+    }
+
+    // the padding of O_DIRECT and the preallocated blocks behind the end are given back
+    if (closingtruncate_ && ftruncate(closingfd_, (off_t)closingsize_) != 0) closingfailed_ = true;
+    if (::close(closingfd_) != 0) closingfailed_ = true;
+    closingfd_ = -1;
+
+    // submit() and open() can't tell anyone, the next close() does
+    if (closingfailed_) {
+        printf("A-mode recording: %s was not written completely\n", closingpath_.c_str());
+        closefailed_ = true;
+        closingfailed_ = false;
+        iResult = -1;
+    }
+#endif
+    return iResult;
+}
+
+
+int AsyncFileWriter::openRing() {
+#ifdef __linux__
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    Ring* ring = new Ring();
+    ring->fd = ioUringSetup((unsigned)inflight_, &params);
+    if (ring->fd < 0) {
+        delete ring;
+        return -1;
+    }
+    ring_ = ring;
+
+    // the two rings and the entries are memory of the kernel, mapped with fixed offsets
+    ring->sqmapsize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cqmapsize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cqmapsize > ring->sqmapsize) ring->sqmapsize = ring->cqmapsize;
+        ring->cqmapsize = 0;
+    }
+    ring->sqmap = mmap(NULL, ring->sqmapsize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sqmap == MAP_FAILED) {
+        closeRing();
+        return -1;
+    }
+    if (ring->cqmapsize == 0) {
+        ring->cqmap = ring->sqmap;
+    }
+    else {
+        ring->cqmap = mmap(NULL, ring->cqmapsize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cqmap == MAP_FAILED) {
+            closeRing();
+            return -1;
+        }
+    }
+    ring->sqessize = params.sq_entries * sizeof(io_uring_sqe);
+    ring->sqes = (io_uring_sqe*)mmap(NULL, ring->sqessize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        closeRing();
+        return -1;
+    }
+
+    char* sq = (char*)ring->sqmap;
+    char* cq = (char*)ring->cqmap;
+    ring->sqtail = (unsigned*)(sq + params.sq_off.tail);
+    ring->sqmask = (unsigned*)(sq + params.sq_off.ring_mask);
+    ring->sqarray = (unsigned*)(sq + params.sq_off.array);
+    ring->cqhead = (unsigned*)(cq + params.cq_off.head);
+    ring->cqtail = (unsigned*)(cq + params.cq_off.tail);
+    ring->cqmask = (unsigned*)(cq + params.cq_off.ring_mask);
+    ring->cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+
+void AsyncFileWriter::closeRing() {
+#ifdef __linux__
+    if (ring_ == nullptr) return;
+    if (ring_->sqes != MAP_FAILED) munmap(ring_->sqes, ring_->sqessize);
+    if (ring_->cqmap != MAP_FAILED && ring_->cqmap != ring_->sqmap) munmap(ring_->cqmap, ring_->cqmapsize);
+    if (ring_->sqmap != MAP_FAILED) munmap(ring_->sqmap, ring_->sqmapsize);
+    ::close(ring_->fd);
+#endif
+    delete ring_;
+    ring_ = nullptr;
+}
+
+
+int AsyncFileWriter::queueWrite(int buffer) {
+#ifdef __linux__
+    // never more writes than buffers, and the kernel takes the entries in io_uring_enter(), so there is always room
+    unsigned tail = *ring_->sqtail;
+    unsigned index = tail & *ring_->sqmask;
+    io_uring_sqe* sqe = &ring_->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->fd = ring_->file[buffer];
+    sqe->addr = (uint64_t)(uintptr_t)&ring_->iov[buffer];
+    sqe->len = 1;
+    sqe->off = ring_->offset[buffer];
+    sqe->user_data = (uint64_t)buffer;
+    ring_->sqarray[index] = index;
+    __atomic_store_n(ring_->sqtail, tail + 1, __ATOMIC_RELEASE);
+
+    int submitted;
+    while ((submitted = ioUringEnter(ring_->fd, 1, 0, 0)) < 0 && errno == EINTR) {}
+    if (submitted < 0) {
+        bool closing = (ring_->file[buffer] == closingfd_);
+        printf("A-mode recording: io_uring refused the write of %s (%s)\n", (closing ? closingpath_ : path_).c_str(), strerror(errno));
+        busy_[buffer] = false;
+        if (closing) closingfailed_ = true;
+        else failed_ = true;
+        return -1;
+    }
+#endif
+    return 0;
+}
+
+
+int AsyncFileWriter::reap(int buffer) {
+#ifdef __linux__
+    while (true) {
+        unsigned head = *ring_->cqhead;
+        unsigned tail = __atomic_load_n(ring_->cqtail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            io_uring_cqe* cqe = &ring_->cqes[head & *ring_->cqmask];
+            int b = (int)cqe->user_data;
+            iovec& iov = ring_->iov[b];
+
+            // the write can be one of the file being closed
+            if (cqe->res <= 0) {
+                bool closing = (ring_->file[b] == closingfd_);
+                printf("A-mode recording: writing %s failed (%s)\n", (closing ? closingpath_ : path_).c_str(), strerror(cqe->res < 0 ? -cqe->res : ENOSPC));
+                busy_[b] = false;
+                if (closing) closingfailed_ = true;
+                else failed_ = true;
+            }
+            // a short write (e.g. interrupted), the rest is written where it stopped
+            else if ((size_t)cqe->res < iov.iov_len) {
+                iov.iov_base = (char*)iov.iov_base + cqe->res;
+                iov.iov_len -= cqe->res;
+                ring_->offset[b] += cqe->res;
+                ring_->retry[b] = true;
+            }
+            else {
+                busy_[b] = false;
+            }
+        }
+        __atomic_store_n(ring_->cqhead, head, __ATOMIC_RELEASE);
+
+        for (size_t b = 0; b < ring_->retry.size(); b++) {
+            if (!ring_->retry[b]) continue;
+            ring_->retry[b] = false;
+            queueWrite((int)b);
+        }
+
+        bool waiting = false;
+        if (buffer >= 0) waiting = busy_[buffer];
+        else for (size_t b = 0; b < busy_.size(); b++) waiting = waiting || busy_[b];
+        if (!waiting) break;
+
+        if (ioUringEnter(ring_->fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+            printf("A-mode recording: waiting for io_uring failed (%s)\n", strerror(errno));
+            if (buffer >= 0 && ring_->file[buffer] == closingfd_) closingfailed_ = true;
+            else failed_ = true;
+            return -1;
+        }
+    }
+#endif
+    return failed_ ? -1 : 0;
+}
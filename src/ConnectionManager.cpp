@@ -0,0 +1,173 @@
+#include "ConnectionManager.h"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+ConnectionManager::ConnectionManager(int loops) {
+    loops_ = (loops > 0) ? loops : 1;
+}
+
+
+void ConnectionManager::add(AModeUSConnection* connection) {
+    connections_.push_back(connection);
+}
+
+
+void ConnectionManager::stop() {
+    stop_ = true;
+}
+
+
+size_t ConnectionManager::getConnectionCount() {
+    return connections_.size();
+}
+
+
+int ConnectionManager::getLoopCount() {
+    return loops_;
+}
+
+
+long ConnectionManager::getWakeupCount() {
+    return countwakeup_;
+}
+
+
+void ConnectionManager::operator()() {
+
+    stop_ = false;
+
+    // everything is allocated before any socket is read, like in AModeUSConnection::operator()()
+    std::vector<std::vector<AModeUSConnection*>> loopconnections(loops_);
+    size_t count = 0;
+    for (AModeUSConnection* connection : connections_) {
+        if (connection->getSocket() == INVALID_SOCKET) {
+            printf("A-Mode manager: a connection is not connected, it is left out\n");
+            continue;
+        }
+        if (setNonBlocking(connection->getSocket()) != 0) {
+            printf("A-Mode manager: unable to make the socket non-blocking: %d\n", WSAGetLastError());
+            continue;
+        }
+        connection->startStreaming();
+        loopconnections[count % loops_].push_back(connection);
+        count++;
+    }
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < loops_; i++) {
+        if (!loopconnections[i].empty()) threads.push_back(std::thread(&ConnectionManager::eventLoop, this, loopconnections[i]));
+    }
+    eventLoop(loopconnections[0]);
+    for (std::thread& thread : threads) thread.join();
+
+    for (std::vector<AModeUSConnection*>& connections : loopconnections) {
+        for (AModeUSConnection* connection : connections) connection->stopStreaming();
+    }
+}
+
+
+bool ConnectionManager::readConnection(AModeUSConnection* connection) {
+
+    // the frame is only passed on to the recorder, nobody here needs it
+    FrameRef frame;
+
+    for (int i = 0; i < MANAGER_READBUDGET; i++) {
+        int iResult = connection->receiveData(&frame);
+        if (connection->userquit_ || synch::getStop()) stop_ = true;
+
+        if (iResult == RECEIVE_AGAIN) return true;
+        if (iResult <= 0) return false;
+    }
+
+    // still data in the socket, the next wait returns immediately for it
+    return true;
+}
+
+
+#ifdef __linux__
+
+void ConnectionManager::eventLoop(std::vector<AModeUSConnection*> connections) {
+
+    if (connections.empty()) return;
+
+    int epollfd = epoll_create1(0);
+    if (epollfd < 0) {
+        printf("A-Mode manager: epoll_create1 failed: %d\n", errno);
+        return;
+    }
+
+    // level triggered, a socket which still has data after MANAGER_READBUDGET is reported again
+    for (size_t i = 0; i < connections.size(); i++) {
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.u64 = i;
+        epoll_ctl(epollfd, EPOLL_CTL_ADD, connections[i]->getSocket(), &event);
+    }
+
+    std::vector<struct epoll_event> events(connections.size());
+    size_t open = connections.size();
+
+    while (open > 0 && !stop_) {
+        int ready = epoll_wait(epollfd, events.data(), (int)events.size(), MANAGER_TIMEOUT);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            printf("A-Mode manager: epoll_wait failed: %d\n", errno);
+            break;
+        }
+        if (ready > 0) countwakeup_++;
+
+        for (int e = 0; e < ready; e++) {
+            AModeUSConnection* connection = connections[events[e].data.u64];
+
+            // a closed or broken connection is only read once more to see it, then it is taken out
+            if (!readConnection(connection)) {
+                epoll_ctl(epollfd, EPOLL_CTL_DEL, connection->getSocket(), nullptr);
+                open--;
+            }
+        }
+    }
+
+    close(epollfd);
+}
+
+#else
+
+void ConnectionManager::eventLoop(std::vector<AModeUSConnection*> connections) {
+
+    if (connections.empty()) return;
+
+    // without epoll the whole list is given to poll() every time, fine for a handful of machines
+    std::vector<struct pollfd> fds(connections.size());
+    for (size_t i = 0; i < connections.size(); i++) {
+        fds[i].fd = connections[i]->getSocket();
+        fds[i].events = POLLIN;
+        fds[i].revents = 0;
+    }
+
+    size_t open = connections.size();
+
+    while (open > 0 && !stop_) {
+        int ready = WSAPoll(fds.data(), (unsigned long)fds.size(), MANAGER_TIMEOUT);
+        if (ready < 0) {
+            printf("A-Mode manager: poll failed: %d\n", WSAGetLastError());
+            break;
+        }
+        if (ready > 0) countwakeup_++;
+
+        for (size_t i = 0; i < fds.size() && ready > 0; i++) {
+            if (fds[i].revents == 0) continue;
+            ready--;
+
+            // negative descriptors are ignored by poll(), that is how a closed connection is taken out
+            if (!readConnection(connections[i])) {
+                fds[i].fd = INVALID_SOCKET;
+                open--;
+            }
+            fds[i].revents = 0;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,94 @@
+#include "DepthEstimator.h"
+
+DepthEstimator::DepthEstimator(int samples, int probes, int threads)
+    : samples_(samples), probes_(probes), windowfirst_(probes, 0), windowlast_(probes, samples - 1), pool_(threads) {
+
+    for (int t = 0; t < pool_.getThreadCount(); t++) {
+        detectors_.emplace_back(new EnvelopeDetector(samples_, 1));
+        envelopes_.emplace_back(samples_);
+    }
+}
+
+
+void DepthEstimator::setWindow(int first, int last) {
+
+    for (int p = 0; p < probes_; p++) setWindow(p, first, last);
+}
+
+
+void DepthEstimator::setWindow(int probe, int first, int last) {
+
+    if (probe < 0 || probe >= probes_) return;
+    if (first < 0) first = 0;
+    if (last > samples_ - 1) last = samples_ - 1;
+    if (last < first) last = first;
+
+    windowfirst_[probe] = first;
+    windowlast_[probe] = last;
+}
+
+
+void DepthEstimator::setThreshold(double decibel) {
+    threshold_ = decibel;
+}
+
+
+void DepthEstimator::setScale(double spacing, double offset) {
+    spacing_ = spacing;
+    offset_ = offset;
+}
+
+
+void DepthEstimator::setEnvelope(double center, double bandwidth, double range) {
+
+    for (std::unique_ptr<EnvelopeDetector>& detector : detectors_) {
+        detector->setFilter(center, bandwidth);
+        detector->setCompression(range);
+    }
+}
+
+
+void DepthEstimator::estimate(const uint16_t* raw, double* depth) {
+
+    raw_ = raw;
+    depth_ = depth;
+    pool_.run(probes_, [this](size_t p, int thread) { estimateProbe((int)p, thread); });
+}
+
+
+int DepthEstimator::getThreadCount() {
+    return (int)detectors_.size();
+}
+
+
+void DepthEstimator::estimateProbe(int p, int thread) {
+
+    EnvelopeDetector& detector = *detectors_[thread];
+    uint16_t* envelope = envelopes_[thread].data();
+
+    detector.processLine(raw_ + (size_t)p * samples_, envelope);
+
+    // the brightest sample of the window is the echo
+    int peak = windowfirst_[p];
+    for (int s = peak + 1; s <= windowlast_[p]; s++) {
+        if (envelope[s] > envelope[peak]) peak = s;
+    }
+
+    // the top of the parabola through the peak and its neighbours, if the peak is a real maximum
+    double position = peak;
+    double value = envelope[peak];
+    if (peak > 0 && peak < samples_ - 1) {
+        double before = envelope[peak - 1];
+        double after = envelope[peak + 1];
+        double curvature = before - 2.0 * value + after;
+        if (curvature < 0.0) {
+            double delta = 0.5 * (before - after) / curvature;
+            position += delta;
+            value -= 0.25 * (before - after) * delta;
+        }
+    }
+
+    double decibel = detector.toDecibel(value);
+    depth_[(size_t)p * DEPTH_VALUES] = (decibel >= threshold_) ? offset_ + position * spacing_ : DEPTH_NOECHO;
+    depth_[(size_t)p * DEPTH_VALUES + 1] = decibel;
+}
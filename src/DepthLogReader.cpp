@@ -0,0 +1,179 @@
+#include "DepthLogReader.h"
+
+#include <string.h>
+#include <boost/filesystem.hpp>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+DepthLogReader::DepthLogReader() {
+}
+
+
+DepthLogReader::~DepthLogReader() {
+    close();
+}
+
+
+int DepthLogReader::open(std::string directory, std::string name) {
+
+    close();
+
+    std::string filepath = (boost::filesystem::path(directory) / (name + DEPTHLOG_EXTENSION)).string();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        printf("No A-mode depth log %s found in %s\n", name.c_str(), directory.c_str());
+        return -1;
+    }
+
+    LARGE_INTEGER filesize;
+    GetFileSizeEx(file, &filesize);
+    size_ = (uint64_t)filesize.QuadPart;
+
+    HANDLE mapping = (size_ > 0) ? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+    data_ = (mapping != NULL) ? (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    filehandle_ = file;
+    maphandle_ = mapping;
+#else
+    int fd = ::open(filepath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        printf("No A-mode depth log %s found in %s\n", name.c_str(), directory.c_str());
+        return -1;
+    }
+
+    struct stat filestat;
+    fstat(fd, &filestat);
+    size_ = (uint64_t)filestat.st_size;
+
+    void* data = (size_ > 0) ? mmap(NULL, size_, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    data_ = (data == MAP_FAILED) ? nullptr : (const char*)data;
+#endif
+
+    if (data_ == nullptr || size_ < sizeof(DepthLogHeader) || memcmp(data_, DEPTHLOG_MAGIC, 8) != 0) {
+        printf("%s is not an A-mode depth log\n", filepath.c_str());
+        close();
+        return -1;
+    }
+    header_ = (const DepthLogHeader*)data_;
+
+    // walk from block to block, the last one may be cut if the session crashed
+    uint64_t columns = (uint64_t)header_->probes * header_->values;
+    uint64_t offset = header_->headersize;
+    while (offset + sizeof(DepthLogBlockHeader) <= size_) {
+        const DepthLogBlockHeader* blockheader = (const DepthLogBlockHeader*)(data_ + offset);
+
+        // the trailer is after the last block
+        if (memcmp(blockheader->magic, DEPTHLOG_METADATA_MAGIC, 8) == 0) {
+            if (offset + sizeof(DepthLogBlockHeader) + blockheader->blocksize > size_) break;
+            metadata_.assign(data_ + offset + sizeof(DepthLogBlockHeader), blockheader->blocksize);
+            offset += sizeof(DepthLogBlockHeader) + blockheader->blocksize;
+            break;
+        }
+
+        if (memcmp(blockheader->magic, DEPTHLOG_BLOCK_MAGIC, 8) != 0 || blockheader->columns != columns
+            || blockheader->blocksize != (uint64_t)blockheader->framecount * (2 + columns) * sizeof(double)
+            || offset + sizeof(DepthLogBlockHeader) + blockheader->blocksize > size_) break;
+
+        const char* block = data_ + offset + sizeof(DepthLogBlockHeader);
+        DepthLogBlock view;
+        view.firstframe = framecount_;
+        view.framecount = blockheader->framecount;
+        view.timestamp = (const int64_t*)block;
+        view.index = (const uint64_t*)(block + (size_t)view.framecount * sizeof(int64_t));
+        view.values = (const double*)(block + (size_t)view.framecount * (sizeof(int64_t) + sizeof(uint64_t)));
+        blocks_.push_back(view);
+
+        framecount_ += view.framecount;
+        offset += sizeof(DepthLogBlockHeader) + blockheader->blocksize;
+    }
+
+    if (offset != size_) printf("%s ends with an incomplete block (the log was not closed), it is left out\n", filepath.c_str());
+    return 0;
+}
+
+
+void DepthLogReader::close() {
+
+#ifdef _WIN32
+    if (data_ != nullptr) UnmapViewOfFile(data_);
+    if (maphandle_ != nullptr) CloseHandle((HANDLE)maphandle_);
+    if (filehandle_ != nullptr) CloseHandle((HANDLE)filehandle_);
+    maphandle_ = nullptr;
+    filehandle_ = nullptr;
+#else
+    if (data_ != nullptr) munmap((void*)data_, size_);
+#endif
+
+    data_ = nullptr;
+    size_ = 0;
+    header_ = nullptr;
+    blocks_.clear();
+    framecount_ = 0;
+    metadata_.clear();
+}
+
+
+const DepthLogBlock& DepthLogReader::getBlock(int block) {
+    return blocks_[block];
+}
+
+
+std::string DepthLogReader::getMetadata(std::string key) {
+
+    size_t position = 0;
+    while (position < metadata_.size()) {
+        size_t end = metadata_.find('\n', position);
+        if (end == std::string::npos) end = metadata_.size();
+        if (metadata_.compare(position, key.size(), key) == 0 && position + key.size() < end && metadata_[position + key.size()] == '=') {
+            return metadata_.substr(position + key.size() + 1, end - position - key.size() - 1);
+        }
+        position = end + 1;
+    }
+    return "";
+}
+
+
+int DepthLogReader::getBlockCount() {
+    return (int)blocks_.size();
+}
+
+
+uint64_t DepthLogReader::getFrameCount() {
+    return framecount_;
+}
+
+
+int DepthLogReader::getProbes() {
+    return (header_ != nullptr) ? (int)header_->probes : 0;
+}
+
+
+int DepthLogReader::getValues() {
+    return (header_ != nullptr) ? (int)header_->values : 0;
+}
+
+
+int DepthLogReader::getColumnCount() {
+    return getProbes() * getValues();
+}
+
+
+const DepthLogHeader* DepthLogReader::getHeader() {
+    return header_;
+}
+
+
+int64_t DepthLogReader::toWallTime(int64_t timestamp) {
+    if (header_ == nullptr || header_->clock != RECORDING_CLOCK_MONOTONIC) return timestamp;
+    return timestamp - header_->clockorigin + header_->wallorigin;
+}
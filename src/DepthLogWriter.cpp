@@ -0,0 +1,173 @@
+#include "DepthLogWriter.h"
+
+#include <string.h>
+#include <boost/filesystem.hpp>
+
+DepthLogWriter::DepthLogWriter() {
+    memset(&header_, 0, sizeof(header_));
+}
+
+
+DepthLogWriter::~DepthLogWriter() {
+    close();
+}
+
+
+void DepthLogWriter::setBlockFrames(uint32_t blockframes) {
+    blockframes_ = (blockframes > 0) ? blockframes : 1;
+}
+
+
+bool DepthLogWriter::isOpen() {
+    return file_ != nullptr;
+}
+
+
+uint64_t DepthLogWriter::getFrameCount() {
+    return countframe_;
+}
+
+
+uint64_t DepthLogWriter::getByteCount() {
+    return countbyte_;
+}
+
+
+void DepthLogWriter::setMetadata(std::string key, std::string value) {
+    for (auto& entry : metadata_) {
+        if (entry.first == key) {
+            entry.second = value;
+            return;
+        }
+    }
+    metadata_.push_back(std::make_pair(key, value));
+}
+
+
+int DepthLogWriter::open(std::string directory, std::string name, int probes, int values, int clock, int64_t clockorigin, int64_t wallorigin) {
+
+    close();
+
+    boost::filesystem::path filepath = boost::filesystem::path(directory) / (name + DEPTHLOG_EXTENSION);
+    file_ = fopen(filepath.string().c_str(), "wb");
+    if (file_ == nullptr) {
+        printf("Unable to create %s for A-mode Ultrasound logging\n", filepath.string().c_str());
+        return -1;
+    }
+
+    // the blocks are already as big as they get, no need for the buffer of stdio
+    setvbuf(file_, NULL, _IONBF, 0);
+
+    memset(&header_, 0, sizeof(header_));
+    memcpy(header_.magic, DEPTHLOG_MAGIC, sizeof(header_.magic));
+    header_.version = DEPTHLOG_VERSION;
+    header_.headersize = sizeof(DepthLogHeader);
+    header_.probes = probes;
+    header_.values = values;
+    header_.blockframes = blockframes_;
+    header_.clock = clock;
+    header_.clockorigin = clockorigin;
+    header_.wallorigin = wallorigin;
+    columns_ = probes * values;
+
+    // all the memory is taken here, write() doesn't allocate
+    block_.assign(sizeof(DepthLogBlockHeader) + (size_t)blockframes_ * (sizeof(int64_t) + sizeof(uint64_t) + columns_ * sizeof(double)), 0);
+    buffered_ = 0;
+    countframe_ = 0;
+    countbyte_ = sizeof(header_);
+
+    if (fwrite(&header_, sizeof(header_), 1, file_) != 1) {
+        printf("A-mode depth log: writing the header failed\n");
+        return -1;
+    }
+    return 0;
+}
+
+
+int DepthLogWriter::write(int64_t timestamp, uint64_t index, const double* values) {
+
+    if (file_ == nullptr) return -1;
+
+    // the columns of a full block, the frame goes into row buffered_ of every column
+    char* columns = block_.data() + sizeof(DepthLogBlockHeader);
+    ((int64_t*)columns)[buffered_] = timestamp;
+    ((uint64_t*)(columns + (size_t)blockframes_ * sizeof(int64_t)))[buffered_] = index;
+
+    double* value = (double*)(columns + (size_t)blockframes_ * (sizeof(int64_t) + sizeof(uint64_t))) + buffered_;
+    for (int c = 0; c < columns_; c++) value[(size_t)c * blockframes_] = values[c];
+
+    buffered_++;
+    countframe_++;
+    if (buffered_ == blockframes_) return flushBlock();
+    return 0;
+}
+
+
+int DepthLogWriter::flushBlock() {
+
+    if (buffered_ == 0) return 0;
+
+    DepthLogBlockHeader* header = (DepthLogBlockHeader*)block_.data();
+    memcpy(header->magic, DEPTHLOG_BLOCK_MAGIC, sizeof(header->magic));
+    header->framecount = buffered_;
+    header->columns = columns_;
+    header->firstframe = countframe_ - buffered_;
+    header->blocksize = (uint64_t)buffered_ * (sizeof(int64_t) + sizeof(uint64_t) + columns_ * sizeof(double));
+
+    // a shorter block: every column starts right after the one before, always moved to a lower address
+    if (buffered_ < blockframes_) {
+        char* columns = block_.data() + sizeof(DepthLogBlockHeader);
+        size_t from = (size_t)blockframes_ * sizeof(int64_t);
+        size_t to = (size_t)buffered_ * sizeof(int64_t);
+        memmove(columns + to, columns + from, buffered_ * sizeof(uint64_t));
+        from += (size_t)blockframes_ * sizeof(uint64_t);
+        to += (size_t)buffered_ * sizeof(uint64_t);
+        for (int c = 0; c < columns_; c++) {
+            memmove(columns + to, columns + from, buffered_ * sizeof(double));
+            from += (size_t)blockframes_ * sizeof(double);
+            to += (size_t)buffered_ * sizeof(double);
+        }
+    }
+
+    size_t size = sizeof(DepthLogBlockHeader) + header->blocksize;
+    buffered_ = 0;
+    countbyte_ += size;
+    if (fwrite(block_.data(), 1, size, file_) != size) {
+        printf("A-mode depth log: writing a block failed\n");
+        return -1;
+    }
+    return 0;
+}
+
+
+int DepthLogWriter::close() {
+
+    if (file_ == nullptr) return 0;
+
+    int iResult = flushBlock();
+    if (writeMetadata() != 0) iResult = -1;
+    if (fclose(file_) != 0) iResult = -1;
+    file_ = nullptr;
+    return iResult;
+}
+
+
+int DepthLogWriter::writeMetadata() {
+
+    std::string metadata;
+    for (auto& entry : metadata_) metadata += entry.first + "=" + entry.second + "\n";
+
+    // a block without frames, the reader knows it by the magic
+    DepthLogBlockHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DEPTHLOG_METADATA_MAGIC, sizeof(header.magic));
+    header.firstframe = countframe_;
+    header.blocksize = metadata.size();
+
+    countbyte_ += sizeof(header) + metadata.size();
+    if (fwrite(&header, sizeof(header), 1, file_) != 1 || fwrite(metadata.data(), 1, metadata.size(), file_) != metadata.size()) {
+        printf("A-mode depth log: writing the metadata failed\n");
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,233 @@
+#define _USE_MATH_DEFINES
+#include "EnvelopeDetector.h"
+
+#include <math.h>
+
+// the AVX2 code is compiled for every x86 build, but only called when the CPU has it,
+// so the program still runs on the older PCs in the lab
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#define ENVELOPE_HAVE_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define ENVELOPE_AVX2_TARGET
+#else
+#define ENVELOPE_AVX2_TARGET __attribute__((target("avx2,fma")))
+#endif
+#endif
+
+// the envelope of silence is 0, its log would be -inf
+#define ENVELOPE_MINPOWER 1e-20f
+
+EnvelopeDetector::EnvelopeDetector(int samples, int probes)
+    : samples_(samples), probes_(probes) {
+
+    setFilter(center_, bandwidth_, taps_);
+    setCompression(range_, reference_);
+    setImplementation(ENVELOPE_AUTO);
+}
+
+
+void EnvelopeDetector::setFilter(double center, double bandwidth, int taps) {
+
+    center_ = center;
+    bandwidth_ = bandwidth;
+    taps_ = (taps < 3) ? 3 : (taps | 1);
+
+    int half = taps_ / 2;
+    filteri_.resize(taps_);
+    filterq_.resize(taps_);
+
+    // a low-pass of half the bandwidth (windowed sinc) moved up to the center frequency,
+    // once with cos (band-pass) and once with sin (band-pass and Hilbert transform), both with gain 1 at center
+    for (int k = -half; k <= half; k++) {
+        double window = 0.54 + 0.46 * cos(M_PI * k / half);
+        double x = bandwidth_ * k;
+        double lowpass = (k == 0) ? bandwidth_ : sin(M_PI * x) / (M_PI * k);
+        filteri_[k + half] = (float)(2.0 * window * lowpass * cos(2.0 * M_PI * center_ * k));
+        filterq_[k + half] = (float)(2.0 * window * lowpass * sin(2.0 * M_PI * center_ * k));
+    }
+
+    line_.assign(samples_ + 2 * half, 0.0f);
+}
+
+
+void EnvelopeDetector::setCompression(double range, double reference) {
+
+    range_ = range;
+    reference_ = reference;
+
+    // 65535 * (10 log10(power) - 20 log10(reference) + range) / range, with ln instead of log10
+    scale_ = (float)(65535.0 / range_ * 10.0 / log(10.0));
+    offset_ = (float)(65535.0 / range_ * (range_ - 20.0 * log10(reference_)));
+}
+
+
+int EnvelopeDetector::setImplementation(int implementation) {
+
+    if (implementation == ENVELOPE_AUTO) implementation = hasAvx2() ? ENVELOPE_AVX2 : ENVELOPE_SCALAR;
+    if (implementation == ENVELOPE_AVX2 && !hasAvx2()) return -1;
+
+    implementation_ = implementation;
+    return 0;
+}
+
+
+void EnvelopeDetector::process(const uint16_t* raw, uint16_t* envelope) {
+
+    for (int p = 0; p < probes_; p++) processLine(raw + (size_t)p * samples_, envelope + (size_t)p * samples_);
+}
+
+
+void EnvelopeDetector::processLine(const uint16_t* raw, uint16_t* envelope) {
+
+    loadLine(raw);
+    if (implementation_ == ENVELOPE_AVX2) processAvx2(envelope);
+    else processScalar(envelope, 0);
+}
+
+
+bool EnvelopeDetector::hasAvx2() {
+#if !defined(ENVELOPE_HAVE_AVX2)
+    return false;
+#elif defined(_MSC_VER)
+    // FMA, OSXSAVE and AVX in leaf 1, the OS saves the ymm registers, AVX2 in leaf 7
+    int info[4];
+    __cpuid(info, 1);
+    if ((info[2] & (1 << 12)) == 0 || (info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0) return false;
+    if ((_xgetbv(0) & 6) != 6) return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+}
+
+
+double EnvelopeDetector::toDecibel(double value) {
+    return value / 65535.0 * range_ - range_;
+}
+
+
+int EnvelopeDetector::getImplementation() {
+    return implementation_;
+}
+
+
+int EnvelopeDetector::getSamples() {
+    return samples_;
+}
+
+
+int EnvelopeDetector::getProbes() {
+    return probes_;
+}
+
+
+int EnvelopeDetector::getTaps() {
+    return taps_;
+}
+
+
+void EnvelopeDetector::loadLine(const uint16_t* raw) {
+
+    // the zeros before and after stay, only the middle changes. the offset of the ADC doesn't matter, the band-pass removes it
+    float* line = line_.data() + taps_ / 2;
+    for (int s = 0; s < samples_; s++) line[s] = (float)raw[s];
+}
+
+
+void EnvelopeDetector::processScalar(uint16_t* envelope, int first) {
+
+    const float* line = line_.data();
+    const float* fi = filteri_.data();
+    const float* fq = filterq_.data();
+
+    for (int s = first; s < samples_; s++) {
+        float i = 0.0f;
+        float q = 0.0f;
+        for (int k = 0; k < taps_; k++) {
+            i += line[s + k] * fi[k];
+            q += line[s + k] * fq[k];
+        }
+
+        float power = i * i + q * q;
+        float value = scale_ * logf(power > ENVELOPE_MINPOWER ? power : ENVELOPE_MINPOWER) + offset_;
+        envelope[s] = (value <= 0.0f) ? 0 : ((value >= 65535.0f) ? 65535 : (uint16_t)(value + 0.5f));
+    }
+}
+
+
+#ifdef ENVELOPE_HAVE_AVX2
+
+/**
+ * @brief ln(x) of 8 floats, x > 0. x = m * 2^e with m in [sqrt(0.5), sqrt(2)), ln(m) = 2 atanh((m-1)/(m+1)) as a series,
+ * the error is below 1e-6, much less than one step of the compressed envelope.
+ */
+static inline ENVELOPE_AVX2_TARGET __m256 logAvx2(__m256 x) {
+
+    const __m256 one = _mm256_set1_ps(1.0f);
+    __m256i bits = _mm256_castps_si256(x);
+    __m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+    __m256 m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)), _mm256_set1_epi32(0x3f800000)));
+
+    __m256 big = _mm256_cmp_ps(m, _mm256_set1_ps(1.41421356f), _CMP_GT_OQ);
+    m = _mm256_blendv_ps(m, _mm256_mul_ps(m, _mm256_set1_ps(0.5f)), big);
+    e = _mm256_add_ps(e, _mm256_and_ps(big, one));
+
+    __m256 s = _mm256_div_ps(_mm256_sub_ps(m, one), _mm256_add_ps(m, one));
+    __m256 s2 = _mm256_mul_ps(s, s);
+    __m256 series = _mm256_fmadd_ps(s2, _mm256_set1_ps(1.0f / 9.0f), _mm256_set1_ps(1.0f / 7.0f));
+    series = _mm256_fmadd_ps(series, s2, _mm256_set1_ps(1.0f / 5.0f));
+    series = _mm256_fmadd_ps(series, s2, _mm256_set1_ps(1.0f / 3.0f));
+    series = _mm256_fmadd_ps(series, s2, one);
+
+    return _mm256_fmadd_ps(e, _mm256_set1_ps(0.69314718f), _mm256_mul_ps(_mm256_add_ps(s, s), series));
+}
+
+
+ENVELOPE_AVX2_TARGET void EnvelopeDetector::processAvx2(uint16_t* envelope) {
+
+    const float* line = line_.data();
+    const float* fi = filteri_.data();
+    const float* fq = filterq_.data();
+    const __m256 scale = _mm256_set1_ps(scale_);
+    const __m256 offset = _mm256_set1_ps(offset_);
+    const __m256 minpower = _mm256_set1_ps(ENVELOPE_MINPOWER);
+    const __m256 maxvalue = _mm256_set1_ps(65535.0f);
+
+    // 8 neighbouring samples at once. the in-phase filter is symmetric and the quadrature filter antisymmetric,
+    // so the two samples at the same distance before and after are added (and subtracted) first, half the fma
+    int half = taps_ / 2;
+    int s = 0;
+    for (; s + 8 <= samples_; s += 8) {
+        __m256 i = _mm256_mul_ps(_mm256_loadu_ps(line + s + half), _mm256_broadcast_ss(fi + half));
+        __m256 q = _mm256_setzero_ps();
+        for (int k = 0; k < half; k++) {
+            __m256 before = _mm256_loadu_ps(line + s + k);
+            __m256 after = _mm256_loadu_ps(line + s + taps_ - 1 - k);
+            i = _mm256_fmadd_ps(_mm256_add_ps(before, after), _mm256_broadcast_ss(fi + k), i);
+            q = _mm256_fmadd_ps(_mm256_sub_ps(before, after), _mm256_broadcast_ss(fq + k), q);
+        }
+
+        __m256 power = _mm256_max_ps(_mm256_fmadd_ps(i, i, _mm256_mul_ps(q, q)), minpower);
+        __m256 value = _mm256_fmadd_ps(scale, logAvx2(power), offset);
+        value = _mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()), maxvalue);
+
+        // 8 int32 into 8 uint16, packus works per 128 bit lane so pack the two halves
+        __m256i rounded = _mm256_cvtps_epi32(value);
+        __m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(rounded), _mm256_extracti128_si256(rounded, 1));
+        _mm_storeu_si128((__m128i*)(envelope + s), packed);
+    }
+
+    // the last few samples of the line
+    processScalar(envelope, s);
+}
+
+#else
+
+void EnvelopeDetector::processAvx2(uint16_t* envelope) {
+    processScalar(envelope, 0);
+}
+
+#endif
@@ -0,0 +1,48 @@
+#include "FrameClock.h"
+
+FrameClock::FrameClock() {
+    anchor();
+}
+
+
+void FrameClock::anchor() {
+
+    // the wall clock is read between two readings of the monotonic clock,
+    // so the pair is off by at most half of the time the three calls take
+    int64_t before = now();
+    int64_t wall = wallNow();
+    int64_t after = now();
+
+    monotonicorigin_ = before + (after - before) / 2;
+    wallorigin_ = wall;
+}
+
+
+int64_t FrameClock::fromWall(int64_t wall) {
+
+    int64_t difference = wallNow() - now();
+    int64_t anchored = wallorigin_ - monotonicorigin_;
+    if (difference - anchored > FRAMECLOCK_STEP || anchored - difference > FRAMECLOCK_STEP) anchor();
+
+    return wall - wallorigin_ + monotonicorigin_;
+}
+
+
+int64_t FrameClock::toWall(int64_t monotonic) {
+    return monotonic - monotonicorigin_ + wallorigin_;
+}
+
+
+double FrameClock::toWallSeconds(int64_t monotonic) {
+    return toWall(monotonic) * 1e-9;
+}
+
+
+int64_t FrameClock::getMonotonicOrigin() {
+    return monotonicorigin_;
+}
+
+
+int64_t FrameClock::getWallOrigin() {
+    return wallorigin_;
+}
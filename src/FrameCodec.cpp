@@ -0,0 +1,239 @@
+#include "FrameCodec.h"
+#include "FrameLayout.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+FrameCodec::FrameCodec(int samples, int probes) {
+    samples_ = samples;
+    probes_ = probes;
+    blocks_ = (samples_ + CODEC_BLOCK - 1) / CODEC_BLOCK;
+
+    // the padding at the end of the last block stays zero
+    residual_.assign((size_t)blocks_ * CODEC_BLOCK, 0);
+    residualframe_.assign((size_t)blocks_ * CODEC_BLOCK, 0);
+}
+
+
+size_t FrameCodec::getMaxEncodedSize() {
+    // a block is never wider than 17 bits (the difference of two uint16_t and the sign)
+    return 1 + (size_t)probes_ * (1 + sizeof(uint16_t) + (size_t)blocks_ * (1 + 17 * sizeof(uint32_t)));
+}
+
+
+bool FrameCodec::isKeyframe(const char* input) {
+    return (input[0] & CODEC_FLAG_KEYFRAME) != 0;
+}
+
+
+bool FrameCodec::setFixedLayout(bool flag) {
+    fixedlayout_ = flag;
+    return samples_ == RawLayout::samples() && probes_ == RawLayout::probes();
+}
+
+
+size_t FrameCodec::encode(const uint16_t* values, const uint16_t* previous, char* output) {
+    return withRawLayout(samples_, probes_, fixedlayout_, [&](const auto& layout) { return encodeLayout(layout, values, previous, output); });
+}
+
+
+int FrameCodec::decode(const char* input, size_t inputsize, const uint16_t* previous, uint16_t* values) {
+    return withRawLayout(samples_, probes_, fixedlayout_, [&](const auto& layout) { return decodeLayout(layout, input, inputsize, previous, values); });
+}
+
+
+// the same code for every layout, with RawLayout every samples/probes/blocks below is a constant
+template <class Layout>
+size_t FrameCodec::encodeLayout(const Layout& layout, const uint16_t* values, const uint16_t* previous, char* output) {
+
+    const int samples = layout.samples();
+    const int probes = layout.probes();
+    const int blocks = (samples + CODEC_BLOCK - 1) / CODEC_BLOCK;
+
+    char* out = output;
+    *out++ = (previous == nullptr) ? CODEC_FLAG_KEYFRAME : 0;
+
+    for (int p = 0; p < probes; p++) {
+        const uint16_t* line = values + (size_t)p * samples;
+        const uint16_t* previousline = (previous != nullptr) ? previous + (size_t)p * samples : nullptr;
+
+        // both predictions in one pass, then take the one with the smaller residuals
+        // (the sum of the zigzag values is close enough to the number of bits), zigzag: -1 -> 1, 1 -> 2, -2 -> 3, ...
+        uint32_t* residualsample = residual_.data();
+        uint32_t* residualframe = residualframe_.data();
+        uint64_t sumsample = 0;
+        uint64_t sumframe = 0;
+
+        residualsample[0] = 0;
+        for (int i = 1; i < samples; i++) {
+            int32_t d = (int32_t)line[i] - (int32_t)line[i - 1];
+            residualsample[i] = ((uint32_t)d << 1) ^ (uint32_t)(d >> 31);
+            sumsample += residualsample[i];
+        }
+
+        int predictor = CODEC_PREDICT_SAMPLE;
+        if (previousline != nullptr) {
+            for (int i = 0; i < samples; i++) {
+                int32_t d = (int32_t)line[i] - (int32_t)previousline[i];
+                residualframe[i] = ((uint32_t)d << 1) ^ (uint32_t)(d >> 31);
+                sumframe += residualframe[i];
+            }
+            if (sumframe < sumsample) predictor = CODEC_PREDICT_FRAME;
+        }
+        *out++ = (char)predictor;
+
+        // the first sample has nothing before it, it is stored as it is so it doesn't widen the first block
+        const uint32_t* residual = residualframe;
+        if (predictor == CODEC_PREDICT_SAMPLE) {
+            memcpy(out, &line[0], sizeof(uint16_t));
+            out += sizeof(uint16_t);
+            residual = residualsample;
+        }
+
+        for (int b = 0; b < blocks; b++) {
+            const uint32_t* block = residual + (size_t)b * CODEC_BLOCK;
+
+            uint32_t all = 0;
+            for (int i = 0; i < CODEC_BLOCK; i++) all |= block[i];
+            int width = 0;
+            while (width < 32 && (all >> width) != 0) width++;
+
+            *out++ = (char)width;
+            out = packBlock(block, width, out);
+        }
+    }
+
+    size_t size = out - output;
+    if (size >= (size_t)samples * probes * sizeof(uint16_t)) return 0;
+    return size;
+}
+
+
+template <class Layout>
+int FrameCodec::decodeLayout(const Layout& layout, const char* input, size_t inputsize, const uint16_t* previous, uint16_t* values) {
+
+    const int samples = layout.samples();
+    const int probes = layout.probes();
+    const int blocks = (samples + CODEC_BLOCK - 1) / CODEC_BLOCK;
+
+    const char* in = input;
+    const char* end = input + inputsize;
+
+    if (in >= end) return -1;
+    bool keyframe = (*in++ & CODEC_FLAG_KEYFRAME) != 0;
+    if (!keyframe && previous == nullptr) return -1;
+
+    for (int p = 0; p < probes; p++) {
+        uint16_t* line = values + (size_t)p * samples;
+
+        if (in >= end) return -1;
+        int predictor = *in++;
+        if (predictor == CODEC_PREDICT_FRAME && keyframe) return -1;
+
+        uint16_t first = 0;
+        if (predictor == CODEC_PREDICT_SAMPLE) {
+            if (in + sizeof(uint16_t) > end) return -1;
+            memcpy(&first, in, sizeof(uint16_t));
+            in += sizeof(uint16_t);
+        }
+
+        for (int b = 0; b < blocks; b++) {
+            if (in >= end) return -1;
+            int width = (unsigned char)*in++;
+            if (width > 17 || in + width * sizeof(uint32_t) > end) return -1;
+            in = unpackBlock(in, width, residual_.data() + (size_t)b * CODEC_BLOCK);
+        }
+
+        if (predictor == CODEC_PREDICT_SAMPLE) {
+            int before = first;
+            for (int i = 0; i < samples; i++) {
+                int32_t d = (int32_t)(residual_[i] >> 1) ^ -(int32_t)(residual_[i] & 1);
+                before = (uint16_t)(before + d);
+                line[i] = (uint16_t)before;
+            }
+        }
+        else {
+            const uint16_t* previousline = previous + (size_t)p * samples;
+            for (int i = 0; i < samples; i++) {
+                int32_t d = (int32_t)(residual_[i] >> 1) ^ -(int32_t)(residual_[i] & 1);
+                line[i] = (uint16_t)(previousline[i] + d);
+            }
+        }
+    }
+
+    return 0;
+}
+
+
+#if defined(__GNUC__) && !defined(__clang__)
+#define CODEC_UNROLL _Pragma("GCC unroll 32")
+#elif defined(__clang__)
+#define CODEC_UNROLL _Pragma("unroll")
+#else
+#define CODEC_UNROLL
+#endif
+
+// with the width known at compile time every shift is a constant, the compiler unrolls the block
+// and uses vector instructions for it, one function per width is picked with a table
+template <int WIDTH>
+static char* packWidth(const uint32_t* residual, char* output) {
+
+    uint32_t words[WIDTH] = {};
+    CODEC_UNROLL
+    for (int i = 0; i < CODEC_BLOCK; i++) {
+        int bit = i * WIDTH;
+        words[bit / 32] |= residual[i] << (bit % 32);
+        if (bit % 32 + WIDTH > 32) words[bit / 32 + 1] |= residual[i] >> (32 - bit % 32);
+    }
+    memcpy(output, words, sizeof(words));
+    return output + sizeof(words);
+}
+
+
+template <int WIDTH>
+static const char* unpackWidth(const char* input, uint32_t* residual) {
+
+    uint32_t words[WIDTH];
+    memcpy(words, input, sizeof(words));
+    const uint32_t mask = (uint32_t)((1ull << WIDTH) - 1);
+    CODEC_UNROLL
+    for (int i = 0; i < CODEC_BLOCK; i++) {
+        int bit = i * WIDTH;
+        uint32_t value = words[bit / 32] >> (bit % 32);
+        if (bit % 32 + WIDTH > 32) value |= words[bit / 32 + 1] << (32 - bit % 32);
+        residual[i] = value & mask;
+    }
+    return input + sizeof(words);
+}
+
+
+typedef char* (*PackFunction)(const uint32_t*, char*);
+typedef const char* (*UnpackFunction)(const char*, uint32_t*);
+
+static const PackFunction packfunctions[] = {
+    nullptr, packWidth<1>, packWidth<2>, packWidth<3>, packWidth<4>, packWidth<5>, packWidth<6>, packWidth<7>, packWidth<8>,
+    packWidth<9>, packWidth<10>, packWidth<11>, packWidth<12>, packWidth<13>, packWidth<14>, packWidth<15>, packWidth<16>, packWidth<17>
+};
+
+static const UnpackFunction unpackfunctions[] = {
+    nullptr, unpackWidth<1>, unpackWidth<2>, unpackWidth<3>, unpackWidth<4>, unpackWidth<5>, unpackWidth<6>, unpackWidth<7>, unpackWidth<8>,
+    unpackWidth<9>, unpackWidth<10>, unpackWidth<11>, unpackWidth<12>, unpackWidth<13>, unpackWidth<14>, unpackWidth<15>, unpackWidth<16>, unpackWidth<17>
+};
+
+
+char* FrameCodec::packBlock(const uint32_t* residual, int width, char* output) {
+
+    // CODEC_BLOCK values of width bits are exactly width words, nothing at all for width 0
+    if (width == 0) return output;
+    return packfunctions[width](residual, output);
+}
+
+
+const char* FrameCodec::unpackBlock(const char* input, int width, uint32_t* residual) {
+
+    if (width == 0) {
+        memset(residual, 0, CODEC_BLOCK * sizeof(uint32_t));
+        return input;
+    }
+    return unpackfunctions[width](input, residual);
+}
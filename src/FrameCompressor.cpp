@@ -0,0 +1,103 @@
+#include "FrameCompressor.h"
+
+#include <chrono>
+
+FrameCompressor::FrameCompressor(int samples, int probes, int threads, int keyinterval) : pool_(threads) {
+    samples_ = samples;
+    probes_ = probes;
+    keyinterval_ = (keyinterval > 0) ? keyinterval : 1;
+    framesize_ = (size_t)samples_ * probes_ * sizeof(uint16_t);
+
+    for (int t = 0; t < pool_.getThreadCount(); t++) codecs_.emplace_back(new FrameCodec(samples_, probes_));
+}
+
+
+void FrameCompressor::compress(const std::vector<FrameRef>& batch, size_t count) {
+
+    if (count == 0) return;
+
+    // run() is over, no thread looks at the outputs of the last batch any more
+    if (encoded_.size() < count) {
+        encoded_.resize(count);
+        encodedsize_.resize(count);
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (encoded_[i].size() < codecs_[0]->getMaxEncodedSize()) encoded_[i].resize(codecs_[0]->getMaxEncodedSize());
+    }
+
+    batch_ = &batch;
+    pool_.run(count, [this](size_t i, int thread) { encodeFrame(i, *codecs_[thread]); });
+
+    for (size_t i = 0; i < count; i++) {
+        countrawbyte_ += batch[i]->datasize;
+        countstoredbyte_ += getPayloadSize(i);
+    }
+    countframe_ += count;
+    batchfirst_ += count;
+
+    // the first frame of the next batch is predicted from this one, it stays in the pool until then
+    previous_ = batch[count - 1];
+}
+
+
+void FrameCompressor::finish() {
+    previous_.reset();
+}
+
+
+void FrameCompressor::encodeFrame(size_t i, FrameCodec& codec) {
+
+    const std::vector<FrameRef>& batch = *batch_;
+    const FrameRef& frame = batch[i];
+    if ((size_t)frame->datasize != framesize_) {
+        encodedsize_[i] = 0;
+        return;
+    }
+
+    // a keyframe every keyinterval_ frames, the others are predicted from the frame before them
+    const uint16_t* previous = nullptr;
+    if ((batchfirst_ + i) % keyinterval_ != 0) {
+        const FrameRef& before = (i == 0) ? previous_ : batch[i - 1];
+        if (!before.empty() && (size_t)before->datasize == framesize_) previous = (const uint16_t*)before->data;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    encodedsize_[i] = (uint32_t)codec.encode((const uint16_t*)frame->data, previous, encoded_[i].data());
+    std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+
+    countnanosecond_ += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
+}
+
+
+const char* FrameCompressor::getPayload(size_t i) {
+    if (encodedsize_[i] == 0) return (*batch_)[i]->data;
+    return encoded_[i].data();
+}
+
+
+uint32_t FrameCompressor::getPayloadSize(size_t i) {
+    if (encodedsize_[i] == 0) return (uint32_t)(*batch_)[i]->datasize;
+    return encodedsize_[i];
+}
+
+
+uint32_t FrameCompressor::getCodec(size_t i) {
+    return (encodedsize_[i] == 0) ? RECORDING_CODEC_NONE : RECORDING_CODEC_PACK16;
+}
+
+
+double FrameCompressor::getCompressionRatio() {
+    if (countstoredbyte_ == 0) return 1.0;
+    return (double)countrawbyte_ / countstoredbyte_;
+}
+
+
+double FrameCompressor::getEncodeTime() {
+    if (countframe_ == 0) return 0.0;
+    return countnanosecond_ / 1e3 / countframe_;
+}
+
+
+uint64_t FrameCompressor::getFrameCount() {
+    return countframe_;
+}
@@ -0,0 +1,126 @@
+#include "FrameDecoder.h"
+
+#include <string.h>
+
+FrameDecoder::FrameDecoder(int headersize, int indexsize, int datasize) {
+    headersize_ = headersize;
+    indexsize_ = indexsize;
+    datasize_ = datasize;
+    framesize_ = headersize_ + indexsize_ + datasize_;
+    synclength_ = (headersize_ < (int)sizeof(syncword_)) ? headersize_ : (int)sizeof(syncword_);
+
+    // allocated once, every packet is assembled in the same memory (unless the caller gives its own)
+    ownbuffer_.resize(framesize_);
+    buffer_ = ownbuffer_.data();
+}
+
+
+char* FrameDecoder::writePointer() {
+    return buffer_ + filled_;
+}
+
+
+int FrameDecoder::writeSize() {
+    return framesize_ - filled_;
+}
+
+
+void FrameDecoder::setBuffer(char* buffer) {
+
+    if (buffer == nullptr) buffer = ownbuffer_.data();
+    if (buffer == buffer_) return;
+
+    if (filled_ > 0) memcpy(buffer, buffer_, filled_);
+    buffer_ = buffer;
+}
+
+
+const char* FrameDecoder::frame() {
+    return buffer_;
+}
+
+
+int FrameDecoder::frameSize() {
+    return framesize_;
+}
+
+
+void FrameDecoder::reset() {
+    filled_ = 0;
+    synclocked_ = false;
+    resyncing_ = false;
+}
+
+
+void FrameDecoder::setSyncCheck(bool flag) {
+    synccheck_ = flag;
+}
+
+
+long FrameDecoder::getFrameCount() {
+    return countframe_;
+}
+
+
+long FrameDecoder::getResyncCount() {
+    return countresync_;
+}
+
+
+long FrameDecoder::getSkippedBytes() {
+    return countskipped_;
+}
+
+
+bool FrameDecoder::commit(int bytes) {
+
+    int before = filled_;
+    filled_ += bytes;
+
+    // the header is complete with these bytes, check it before we receive the data behind it
+    // (checkHeader() may shift the buffer, the bytes after the header can be part of a real header then)
+    while (synccheck_ && before < synclength_ && filled_ >= synclength_) {
+        if (checkHeader()) break;
+        before = 0;
+    }
+
+    if (filled_ < framesize_) return false;
+
+    // the next recv() starts the next packet at the beginning of the buffer
+    filled_ = 0;
+    countframe_++;
+    return true;
+}
+
+
+bool FrameDecoder::checkHeader() {
+
+    // the first header we see is the one we expect from now on
+    if (!synclocked_) {
+        memcpy(syncword_, buffer_, synclength_);
+        synclocked_ = true;
+        return true;
+    }
+
+    if (memcmp(syncword_, buffer_, synclength_) == 0) {
+        resyncing_ = false;
+        return true;
+    }
+
+    // misaligned, find the first position where the sync word could begin in what we have
+    // e.g. for 4 bytes header [x s0 s1 s2] shifts 1 byte, [x x x x] shifts everything
+    int shift = 1;
+    for (; shift < filled_; shift++) {
+        int length = (filled_ - shift < synclength_) ? filled_ - shift : synclength_;
+        if (memcmp(syncword_, buffer_ + shift, length) == 0) break;
+    }
+
+    // count one resync per misalignment, not per skipped byte
+    if (!resyncing_) countresync_++;
+    resyncing_ = true;
+    countskipped_ += shift;
+
+    memmove(buffer_, buffer_ + shift, filled_ - shift);
+    filled_ -= shift;
+    return false;
+}
@@ -0,0 +1,60 @@
+#include "FrameHistory.h"
+
+FrameHistory::FrameHistory(size_t capacity) : ring_((capacity > 0) ? capacity : 1) {}
+
+
+bool FrameHistory::push(const FrameRef& frame) {
+
+    // the assignment releases the reference to the oldest frame, the slot goes back to the pool
+    size_t last = (first_ + count_) % ring_.size();
+    ring_[last] = frame;
+    if (count_ < ring_.size()) {
+        count_++;
+        return true;
+    }
+    first_ = (first_ + 1) % ring_.size();
+    countoverwritten_++;
+    return false;
+}
+
+
+FrameRef FrameHistory::pop() {
+
+    if (count_ == 0) return FrameRef();
+    FrameRef frame = std::move(ring_[first_]);
+    first_ = (first_ + 1) % ring_.size();
+    count_--;
+    return frame;
+}
+
+
+size_t FrameHistory::dropBefore(int64_t timestamp) {
+
+    // the frames are in the order they arrived, so the old ones are all at the front
+    size_t dropped = 0;
+    while (count_ > 0 && ring_[first_]->timestamp < timestamp) {
+        pop();
+        dropped++;
+    }
+    return dropped;
+}
+
+
+void FrameHistory::clear() {
+    while (count_ > 0) pop();
+}
+
+
+size_t FrameHistory::size() {
+    return count_;
+}
+
+
+size_t FrameHistory::getCapacity() {
+    return ring_.size();
+}
+
+
+long FrameHistory::getOverwriteCount() {
+    return countoverwritten_;
+}
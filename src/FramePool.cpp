@@ -0,0 +1,56 @@
+#include "FramePool.h"
+
+FramePool::FramePool(size_t slots, int headersize, int indexsize, int datasize)
+    : slots_(slots > 0 ? slots : 1) {
+
+    int packetsize = headersize + indexsize + datasize;
+
+    for (FrameSlot& slot : slots_) {
+        slot.storage.resize(packetsize + FRAMEPOOL_ALIGNMENT);
+
+        // move the packet so the values behind header and index are aligned
+        uintptr_t values = (uintptr_t)slot.storage.data() + headersize + indexsize;
+        uintptr_t aligned = (values + FRAMEPOOL_ALIGNMENT - 1) & ~(uintptr_t)(FRAMEPOOL_ALIGNMENT - 1);
+
+        slot.packet = slot.storage.data() + (aligned - values);
+        slot.packetsize = packetsize;
+        slot.data = slot.packet + headersize + indexsize;
+        slot.datasize = datasize;
+    }
+}
+
+
+FrameRef FramePool::acquire() {
+
+    // always the first free slot, when the consumers keep up only the first few slots are used
+    // and they stay in the cache, going round through all of them would receive every packet into cold memory
+    for (FrameSlot& slot : slots_) {
+        int expected = 0;
+        if (slot.refcount.load(std::memory_order_relaxed) == 0
+            && slot.refcount.compare_exchange_strong(expected, 1, std::memory_order_acquire)) {
+            return FrameRef(&slot);
+        }
+    }
+
+    countempty_++;
+    return FrameRef();
+}
+
+
+size_t FramePool::getSlotCount() {
+    return slots_.size();
+}
+
+
+size_t FramePool::getFreeCount() {
+    size_t count = 0;
+    for (FrameSlot& slot : slots_) {
+        if (slot.refcount.load(std::memory_order_relaxed) == 0) count++;
+    }
+    return count;
+}
+
+
+long FramePool::getEmptyCount() {
+    return countempty_;
+}
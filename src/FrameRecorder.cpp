@@ -0,0 +1,374 @@
+#include "FrameRecorder.h"
+
+#include <math.h>
+#include <chrono>
+#include <boost/filesystem.hpp>
+
+#include "getTime.h"
+
+FrameRecorder::FrameRecorder(int datamode, int samples, int probes, size_t queuecapacity, int queuepolicy)
+    : queue_(queuecapacity, queuepolicy) {
+    datamode_ = datamode;
+    samples_ = samples;
+    probes_ = probes;
+    recordformat_ = (datamode_ == DATA_RAW) ? RECORD_BINARY : RECORD_COLUMNS;
+}
+
+
+FrameRecorder::~FrameRecorder() {
+    stop();
+}
+
+
+#ifdef AMODE_ENABLE_STATS
+void FrameRecorder::setStats(PipelineStats* stats) {
+    stats_ = stats;
+}
+#endif
+
+
+void FrameRecorder::useDataIndex(bool flag) {
+    usedataindex_ = flag;
+}
+
+
+void FrameRecorder::setFormat(int format) {
+    recordformat_ = format;
+}
+
+
+void FrameRecorder::setCompression(int threads, int keyinterval) {
+    compressthreads_ = threads;
+    keyinterval_ = keyinterval;
+}
+
+
+void FrameRecorder::setTiffThreads(int threads) {
+    tiffthreads_ = threads;
+}
+
+
+void FrameRecorder::setBackend(int backend, bool direct) {
+    writer_.setBackend(backend, direct);
+}
+
+
+void FrameRecorder::setThread(int core, int priority) {
+    threadcore_ = core;
+    threadpriority_ = priority;
+}
+
+
+void FrameRecorder::setPath(std::string directory, std::string name) {
+    recorddirectory_ = directory;
+    recordname_ = name;
+}
+
+
+void FrameRecorder::setMetadata(std::string key, std::string value) {
+    std::lock_guard<std::mutex> lock(metadatamutex_);
+    for (auto& entry : metadata_) {
+        if (entry.first == key) {
+            entry.second = value;
+            return;
+        }
+    }
+    metadata_.push_back(std::make_pair(key, value));
+}
+
+
+void FrameRecorder::applyMetadata() {
+    std::lock_guard<std::mutex> lock(metadatamutex_);
+    for (auto& entry : metadata_) {
+        writer_.setMetadata(entry.first, entry.second);
+        depthlog_.setMetadata(entry.first, entry.second);
+    }
+}
+
+
+int FrameRecorder::start() {
+
+    if ((recordformat_ == RECORD_TIFF && datamode_ != DATA_RAW)
+        || ((recordformat_ == RECORD_CSV || recordformat_ == RECORD_COLUMNS) && datamode_ != DATA_DEPTH)) {
+        printf("A-mode recorder: .tiff is only for DATA_RAW, .csv and .amodedepth only for DATA_DEPTH\n");
+        return -1;
+    }
+
+    // the .tiff names and the .csv have the wall time, converted with the same anchor for the whole session
+    clock_.anchor();
+    starttime_ = rtb::getTime();
+
+    if (recordformat_ == RECORD_CSV) {
+        std::string fullpath = (boost::filesystem::path(recorddirectory_) / (recordname_ + ".csv")).string();
+        if (csv_.open(fullpath) != 0) {
+            printf("Unable to open %s for A-mode Ultrasound logging\n", fullpath.c_str());
+            return -1;
+        }
+    }
+
+    else if (recordformat_ == RECORD_TIFF) {
+        // the files are named with the wall clock of the anchor, like the ones written by writeFrame()
+        tiff_.reset();
+        if (tiffthreads_ > 0 && datamode_ == DATA_RAW) {
+            tiff_.reset(new TiffWriter(samples_, probes_, tiffthreads_));
+            tiff_->setPath(recorddirectory_, usedataindex_, clock_);
+            batch_.resize(4 * tiffthreads_);
+        }
+    }
+
+    else if (recordformat_ == RECORD_COLUMNS) {
+        // like the .amode, the monotonic timestamps and the anchor in the header
+        if (depthlog_.open(recorddirectory_, recordname_, probes_, samples_,
+            RECORDING_CLOCK_MONOTONIC, clock_.getMonotonicOrigin(), clock_.getWallOrigin()) != 0) return -1;
+    }
+
+    else if (recordformat_ == RECORD_BINARY) {
+        int valuesize = (datamode_ == DATA_RAW) ? sizeof(uint16_t) : sizeof(double);
+
+        writer_.setMetadata("datamode", (datamode_ == DATA_RAW) ? "DATA_RAW" : "DATA_DEPTH");
+        writer_.setMetadata("samples", std::to_string(samples_));
+        writer_.setMetadata("probes", std::to_string(probes_));
+        writer_.setMetadata("start", std::to_string(starttime_));
+
+        // the frames can only be compressed in the binary format, the others are read by other programs
+        compressor_.reset();
+        if (compressthreads_ > 0 && datamode_ == DATA_RAW) {
+            compressor_.reset(new FrameCompressor(samples_, probes_, compressthreads_, keyinterval_));
+            batch_.resize(4 * compressthreads_);
+            writer_.setMetadata("codec", "PACK16");
+            writer_.setMetadata("keyinterval", std::to_string(keyinterval_));
+        }
+        applyMetadata();
+
+        // the records keep the monotonic timestamps, the header has the anchor to get the wall time
+        if (writer_.open(recorddirectory_, recordname_, datamode_, samples_, probes_, valuesize,
+            RECORDING_CLOCK_MONOTONIC, clock_.getMonotonicOrigin(), clock_.getWallOrigin()) != 0) return -1;
+    }
+
+    stop_ = false;
+    thread_ = std::thread(&FrameRecorder::writeLoop, this);
+    return 0;
+}
+
+
+bool FrameRecorder::push(const FrameRef& frame) {
+#ifdef AMODE_ENABLE_STATS
+    // the slot still belongs to this thread until it is in the queue
+    if (stats_ != nullptr) frame->pushtime = statsNow();
+#endif
+    return queue_.push(frame);
+}
+
+
+void FrameRecorder::stop() {
+
+    if (!thread_.joinable()) return;
+
+    // a socket thread blocked in push() should not wait for a writer which is about to finish
+    stop_ = true;
+    queue_.close();
+    thread_.join();
+
+    if (compressor_) {
+        compressor_->finish();
+        writer_.setMetadata("compressionratio", std::to_string(compressor_->getCompressionRatio()));
+        writer_.setMetadata("encodetime", std::to_string(compressor_->getEncodeTime()));
+    }
+    if (tiff_ && tiff_->getFailCount() > 0) printf("A-Mode recorder: %ld .tiff files could not be written\n", tiff_->getFailCount());
+
+    // the counts are only known now, they go to the footer of the .amode and the trailer of the .amodedepth
+    writer_.setMetadata("written", std::to_string(countwrite_));
+    writer_.setMetadata("dropped", std::to_string(queue_.getDropCount()));
+    depthlog_.setMetadata("written", std::to_string(countwrite_));
+    depthlog_.setMetadata("dropped", std::to_string(queue_.getDropCount()));
+    applyMetadata();
+
+    // close the files, the last block of the depth log and its trailer are written here
+    if (csv_.close() != 0) printf("A-Mode recorder: the .csv could not be written completely\n");
+    depthlog_.close();
+    writer_.close();
+    if (recordformat_ == RECORD_TIFF || recordformat_ == RECORD_CSV) writeSidecar();
+}
+
+
+int FrameRecorder::writeSidecar() {
+
+    std::string metadata;
+    metadata += std::string("datamode=") + ((datamode_ == DATA_RAW) ? "DATA_RAW" : "DATA_DEPTH") + "\n";
+    metadata += "samples=" + std::to_string(samples_) + "\n";
+    metadata += "probes=" + std::to_string(probes_) + "\n";
+    metadata += "start=" + std::to_string(starttime_) + "\n";
+    metadata += "written=" + std::to_string(countwrite_) + "\n";
+    metadata += "dropped=" + std::to_string(queue_.getDropCount()) + "\n";
+    if (tiff_) metadata += "failed=" + std::to_string(tiff_->getFailCount()) + "\n";
+    {
+        std::lock_guard<std::mutex> lock(metadatamutex_);
+        for (auto& entry : metadata_) metadata += entry.first + "=" + entry.second + "\n";
+    }
+
+    std::string fullpath = (boost::filesystem::path(recorddirectory_) / (recordname_ + ".meta")).string();
+    FILE* file = fopen(fullpath.c_str(), "wb");
+    if (file == nullptr || fwrite(metadata.data(), 1, metadata.size(), file) != metadata.size()) {
+        printf("Unable to write the A-mode Ultrasound metadata to %s\n", fullpath.c_str());
+        if (file != nullptr) fclose(file);
+        return -1;
+    }
+    if (fclose(file) != 0) {
+        printf("Unable to write the A-mode Ultrasound metadata to %s\n", fullpath.c_str());
+        return -1;
+    }
+    return 0;
+}
+
+
+size_t FrameRecorder::getQueueDepth() {
+    return queue_.size();
+}
+
+
+size_t FrameRecorder::getMaxQueueDepth() {
+    return queue_.getMaxDepth();
+}
+
+
+long FrameRecorder::getDropCount() {
+    return queue_.getDropCount();
+}
+
+
+long FrameRecorder::getWriteCount() {
+    return countwrite_;
+}
+
+
+double FrameRecorder::getCompressionRatio() {
+    if (!compressor_) return 1.0;
+    return compressor_->getCompressionRatio();
+}
+
+
+double FrameRecorder::getEncodeTime() {
+    if (!compressor_) return 0.0;
+    return compressor_->getEncodeTime();
+}
+
+
+void FrameRecorder::writeLoop() {
+
+    // the disk is slow anyway, but the writer shouldn't take the core of the receiving thread
+    if (threadcore_ >= 0 && pinThread(threadcore_) != 0) printf("A-Mode recorder: unable to pin the writer thread to core %d\n", threadcore_);
+    if (threadpriority_ > 0 && setRealtimePriority(threadpriority_) != 0) printf("A-Mode recorder: unable to run the writer thread with SCHED_FIFO %d\n", threadpriority_);
+
+    while (true) {
+
+        size_t written = 0;
+        if (compressor_ || tiff_) {
+            written = writeBatch();
+        }
+        // current_ is empty when it goes into the queue in exchange, the slot goes back to the pool when it is written
+        else if (queue_.pop(current_)) {
+#ifdef AMODE_ENABLE_STATS
+            int64_t start = (stats_ != nullptr) ? statsNow() : 0;
+            if (stats_ != nullptr) stats_->record(STATS_QUEUEWAIT, start - current_->pushtime);
+#endif
+            writeFrame(current_);
+#ifdef AMODE_ENABLE_STATS
+            if (stats_ != nullptr) stats_->record(STATS_WRITE, statsNow() - start);
+#endif
+            current_.reset();
+            countwrite_++;
+            written = 1;
+        }
+
+        if (written == 0) {
+            // only finish when everything which was pushed before stop() is written
+            if (stop_) break;
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+}
+
+
+size_t FrameRecorder::writeBatch() {
+
+    // don't wait until the batch is full, take only what is there so the latency stays low
+    size_t count = 0;
+    while (count < batch_.size() && queue_.pop(batch_[count])) count++;
+    if (count == 0) return 0;
+
+#ifdef AMODE_ENABLE_STATS
+    int64_t start = (stats_ != nullptr) ? statsNow() : 0;
+    if (stats_ != nullptr) {
+        for (size_t i = 0; i < count; i++) stats_->record(STATS_QUEUEWAIT, start - batch_[i]->pushtime);
+    }
+#endif
+
+    if (tiff_) {
+        // every frame is its own file, the threads write them in any order
+        tiff_->write(batch_, count);
+    }
+    else {
+        compressor_->compress(batch_, count);
+
+        // in the order they came, the frames are predicted from the one before
+        for (size_t i = 0; i < count; i++) {
+            writer_.write(batch_[i]->timestamp, batch_[i]->index, compressor_->getPayload(i), compressor_->getPayloadSize(i), compressor_->getCodec(i));
+        }
+    }
+#ifdef AMODE_ENABLE_STATS
+    // the frames are encoded together, every frame gets the same share
+    if (stats_ != nullptr) {
+        int64_t share = (statsNow() - start) / (int64_t)count;
+        for (size_t i = 0; i < count; i++) stats_->record(STATS_WRITE, share);
+    }
+#endif
+    for (size_t i = 0; i < count; i++) batch_[i].reset();
+    countwrite_ += (long)count;
+    return count;
+}
+
+
+void FrameRecorder::writeFrame(const FrameRef& frame) {
+
+    if (recordformat_ == RECORD_BINARY) {
+
+        // appended to the buffer of the writer, the disk only sees big sequential writes
+        writer_.write(frame->timestamp, frame->index, frame->data, (uint32_t)frame->datasize);
+    }
+
+    else if (recordformat_ == RECORD_TIFF) {
+
+        // creating a string for the name of the file
+        // if using data index, the filename structured as <timestamp>_<index>.tiff, if not, only <timestamp>.tiff
+        std::string filename = std::to_string(clock_.toWallSeconds(frame->timestamp));
+        if (usedataindex_) filename += "_" + std::to_string((int16_t)frame->index);
+        boost::filesystem::path filepath = boost::filesystem::path(recorddirectory_) / (filename + ".tiff");
+
+        // In a moment, i use opencv to transform our long array to matrix then save it as a .tiff image.
+        // I tried to save it to .csv but somehow it perform very slowly,
+        // i think there is an interference with some functions somewhere, but idk.
+        // This one is working well so i will stick to this.
+        // The matrix is only a header on top of the frame, one row for each probe.
+        cv::Mat amodeimage(probes_, samples_, CV_16UC1, (void*)frame->data);
+        cv::imwrite(filepath.string(), amodeimage);
+    }
+
+    else if (recordformat_ == RECORD_CSV) {
+
+        const double* depth = (const double*)frame->data;
+        size_t depthlength = frame->datasize / sizeof(double);
+
+        // first column is timestamp, then the index if the user wants it
+        // the text goes into the buffer of the formatter, the disk only sees it when the buffer is full
+        csv_.addTime(clock_.toWall(frame->timestamp));
+        if (usedataindex_) csv_.addInteger(frame->index);
+        for (size_t i = 0; i < depthlength; i++) csv_.addDouble(depth[i]);
+        csv_.endLine();
+    }
+
+    else if (recordformat_ == RECORD_COLUMNS) {
+
+        // scattered into the columns of the block, written when the block is full
+        depthlog_.write(frame->timestamp, frame->index, (const double*)frame->data);
+    }
+}
@@ -0,0 +1,173 @@
+#define _USE_MATH_DEFINES
+#include "FrameReducer.h"
+
+#include <math.h>
+#include <string.h>
+
+FrameReducer::FrameReducer(int samples, int probes)
+    : samples_(samples), probes_(probes), length_(samples) {
+
+    for (int p = 0; p < probes_; p++) keep_.push_back(p);
+    first_.assign(probes_, 0);
+    designFilter();
+}
+
+
+int FrameReducer::setProbes(const std::vector<int>& probes) {
+
+    for (int p : probes) {
+        if (p < 0 || p >= probes_) return -1;
+    }
+
+    keep_ = probes;
+    if (keep_.empty()) {
+        for (int p = 0; p < probes_; p++) keep_.push_back(p);
+    }
+    first_.assign(keep_.size(), 0);
+    length_ = samples_;
+    if (length_ / decimation_ < 1) decimation_ = 1;
+    designFilter();
+    return 0;
+}
+
+
+int FrameReducer::setWindow(const std::vector<int>& first, int length) {
+
+    // one first sample for all probes, or one per probe
+    std::vector<int> starts(keep_.size(), first.empty() ? 0 : first[0]);
+    if (first.size() > 1) {
+        if (first.size() != keep_.size()) return -1;
+        starts = first;
+    }
+
+    int shortest = samples_;
+    for (int start : starts) {
+        if (start < 0 || start >= samples_) return -1;
+        if (samples_ - start < shortest) shortest = samples_ - start;
+    }
+    if (length < 0) length = shortest;
+    if (length < 1 || length > shortest || length / decimation_ < 1) return -1;
+
+    first_ = starts;
+    length_ = length;
+    return 0;
+}
+
+
+int FrameReducer::setDecimation(int factor, int taps) {
+
+    if (factor < 1 || length_ / factor < 1) return -1;
+
+    decimation_ = factor;
+    taps_ = (decimation_ == 1) ? 1 : ((taps > 0) ? (taps | 1) : 8 * decimation_ + 1);
+    designFilter();
+    return 0;
+}
+
+
+void FrameReducer::designFilter() {
+
+    if (decimation_ == 1) taps_ = 1;
+    int half = taps_ / 2;
+    filter_.resize(taps_);
+
+    // windowed sinc cut off at the new Nyquist frequency (0.5 / decimation_), the sum is 1 so the baseline stays where it is
+    double sum = 0.0;
+    std::vector<double> filter(taps_);
+    for (int k = -half; k <= half; k++) {
+        double window = (half == 0) ? 1.0 : 0.54 + 0.46 * cos(M_PI * k / half);
+        double lowpass = (k == 0) ? 1.0 / decimation_ : sin(M_PI * k / decimation_) / (M_PI * k);
+        filter[k + half] = window * lowpass;
+        sum += filter[k + half];
+    }
+    for (int k = 0; k < taps_; k++) filter_[k] = (float)(filter[k] / sum);
+
+    line_.assign(samples_ + 2 * half, 0.0f);
+}
+
+
+void FrameReducer::process(const uint16_t* raw, uint16_t* reduced) {
+
+    int outsamples = length_ / decimation_;
+
+    for (size_t p = 0; p < keep_.size(); p++) {
+        const uint16_t* line = raw + (size_t)keep_[p] * samples_;
+        uint16_t* output = reduced + p * outsamples;
+
+        // only the window, that is the whole saving in memory bandwidth downstream
+        if (decimation_ == 1) {
+            memcpy(output, line + first_[p], sizeof(uint16_t) * length_);
+            continue;
+        }
+
+        // the window and half a filter on both sides, the first and the last sample of the line repeat beyond its ends
+        int half = taps_ / 2;
+        int start = first_[p] - half;
+        int count = length_ + 2 * half;
+        for (int s = 0; s < count; s++) {
+            int source = start + s;
+            source = (source < 0) ? 0 : ((source >= samples_) ? samples_ - 1 : source);
+            line_[s] = (float)line[source];
+        }
+
+        // the filter only for the samples that are kept
+        for (int o = 0; o < outsamples; o++) {
+            const float* window = line_.data() + (size_t)o * decimation_;
+            float value = 0.0f;
+            for (int k = 0; k < taps_; k++) value += filter_[k] * window[k];
+            value += 0.5f;
+            output[o] = (uint16_t)((value < 0.0f) ? 0.0f : ((value > 65535.0f) ? 65535.0f : value));
+        }
+    }
+}
+
+
+bool FrameReducer::isIdentity() {
+
+    if ((int)keep_.size() != probes_ || length_ != samples_ || decimation_ != 1) return false;
+    for (int p = 0; p < probes_; p++) {
+        if (keep_[p] != p) return false;
+    }
+    return true;
+}
+
+
+int FrameReducer::getSamples() {
+    return length_ / decimation_;
+}
+
+
+int FrameReducer::getProbes() {
+    return (int)keep_.size();
+}
+
+
+int FrameReducer::getDecimation() {
+    return decimation_;
+}
+
+
+int FrameReducer::getTaps() {
+    return taps_;
+}
+
+
+int FrameReducer::getLength() {
+    return length_;
+}
+
+
+std::string FrameReducer::getProbesText() {
+
+    std::string text;
+    for (size_t p = 0; p < keep_.size(); p++) text += (p > 0 ? "," : "") + std::to_string(keep_[p]);
+    return text;
+}
+
+
+std::string FrameReducer::getWindowText() {
+
+    std::string text;
+    for (size_t p = 0; p < first_.size(); p++) text += (p > 0 ? "," : "") + std::to_string(first_[p]);
+    return text;
+}
@@ -0,0 +1,150 @@
+#include "FrameStage.h"
+
+#include "FrameClock.h"
+
+FrameStage::FrameStage(std::string name, int outputsize, size_t capacity)
+    : name_(name), outputsize_(outputsize) {
+
+    // the latest raw frames are the interesting ones, the output of an old frame is no use live
+    input_.reset(new FrameSubscriber([this](const FrameSlot& frame) { process(frame); }, capacity, QUEUE_DROP_OLDEST));
+}
+
+
+FrameStage::~FrameStage() {
+    stop();
+}
+
+
+void FrameStage::setProcess(FrameProcess process) {
+    process_ = process;
+}
+
+
+void FrameStage::setLatencyBudget(double microseconds) {
+    budget_ = (int64_t)(microseconds * 1e3);
+}
+
+
+FrameSubscriber* FrameStage::subscribe(size_t capacity, int policy) {
+
+    subscribers_.emplace_back(new FrameSubscriber(capacity, policy));
+    return subscribers_.back().get();
+}
+
+
+FrameSubscriber* FrameStage::subscribe(FrameCallback callback, size_t capacity, int policy) {
+
+    subscribers_.emplace_back(new FrameSubscriber(callback, capacity, policy));
+    return subscribers_.back().get();
+}
+
+
+void FrameStage::start() {
+
+    // same as the pool of the connection: every subscriber, its queue (which keeps one more) and the frame it looks at,
+    // and the one being computed. no header and no index, the values start at packet
+    size_t poolsize = 4;
+    for (std::unique_ptr<FrameSubscriber>& subscriber : subscribers_) {
+        poolsize += subscriber->getCapacity() + 2;
+        subscriber->start();
+    }
+    pool_.reset(new FramePool(poolsize, 0, 0, outputsize_));
+
+    countprocess_ = 0;
+    countempty_ = 0;
+    countlate_ = 0;
+    processtime_ = 0;
+    maxlatency_ = 0;
+    input_->start();
+    running_ = true;
+}
+
+
+void FrameStage::push(const FrameRef& frame) {
+    input_->push(frame);
+}
+
+
+void FrameStage::stop() {
+
+    if (!running_) return;
+    running_ = false;
+
+    // first the raw frames that are waiting, then the output frames they became
+    input_->stop();
+    for (std::unique_ptr<FrameSubscriber>& subscriber : subscribers_) subscriber->stop();
+
+    printf("A-Mode %s: %ld frames (%.1f us each, at most %.1f us after arrival), %ld dropped, %ld without free frame",
+        name_.c_str(), getProcessCount(), getMeanTime(), getMaxLatency(), getDropCount(), getEmptyCount());
+    if (budget_ > 0) printf(", %ld over %.0f us", getLateCount(), budget_ * 1e-3);
+    printf("\n");
+    for (size_t i = 0; i < subscribers_.size(); i++) {
+        printf("A-Mode %s subscriber %d: %ld frames delivered, %ld dropped\n", name_.c_str(), (int)i, subscribers_[i]->getDeliverCount(), subscribers_[i]->getDropCount());
+    }
+}
+
+
+void FrameStage::process(const FrameSlot& frame) {
+
+    FrameRef output = pool_->acquire();
+    if (output.empty() || !process_) {
+        countempty_++;
+        return;
+    }
+
+    int64_t begin = FrameClock::now();
+    process_(frame, *output);
+    int64_t end = FrameClock::now();
+    processtime_ += end - begin;
+
+    // the whole time the frame took, the queue in front of the stage included
+    int64_t latency = end - frame.timestamp;
+    if (latency > maxlatency_) maxlatency_ = latency;
+    if (budget_ > 0 && latency > budget_) countlate_++;
+
+    output->timestamp = frame.timestamp;
+    output->index = frame.index;
+    for (std::unique_ptr<FrameSubscriber>& subscriber : subscribers_) subscriber->push(output);
+    countprocess_++;
+}
+
+
+std::string FrameStage::getName() {
+    return name_;
+}
+
+
+size_t FrameStage::getCapacity() {
+    return input_->getCapacity();
+}
+
+
+long FrameStage::getProcessCount() {
+    return countprocess_;
+}
+
+
+long FrameStage::getDropCount() {
+    return input_->getDropCount();
+}
+
+
+long FrameStage::getEmptyCount() {
+    return countempty_;
+}
+
+
+long FrameStage::getLateCount() {
+    return countlate_;
+}
+
+
+double FrameStage::getMeanTime() {
+    long count = countprocess_;
+    return (count > 0) ? processtime_ * 1e-3 / count : 0.0;
+}
+
+
+double FrameStage::getMaxLatency() {
+    return maxlatency_ * 1e-3;
+}
@@ -0,0 +1,92 @@
+#include "FrameSubscriber.h"
+
+FrameSubscriber::FrameSubscriber(size_t capacity, int policy)
+    : queue_(capacity, (policy == QUEUE_BLOCK) ? QUEUE_DROP_OLDEST : policy) {
+
+    // the socket must never wait for a subscriber
+    if (policy == QUEUE_BLOCK) printf("A-Mode subscriber: QUEUE_BLOCK is not allowed, using QUEUE_DROP_OLDEST\n");
+}
+
+
+FrameSubscriber::FrameSubscriber(FrameCallback callback, size_t capacity, int policy)
+    : FrameSubscriber(capacity, policy) {
+    callback_ = callback;
+}
+
+
+FrameSubscriber::~FrameSubscriber() {
+    stop();
+}
+
+
+void FrameSubscriber::start() {
+
+    if (!callback_ || thread_.joinable()) return;
+
+    stop_ = false;
+    thread_ = std::thread(&FrameSubscriber::deliverLoop, this);
+}
+
+
+bool FrameSubscriber::push(const FrameRef& frame) {
+    return queue_.push(frame);
+}
+
+
+bool FrameSubscriber::pop(FrameRef& frame) {
+
+    // the queue swaps, whatever frame holds would end up in the queue
+    frame.reset();
+    if (!queue_.pop(frame)) return false;
+    countdeliver_++;
+    return true;
+}
+
+
+void FrameSubscriber::stop() {
+
+    if (!thread_.joinable()) return;
+
+    stop_ = true;
+    thread_.join();
+}
+
+
+void FrameSubscriber::deliverLoop() {
+
+    while (true) {
+
+        // current_ is empty when it goes into the queue in exchange, the slot goes back to the pool after the callback
+        if (queue_.pop(current_)) {
+            callback_(*current_);
+            current_.reset();
+            countdeliver_++;
+        }
+
+        else {
+            // only finish when everything which was pushed before stop() is delivered
+            if (stop_) break;
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+}
+
+
+size_t FrameSubscriber::getQueueDepth() {
+    return queue_.size();
+}
+
+
+size_t FrameSubscriber::getCapacity() {
+    return queue_.capacity();
+}
+
+
+long FrameSubscriber::getDeliverCount() {
+    return countdeliver_;
+}
+
+
+long FrameSubscriber::getDropCount() {
+    return queue_.getDropCount();
+}
@@ -0,0 +1,182 @@
+#include "IndexTracker.h"
+
+IndexTracker::IndexTracker(int indexbits) {
+    indexbits_ = indexbits;
+    mask_ = (indexbits_ >= 64) ? UINT64_MAX : ((1ull << indexbits_) - 1);
+
+    // the ranges never allocate while streaming
+    ranges_.reserve(INDEXTRACKER_MAXRANGES);
+}
+
+
+void IndexTracker::reset() {
+    started_ = false;
+    expected_ = 0;
+    ranges_.clear();
+    countreceived_ = 0;
+    countmissing_ = 0;
+    countgap_ = 0;
+    countduplicate_ = 0;
+    countreorder_ = 0;
+    secondstart_ = 0.0;
+    secondreceived_ = 0;
+    secondmissing_ = 0;
+    lossrate_ = 0.0;
+    maxlossrate_ = 0.0;
+}
+
+
+void IndexTracker::update(uint64_t index, double timestamp) {
+
+    index &= mask_;
+    countreceived_++;
+
+    if (!started_) {
+        started_ = true;
+        expected_ = (index + 1) & mask_;
+        countSecond(timestamp, 1, 0);
+        return;
+    }
+
+    // how far the index is ahead of what we expect, with wraparound. more than half of the range ahead
+    // is taken as behind, so with 16 bits a gap of more than 32768 frames looks like an old frame
+    uint64_t distance = (index - expected_) & mask_;
+    uint64_t half = (mask_ >> 1) + 1;
+
+    if (distance == 0) {
+        expected_ = (index + 1) & mask_;
+        countSecond(timestamp, 1, 0);
+    }
+
+    else if (distance < half) {
+        // the frames expected_ .. index-1 never came
+        countgap_++;
+        countmissing_ += (long)distance;
+        if (ranges_.size() < INDEXTRACKER_MAXRANGES) ranges_.push_back({ expected_, distance, timestamp });
+
+        expected_ = (index + 1) & mask_;
+        countSecond(timestamp, 1, (long)distance);
+    }
+
+    else if (fillGap(index)) {
+        // a frame of a gap came late, it is not missing anymore
+        countreorder_++;
+        countmissing_--;
+        countSecond(timestamp, 1, -1);
+    }
+
+    else {
+        countduplicate_++;
+        countSecond(timestamp, 0, 0);
+    }
+}
+
+
+bool IndexTracker::fillGap(uint64_t index) {
+
+    // frames only come late by a few frames, so only the last gaps are searched
+    size_t first = (ranges_.size() > INDEXTRACKER_REORDERWINDOW) ? ranges_.size() - INDEXTRACKER_REORDERWINDOW : 0;
+    for (size_t r = ranges_.size(); r-- > first;) {
+        IndexRange& range = ranges_[r];
+        uint64_t offset = (index - range.first) & mask_;
+        if (offset >= range.count) continue;
+
+        if (range.count == 1) {
+            ranges_.erase(ranges_.begin() + r);
+        }
+        else if (offset == 0) {
+            range.first = (range.first + 1) & mask_;
+            range.count--;
+        }
+        else if (offset == range.count - 1) {
+            range.count--;
+        }
+        else {
+            // in the middle of the range, it becomes two ranges. If the list is full, the newest range makes room
+            // and is only counted from now on, like the ranges after INDEXTRACKER_MAXRANGES
+            IndexRange after = { (index + 1) & mask_, range.count - offset - 1, range.timestamp };
+            range.count = offset;
+            if (ranges_.size() < INDEXTRACKER_MAXRANGES) {
+                ranges_.insert(ranges_.begin() + r + 1, after);
+            }
+            else if (r + 1 < ranges_.size()) {
+                ranges_.pop_back();
+                ranges_.insert(ranges_.begin() + r + 1, after);
+            }
+        }
+        return true;
+    }
+
+    return false;
+}
+
+
+void IndexTracker::countSecond(double timestamp, long received, long missing) {
+
+    if (secondstart_ == 0.0) secondstart_ = timestamp;
+
+    if (timestamp - secondstart_ >= 1.0) {
+        long expected = secondreceived_ + secondmissing_;
+        double rate = (expected > 0 && secondmissing_ > 0) ? (double)secondmissing_ / expected : 0.0;
+        lossrate_ = rate;
+        if (rate > maxlossrate_) maxlossrate_ = rate;
+
+        secondstart_ = timestamp;
+        secondreceived_ = 0;
+        secondmissing_ = 0;
+    }
+
+    secondreceived_ += received;
+    secondmissing_ += missing;
+}
+
+
+long IndexTracker::getReceivedCount() {
+    return countreceived_;
+}
+
+
+long IndexTracker::getMissingCount() {
+    return countmissing_;
+}
+
+
+long IndexTracker::getGapCount() {
+    return countgap_;
+}
+
+
+long IndexTracker::getDuplicateCount() {
+    return countduplicate_;
+}
+
+
+long IndexTracker::getReorderCount() {
+    return countreorder_;
+}
+
+
+double IndexTracker::getLossRate() {
+    return lossrate_;
+}
+
+
+double IndexTracker::getMaxLossRate() {
+    return maxlossrate_;
+}
+
+
+const std::vector<IndexRange>& IndexTracker::getMissingRanges() {
+    return ranges_;
+}
+
+
+std::string IndexTracker::getMissingRangesText(size_t maxranges) {
+
+    std::string text;
+    for (size_t r = 0; r < ranges_.size() && r < maxranges; r++) {
+        if (!text.empty()) text += ",";
+        text += std::to_string(ranges_[r].first) + "-" + std::to_string((ranges_[r].first + ranges_[r].count - 1) & mask_);
+    }
+    return text;
+}
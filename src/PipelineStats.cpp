@@ -0,0 +1,178 @@
+#include "PipelineStats.h"
+
+#ifdef AMODE_ENABLE_STATS
+
+#include "getTime.h"
+
+LatencyHistogram::LatencyHistogram() {
+    reset();
+}
+
+
+void LatencyHistogram::reset() {
+    for (std::atomic<uint64_t>& bucket : buckets_) bucket.store(0, std::memory_order_relaxed);
+    count_ = 0;
+    sum_ = 0;
+    max_ = 0;
+}
+
+
+uint64_t LatencyHistogram::bucketUpper(int index) {
+    if (index < (1 << STATS_SUBBITS)) return (uint64_t)index;
+
+    // index = shift*2^STATS_SUBBITS + (value >> shift), with value >> shift in [2^STATS_SUBBITS, 2^(STATS_SUBBITS+1))
+    int shift = (index >> STATS_SUBBITS) - 1;
+    uint64_t lower = (uint64_t)(index - (shift << STATS_SUBBITS)) << shift;
+    return lower + ((uint64_t)1 << shift) - 1;
+}
+
+
+uint64_t LatencyHistogram::getPercentile(double q) {
+
+    uint64_t count = count_.load(std::memory_order_acquire);
+    if (count == 0) return 0;
+
+    // the rank of the value we want, at least the first one
+    uint64_t rank = (uint64_t)(q * count + 0.5);
+    if (rank < 1) rank = 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < STATS_BUCKETS; i++) {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            // the bucket can be wider than the values in it, the max is exact
+            uint64_t upper = bucketUpper(i);
+            uint64_t max = max_.load(std::memory_order_relaxed);
+            return (upper < max) ? upper : max;
+        }
+    }
+    return max_;
+}
+
+
+uint64_t LatencyHistogram::getCount() {
+    return count_;
+}
+
+
+uint64_t LatencyHistogram::getMax() {
+    return max_;
+}
+
+
+double LatencyHistogram::getMean() {
+    uint64_t count = count_;
+    if (count == 0) return 0.0;
+    return (double)sum_ / count;
+}
+
+
+PipelineStats::~PipelineStats() {
+    stop();
+}
+
+
+LatencyHistogram& PipelineStats::getHistogram(int stage) {
+    return histograms_[stage];
+}
+
+
+const char* PipelineStats::getStageName(int stage) {
+    switch (stage) {
+    case STATS_INTERARRIVAL: return "interarrival";
+    case STATS_RECEIVE: return "receive";
+    case STATS_QUEUEWAIT: return "queuewait";
+    case STATS_WRITE: return "write";
+    }
+    return "unknown";
+}
+
+
+void PipelineStats::start(std::string path, double interval) {
+
+    stop();
+    path_ = path;
+    interval_ = interval;
+    stop_ = false;
+    if (interval_ > 0.0) thread_ = std::thread(&PipelineStats::reportLoop, this);
+}
+
+
+void PipelineStats::setProfile(std::string profile) {
+    profile_ = profile;
+}
+
+
+void PipelineStats::stop() {
+
+    // the final line is written when start() was called, even without reporting thread
+    if (interval_ < 0.0) return;
+
+    if (thread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        condition_.notify_all();
+        thread_.join();
+    }
+    writeLine(true);
+    interval_ = -1.0;
+}
+
+
+std::string PipelineStats::toJson(bool final) {
+
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "{\"time\":%.6f,\"final\":%s,\"profile\":\"%s\",\"unit\":\"ns\",\"stages\":{",
+        rtb::getTime(), final ? "true" : "false", profile_.c_str());
+    std::string json = buffer;
+
+    for (int stage = 0; stage < STATS_STAGES; stage++) {
+        LatencyHistogram& histogram = histograms_[stage];
+        snprintf(buffer, sizeof(buffer), "%s\"%s\":{\"count\":%llu,\"mean\":%.0f,\"p50\":%llu,\"p99\":%llu,\"p999\":%llu,\"max\":%llu}",
+            (stage > 0) ? "," : "", getStageName(stage),
+            (unsigned long long)histogram.getCount(), histogram.getMean(),
+            (unsigned long long)histogram.getPercentile(0.5), (unsigned long long)histogram.getPercentile(0.99),
+            (unsigned long long)histogram.getPercentile(0.999), (unsigned long long)histogram.getMax());
+        json += buffer;
+    }
+
+    json += "}}";
+    return json;
+}
+
+
+void PipelineStats::writeLine(bool final) {
+
+    std::string line = toJson(final) + "\n";
+
+    if (path_.empty()) {
+        fputs(line.c_str(), stdout);
+        return;
+    }
+
+    FILE* file = fopen(path_.c_str(), "a");
+    if (file == nullptr) {
+        printf("Unable to open %s for the latency statistics\n", path_.c_str());
+        return;
+    }
+    fputs(line.c_str(), file);
+    fclose(file);
+}
+
+
+void PipelineStats::reportLoop() {
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_) {
+        if (condition_.wait_for(lock, std::chrono::duration<double>(interval_), [this] { return stop_; })) break;
+
+        // the streaming threads never wait for this lock, only stop() does
+        lock.unlock();
+        writeLine(false);
+        lock.lock();
+    }
+}
+
+#endif
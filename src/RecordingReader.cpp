@@ -0,0 +1,439 @@
+#include "RecordingReader.h"
+
+#include <string.h>
+#include <boost/filesystem.hpp>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifndef DATA_RAW
+#define DATA_RAW 0
+#define DATA_DEPTH 1
+#endif
+
+// how far the iterator reads ahead
+#define PREFETCH_WINDOW (32ull << 20)
+
+
+RecordingReader::RecordingReader() {
+}
+
+
+RecordingReader::~RecordingReader() {
+    close();
+}
+
+
+int RecordingReader::open(std::string directory, std::string name) {
+
+    close();
+
+    // the segments are numbered without gaps, stop at the first one that doesn't exist
+    for (int s = 0; ; s++) {
+        char segmentname[16];
+        snprintf(segmentname, sizeof(segmentname), "_%04d", s);
+        boost::filesystem::path filepath = boost::filesystem::path(directory) / (name + segmentname + RECORDING_EXTENSION);
+        if (!boost::filesystem::exists(filepath)) break;
+
+        segments_.emplace_back();
+        if (openSegment(filepath.string(), segments_.back()) != 0) {
+            segments_.pop_back();
+            break;
+        }
+    }
+
+    if (segments_.empty()) {
+        printf("No A-mode recording %s found in %s\n", name.c_str(), directory.c_str());
+        return -1;
+    }
+
+    const RecordingHeader* header = segments_.front().header;
+    datamode_ = header->datamode;
+    samples_ = header->samples;
+    probes_ = header->probes;
+    valuesize_ = header->valuesize;
+    indexbits_ = (datamode_ == DATA_RAW) ? 16 : 64;
+
+    if (datamode_ == DATA_RAW) codec_.reset(new FrameCodec(samples_, probes_));
+    decodedordinal_ = -1;
+
+    // ordinals continue from one segment to the next
+    framecount_ = 0;
+    for (Segment& segment : segments_) {
+        segment.firstframe = framecount_;
+        framecount_ += segment.framecount;
+    }
+
+    return 0;
+}
+
+
+int RecordingReader::openSegment(std::string filepath, Segment& segment) {
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return -1;
+
+    LARGE_INTEGER filesize;
+    GetFileSizeEx(file, &filesize);
+    segment.size = (uint64_t)filesize.QuadPart;
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL) {
+        CloseHandle(file);
+        return -1;
+    }
+    segment.data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    segment.filehandle = file;
+    segment.maphandle = mapping;
+#else
+    int fd = ::open(filepath.c_str(), O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat filestat;
+    fstat(fd, &filestat);
+    segment.size = (uint64_t)filestat.st_size;
+
+    void* data = (segment.size > 0) ? mmap(NULL, segment.size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    segment.data = (data == MAP_FAILED) ? nullptr : (const char*)data;
+#endif
+
+    if (segment.data == nullptr || segment.size < sizeof(RecordingHeader)
+        || memcmp(segment.data, RECORDING_MAGIC, 8) != 0) {
+        printf("%s is not an A-mode recording\n", filepath.c_str());
+        closeSegment(segment);
+        return -1;
+    }
+    segment.header = (const RecordingHeader*)segment.data;
+
+    // a segment that was closed properly ends with the footer, it has the index and the metadata.
+    // the records have any size, so the footer, the index and the record headers can be anywhere in the file,
+    // they are copied out with memcpy() instead of being read through a pointer that may be unaligned
+    RecordingFooter footer;
+    bool hasfooter = false;
+    if (segment.size >= sizeof(RecordingHeader) + sizeof(RecordingFooter)) {
+        memcpy(&footer, segment.data + segment.size - sizeof(RecordingFooter), sizeof(RecordingFooter));
+        hasfooter = memcmp(footer.magic, RECORDING_FOOTER_MAGIC, 8) == 0
+            && footer.indexoffset + footer.framecount * sizeof(RecordingIndexEntry) <= segment.size
+            && footer.metadataoffset + footer.metadatasize <= segment.size;
+    }
+
+    if (hasfooter) {
+        // the index is used in place if it happens to be aligned, otherwise it is copied once
+        const char* index = segment.data + footer.indexoffset;
+        if ((uintptr_t)index % alignof(RecordingIndexEntry) == 0) {
+            segment.index = (const RecordingIndexEntry*)index;
+        }
+        else {
+            segment.indexcopy.resize(footer.framecount);
+            memcpy(segment.indexcopy.data(), index, footer.framecount * sizeof(RecordingIndexEntry));
+            segment.index = segment.indexcopy.data();
+        }
+        segment.framecount = (long)footer.framecount;
+        segment.metadata.assign(segment.data + footer.metadataoffset, footer.metadatasize);
+    }
+    else {
+        printf("%s has no index (the recording was not closed), reading it record by record\n", filepath.c_str());
+        rebuildIndex(segment);
+    }
+
+    return 0;
+}
+
+
+void RecordingReader::rebuildIndex(Segment& segment) {
+
+    segment.indexcopy.clear();
+    uint64_t offset = segment.header->headersize;
+
+    // take every record which is complete, the last one may be cut
+    while (offset + sizeof(RecordingFrameHeader) <= segment.size) {
+        RecordingFrameHeader record;
+        memcpy(&record, segment.data + offset, sizeof(RecordingFrameHeader));
+        if (offset + sizeof(RecordingFrameHeader) + record.payloadsize > segment.size) break;
+
+        RecordingIndexEntry entry;
+        entry.offset = offset;
+        entry.timestamp = record.timestamp;
+        entry.index = record.index;
+        segment.indexcopy.push_back(entry);
+
+        offset += sizeof(RecordingFrameHeader) + record.payloadsize;
+    }
+
+    segment.index = segment.indexcopy.data();
+    segment.framecount = (long)segment.indexcopy.size();
+}
+
+
+void RecordingReader::closeSegment(Segment& segment) {
+
+#ifdef _WIN32
+    if (segment.data != nullptr) UnmapViewOfFile(segment.data);
+    if (segment.maphandle != nullptr) CloseHandle((HANDLE)segment.maphandle);
+    if (segment.filehandle != nullptr) CloseHandle((HANDLE)segment.filehandle);
+    segment.maphandle = nullptr;
+    segment.filehandle = nullptr;
+#else
+    if (segment.data != nullptr) munmap((void*)segment.data, segment.size);
+#endif
+
+    segment.data = nullptr;
+    segment.header = nullptr;
+    segment.index = nullptr;
+}
+
+
+void RecordingReader::close() {
+    for (Segment& segment : segments_) closeSegment(segment);
+    segments_.clear();
+    framecount_ = 0;
+}
+
+
+int RecordingReader::findSegment(long ordinal) {
+
+    // there are only a few segments, binary search on the first frame of each
+    int low = 0;
+    int high = (int)segments_.size() - 1;
+    while (low < high) {
+        int middle = (low + high + 1) / 2;
+        if (segments_[middle].firstframe <= ordinal) low = middle;
+        else high = middle - 1;
+    }
+    return low;
+}
+
+
+bool RecordingReader::frame(long ordinal, FrameView& frame) {
+
+    if (ordinal < 0 || ordinal >= framecount_) return false;
+
+    Segment& segment = segments_[findSegment(ordinal)];
+    const RecordingIndexEntry& entry = segment.index[ordinal - segment.firstframe];
+    RecordingFrameHeader record;
+    memcpy(&record, segment.data + entry.offset, sizeof(RecordingFrameHeader));
+
+    frame.timestamp = record.timestamp;
+    frame.index = record.index;
+    frame.ordinal = ordinal;
+    frame.samples = samples_;
+    frame.probes = probes_;
+    frame.codec = record.codec;
+    frame.payloadsize = record.payloadsize;
+    frame.payload = segment.data + entry.offset + sizeof(RecordingFrameHeader);
+    return true;
+}
+
+
+int RecordingReader::decode(long ordinal, std::vector<uint16_t>& values) {
+
+    FrameView view;
+    if (datamode_ != DATA_RAW || !frame(ordinal, view)) return -1;
+
+    size_t framevalues = (size_t)samples_ * probes_;
+    if (ordinal == decodedordinal_) {
+        values = decoded_;
+        return 0;
+    }
+
+    // go back to a frame which can be decoded on its own, or to the one after the last decoded frame
+    long first = ordinal;
+    while (first != decodedordinal_ + 1 || decodedordinal_ < 0) {
+        frame(first, view);
+        if (view.codec == RECORDING_CODEC_NONE || (view.payloadsize > 0 && FrameCodec::isKeyframe(view.payload))) break;
+        if (first == 0) return -1;
+        first--;
+    }
+
+    decoded_.resize(framevalues);
+    decoding_.resize(framevalues);
+    for (long o = first; o <= ordinal; o++) {
+        frame(o, view);
+
+        if (view.codec == RECORDING_CODEC_NONE) {
+            if (view.payloadsize != framevalues * sizeof(uint16_t)) return -1;
+            memcpy(decoding_.data(), view.payload, view.payloadsize);
+        }
+        else if (view.codec == RECORDING_CODEC_PACK16) {
+            const uint16_t* previous = (o == decodedordinal_ + 1 && decodedordinal_ >= 0) ? decoded_.data() : nullptr;
+            if (codec_->decode(view.payload, view.payloadsize, previous, decoding_.data()) != 0) {
+                decodedordinal_ = -1;
+                return -1;
+            }
+        }
+        else {
+            return -1;
+        }
+
+        decoded_.swap(decoding_);
+        decodedordinal_ = o;
+    }
+
+    values = decoded_;
+    return 0;
+}
+
+
+long RecordingReader::findIndex(uint64_t index, long from) {
+
+    if (from < 0) from = 0;
+    if (from >= framecount_) return -1;
+
+    uint64_t mask = (indexbits_ >= 64) ? UINT64_MAX : ((1ull << indexbits_) - 1);
+
+    // without loss the frame is exactly (index - first index) frames later, lost frames can only
+    // move it to the front, so we start at the guess and go back
+    Segment& first = segments_[findSegment(from)];
+    uint64_t fromindex = first.index[from - first.firstframe].index;
+    uint64_t distance = (index - fromindex) & mask;
+
+    long guess = (distance < (uint64_t)(framecount_ - from)) ? from + (long)distance : framecount_ - 1;
+    for (long ordinal = guess; ordinal >= from; ordinal--) {
+        Segment& segment = segments_[findSegment(ordinal)];
+        if ((segment.index[ordinal - segment.firstframe].index & mask) == (index & mask)) return ordinal;
+    }
+
+    return -1;
+}
+
+
+long RecordingReader::findTimestamp(int64_t timestamp) {
+
+    // the frames are written in the order they arrive
+    long low = 0;
+    long high = framecount_;
+    while (low < high) {
+        long middle = low + (high - low) / 2;
+        Segment& segment = segments_[findSegment(middle)];
+        if (segment.index[middle - segment.firstframe].timestamp < timestamp) low = middle + 1;
+        else high = middle;
+    }
+    return low;
+}
+
+
+RecordingReader::Iterator RecordingReader::begin() {
+    return Iterator(this, 0, framecount_);
+}
+
+
+RecordingReader::Iterator RecordingReader::range(int64_t from, int64_t to) {
+    return Iterator(this, findTimestamp(from), findTimestamp(to));
+}
+
+
+void RecordingReader::prefetch(int segment, uint64_t offset, uint64_t size) {
+
+    Segment& s = segments_[segment];
+    if (offset >= s.size) return;
+    if (offset + size > s.size) size = s.size - offset;
+
+#ifdef _WIN32
+#if _WIN32_WINNT >= 0x0602
+    WIN32_MEMORY_RANGE_ENTRY entry;
+    entry.VirtualAddress = (PVOID)(s.data + offset);
+    entry.NumberOfBytes = (SIZE_T)size;
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &entry, 0);
+#endif
+#else
+    // madvise wants a page aligned address
+    uint64_t pagesize = (uint64_t)sysconf(_SC_PAGESIZE);
+    uint64_t aligned = offset & ~(pagesize - 1);
+    madvise((void*)(s.data + aligned), size + (offset - aligned), MADV_WILLNEED);
+#endif
+}
+
+
+std::string RecordingReader::getMetadata(std::string key) {
+
+    if (segments_.empty()) return "";
+
+    const std::string& metadata = segments_.back().metadata;
+    size_t position = 0;
+    while (position < metadata.size()) {
+        size_t end = metadata.find('\n', position);
+        if (end == std::string::npos) end = metadata.size();
+        if (metadata.compare(position, key.size(), key) == 0 && position + key.size() < end && metadata[position + key.size()] == '=') {
+            return metadata.substr(position + key.size() + 1, end - position - key.size() - 1);
+        }
+        position = end + 1;
+    }
+    return "";
+}
+
+
+long RecordingReader::getFrameCount() {
+    return framecount_;
+}
+
+
+int RecordingReader::getSegmentCount() {
+    return (int)segments_.size();
+}
+
+
+int RecordingReader::getDataMode() {
+    return datamode_;
+}
+
+
+int RecordingReader::getSamples() {
+    return samples_;
+}
+
+
+int RecordingReader::getProbes() {
+    return probes_;
+}
+
+
+int RecordingReader::getValueSize() {
+    return valuesize_;
+}
+
+
+const RecordingHeader* RecordingReader::getHeader() {
+    if (segments_.empty()) return nullptr;
+    return segments_.front().header;
+}
+
+
+int64_t RecordingReader::toWallTime(int64_t timestamp) {
+    const RecordingHeader* header = getHeader();
+    if (header == nullptr || header->clock != RECORDING_CLOCK_MONOTONIC) return timestamp;
+    return timestamp - header->clockorigin + header->wallorigin;
+}
+
+
+RecordingReader::Iterator::Iterator(RecordingReader* reader, long first, long last) {
+    reader_ = reader;
+    ordinal_ = first;
+    last_ = last;
+}
+
+
+bool RecordingReader::Iterator::next(FrameView& frame) {
+
+    if (ordinal_ >= last_ || !reader_->frame(ordinal_, frame)) return false;
+
+    // keep the OS reading PREFETCH_WINDOW ahead of us, ask again when we used half of it
+    int segment = reader_->findSegment(ordinal_);
+    uint64_t offset = (uint64_t)(frame.payload - reader_->segments_[segment].data);
+    if (segment != segment_ || offset + PREFETCH_WINDOW / 2 > prefetched_) {
+        uint64_t start = (segment != segment_) ? offset : prefetched_;
+        reader_->prefetch(segment, start, PREFETCH_WINDOW);
+        segment_ = segment;
+        prefetched_ = offset + PREFETCH_WINDOW;
+    }
+
+    ordinal_++;
+    return true;
+}
@@ -0,0 +1,219 @@
+#include "RecordingWriter.h"
+
+#include <string.h>
+#include <boost/filesystem.hpp>
+
+RecordingWriter::RecordingWriter() {
+    memset(&header_, 0, sizeof(header_));
+}
+
+
+RecordingWriter::~RecordingWriter() {
+    close();
+}
+
+
+void RecordingWriter::setBufferSize(size_t buffersize) {
+    buffersize_ = buffersize;
+}
+
+
+void RecordingWriter::setBackend(int backend, bool direct, int inflight, bool preallocate) {
+    file_.setBackend(backend, direct);
+    inflight_ = inflight;
+    preallocate_ = preallocate;
+}
+
+
+void RecordingWriter::setSegmentSize(uint64_t segmentsize) {
+    segmentsize_ = segmentsize;
+}
+
+
+bool RecordingWriter::isOpen() {
+    return file_.isOpen();
+}
+
+
+int RecordingWriter::getBackend() {
+    return file_.getBackend();
+}
+
+
+uint64_t RecordingWriter::getFrameCount() {
+    return countframe_;
+}
+
+
+uint64_t RecordingWriter::getByteCount() {
+    return countbyte_;
+}
+
+
+void RecordingWriter::setMetadata(std::string key, std::string value) {
+    for (auto& entry : metadata_) {
+        if (entry.first == key) {
+            entry.second = value;
+            return;
+        }
+    }
+    metadata_.push_back(std::make_pair(key, value));
+}
+
+
+int RecordingWriter::open(std::string directory, std::string name, int datamode, int samples, int probes, int valuesize,
+    int clock, int64_t clockorigin, int64_t wallorigin) {
+
+    close();
+
+    directory_ = directory;
+    name_ = name;
+
+    memset(&header_, 0, sizeof(header_));
+    memcpy(header_.magic, RECORDING_MAGIC, sizeof(header_.magic));
+    header_.version = RECORDING_VERSION;
+    header_.headersize = sizeof(RecordingHeader);
+    header_.datamode = datamode;
+    header_.samples = samples;
+    header_.probes = probes;
+    header_.valuesize = valuesize;
+    header_.segment = 0;
+    header_.clock = clock;
+    header_.clockorigin = clockorigin;
+    header_.firstframe = 0;
+    header_.wallorigin = wallorigin;
+
+    // all the memory is taken here and in openSegment(), write() doesn't allocate
+    file_.setBuffers(buffersize_, inflight_);
+    buffered_ = 0;
+    countframe_ = 0;
+    countbyte_ = 0;
+
+    return openSegment();
+}
+
+
+int RecordingWriter::openSegment() {
+
+    char segmentname[16];
+    snprintf(segmentname, sizeof(segmentname), "_%04u", header_.segment);
+    boost::filesystem::path filepath = boost::filesystem::path(directory_) / (name_ + segmentname + RECORDING_EXTENSION);
+
+    // the segment will be that big, so the filesystem finds the blocks now and not in the middle of the streaming
+    if (file_.open(filepath.string(), preallocate_ ? segmentsize_ : 0) != 0) return -1;
+
+    // the index of a full segment, so it doesn't grow while streaming, write() cuts the segment when it is full
+    // (compressed frames are smaller than recordsize, more of them would fit in the bytes of the segment)
+    uint64_t recordsize = sizeof(RecordingFrameHeader) + (uint64_t)header_.valuesize * header_.samples * header_.probes;
+    index_.clear();
+    index_.reserve((size_t)(segmentsize_ / recordsize + 1));
+
+    segmentoffset_ = 0;
+    return append(&header_, sizeof(header_));
+}
+
+
+int RecordingWriter::write(int64_t timestamp, uint64_t index, const char* payload, uint32_t payloadsize, uint32_t codec) {
+
+    if (!file_.isOpen()) return -1;
+
+    int iResult = 0;
+
+    // start the next segment when this one or its index is full, but never leave a segment without frames
+    uint64_t recordsize = sizeof(RecordingFrameHeader) + payloadsize;
+    if (!index_.empty() && (segmentoffset_ + recordsize > segmentsize_ || index_.size() == index_.capacity())) {
+        // its last buffers are still written while the next segment starts, if it failed the next one starts anyway
+        if (closeSegment(false) != 0) iResult = -1;
+        header_.segment++;
+        header_.firstframe = countframe_;
+        if (openSegment() != 0) return -1;
+    }
+
+    RecordingIndexEntry entry;
+    entry.offset = segmentoffset_;
+    entry.timestamp = timestamp;
+    entry.index = index;
+    index_.push_back(entry);
+
+    RecordingFrameHeader record;
+    record.timestamp = timestamp;
+    record.index = index;
+    record.payloadsize = payloadsize;
+    record.codec = codec;
+
+    if (append(&record, sizeof(record)) != 0) return -1;
+    if (append(payload, payloadsize) != 0) return -1;
+
+    countframe_++;
+    return iResult;
+}
+
+
+int RecordingWriter::append(const void* data, size_t size) {
+
+    segmentoffset_ += size;
+    countbyte_ += size;
+
+    // a record can be split between two buffers, the file is the same
+    const char* bytes = (const char*)data;
+    while (size > 0) {
+        size_t part = file_.getBufferSize() - buffered_;
+        if (part > size) part = size;
+        memcpy(file_.getBuffer() + buffered_, bytes, part);
+        buffered_ += part;
+        bytes += part;
+        size -= part;
+
+        if (buffered_ == file_.getBufferSize()) {
+            buffered_ = 0;
+            if (file_.submit(file_.getBufferSize()) != 0) return -1;
+        }
+    }
+    return 0;
+}
+
+
+int RecordingWriter::flush() {
+
+    if (buffered_ == 0) return 0;
+
+    size_t size = buffered_;
+    buffered_ = 0;
+    return file_.submit(size);
+}
+
+
+int RecordingWriter::closeSegment(bool wait) {
+
+    int iResult = 0;
+
+    RecordingFooter footer;
+    memcpy(footer.magic, RECORDING_FOOTER_MAGIC, sizeof(footer.magic));
+    footer.framecount = index_.size();
+
+    // index
+    footer.indexoffset = segmentoffset_;
+    if (!index_.empty() && append(index_.data(), index_.size() * sizeof(RecordingIndexEntry)) != 0) iResult = -1;
+
+    // metadata
+    std::string metadata;
+    for (auto& entry : metadata_) metadata += entry.first + "=" + entry.second + "\n";
+    footer.metadataoffset = segmentoffset_;
+    footer.metadatasize = metadata.size();
+    if (!metadata.empty() && append(metadata.data(), metadata.size()) != 0) iResult = -1;
+
+    if (append(&footer, sizeof(footer)) != 0) iResult = -1;
+    if (flush() != 0) iResult = -1;
+    if (iResult != 0) printf("A-mode recording: writing segment %u failed\n", header_.segment);
+
+    // the failure can also be of the segment before, which was still written while this one started,
+    // AsyncFileWriter already said which file it was
+    if (file_.close(wait) != 0) iResult = -1;
+    return iResult;
+}
+
+
+int RecordingWriter::close() {
+    if (!file_.isOpen()) return 0;
+    return closeSegment(true);
+}
@@ -0,0 +1,222 @@
+#include "SharedRingReader.h"
+
+#include <string.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#endif
+
+SharedRingReader::~SharedRingReader() {
+    close();
+}
+
+
+int SharedRingReader::open(std::string name) {
+
+    close();
+    name_ = name;
+
+#ifdef _WIN32
+    std::string mappingname = "Local\\" + name_;
+    mapping_ = OpenFileMappingA(FILE_MAP_READ, FALSE, mappingname.c_str());
+    if (mapping_ == NULL) return -1;
+    memory_ = (const char*)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+    if (memory_ == nullptr) {
+        CloseHandle(mapping_);
+        mapping_ = NULL;
+        return -1;
+    }
+    MEMORY_BASIC_INFORMATION info;
+    VirtualQuery(memory_, &info, sizeof(info));
+    size_ = info.RegionSize;
+#else
+    // read only, a reader can never disturb the writer or the other readers
+    int fd = shm_open(("/" + name_).c_str(), O_RDONLY, 0);
+    if (fd < 0) return -1;
+    struct stat status;
+    if (fstat(fd, &status) != 0 || (size_t)status.st_size < sizeof(SharedRingHeader)) {
+        ::close(fd);
+        return -1;
+    }
+    size_ = (size_t)status.st_size;
+    void* memory = mmap(NULL, size_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED) return -1;
+    memory_ = (const char*)memory;
+#endif
+
+    // the writer sets the state last, before that the header is not complete
+    header_ = (const SharedRingHeader*)memory_;
+    if (memcmp(header_->magic, SHAREDRING_MAGIC, sizeof(header_->magic)) != 0 || header_->version != SHAREDRING_VERSION
+        || header_->state.load(std::memory_order_acquire) == 0
+        || header_->headersize + (size_t)header_->slotsize * header_->slotcount > size_) {
+        printf("A-Mode shared ring: %s is not a ring (yet)\n", name_.c_str());
+        close();
+        return -1;
+    }
+
+    // start with the newest frame, the older ones are history
+    uint64_t published = header_->published.load(std::memory_order_acquire);
+    next_ = (published > 0) ? published - 1 : 0;
+    countlost_ = 0;
+    return 0;
+}
+
+
+void SharedRingReader::close() {
+
+    if (memory_ == nullptr) return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(memory_);
+    CloseHandle(mapping_);
+    mapping_ = NULL;
+#else
+    munmap((void*)memory_, size_);
+#endif
+
+    memory_ = nullptr;
+    header_ = nullptr;
+}
+
+
+const SharedSlotHeader* SharedRingReader::slot(uint64_t n) {
+    return (const SharedSlotHeader*)(memory_ + header_->headersize + (size_t)header_->slotsize * (n % header_->slotcount));
+}
+
+
+bool SharedRingReader::read(uint64_t n, SharedFrame& frame) {
+
+    const SharedSlotHeader* s = slot(n);
+    uint64_t expected = 2 * n + 2;
+    if (s->sequence.load(std::memory_order_acquire) != expected) return false;
+
+    frame.sequence = n;
+    frame.timestamp = s->timestamp;
+    frame.index = s->index;
+    frame.datasize = s->datasize;
+    frame.data = (const char*)s + SHAREDRING_ALIGNMENT;
+
+    // the header of the slot could have changed while we read it
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return s->sequence.load(std::memory_order_relaxed) == expected;
+}
+
+
+int SharedRingReader::next(SharedFrame& frame) {
+
+    if (header_ == nullptr) return SHAREDRING_CLOSED;
+
+    uint64_t published = header_->published.load(std::memory_order_acquire);
+    while (next_ < published) {
+
+        // the writer may be changing the slot of frame published - slotcount right now, so that one is already gone
+        uint64_t oldest = (published >= header_->slotcount) ? published - header_->slotcount + 1 : 0;
+        if (next_ < oldest) {
+            countlost_ += (long)(oldest - next_);
+            next_ = oldest;
+        }
+
+        if (read(next_, frame)) {
+            next_++;
+            return SHAREDRING_FRAME;
+        }
+
+        // it was overwritten while we looked, the writer is ahead of what we saw
+        uint64_t now = header_->published.load(std::memory_order_acquire);
+        if (now == published) return SHAREDRING_EMPTY;
+        published = now;
+    }
+
+    if (header_->state.load(std::memory_order_acquire) == SHAREDRING_STATE_CLOSED) return SHAREDRING_CLOSED;
+    return SHAREDRING_EMPTY;
+}
+
+
+int SharedRingReader::latest(SharedFrame& frame) {
+
+    if (header_ == nullptr) return SHAREDRING_CLOSED;
+
+    uint64_t published = header_->published.load(std::memory_order_acquire);
+    if (published > 0 && read(published - 1, frame)) {
+        next_ = published;
+        return SHAREDRING_FRAME;
+    }
+
+    if (header_->state.load(std::memory_order_acquire) == SHAREDRING_STATE_CLOSED) return SHAREDRING_CLOSED;
+    return SHAREDRING_EMPTY;
+}
+
+
+bool SharedRingReader::isValid(const SharedFrame& frame) {
+
+    if (header_ == nullptr) return false;
+
+    // everything read from the values before this has to be done before the sequence is checked
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot(frame.sequence)->sequence.load(std::memory_order_relaxed) == 2 * frame.sequence + 2;
+}
+
+
+bool SharedRingReader::copy(const SharedFrame& frame, void* buffer) {
+    memcpy(buffer, frame.data, frame.datasize);
+    return isValid(frame);
+}
+
+
+bool SharedRingReader::isWriterAlive() {
+
+    if (header_ == nullptr) return false;
+    if (header_->state.load(std::memory_order_acquire) == SHAREDRING_STATE_CLOSED) return false;
+
+#ifdef _WIN32
+    HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, (DWORD)header_->writerpid);
+    if (process == NULL) return false;
+    bool alive = (WaitForSingleObject(process, 0) == WAIT_TIMEOUT);
+    CloseHandle(process);
+    return alive;
+#else
+    return kill((pid_t)header_->writerpid, 0) == 0 || errno == EPERM;
+#endif
+}
+
+
+long SharedRingReader::getLostCount() {
+    return countlost_;
+}
+
+
+uint64_t SharedRingReader::getPublishedCount() {
+    if (header_ == nullptr) return 0;
+    return header_->published.load(std::memory_order_acquire);
+}
+
+
+int SharedRingReader::getDataMode() {
+    return (header_ != nullptr) ? (int)header_->datamode : -1;
+}
+
+
+int SharedRingReader::getSamples() {
+    return (header_ != nullptr) ? (int)header_->samples : 0;
+}
+
+
+int SharedRingReader::getProbes() {
+    return (header_ != nullptr) ? (int)header_->probes : 0;
+}
+
+
+int SharedRingReader::getSlotCount() {
+    return (header_ != nullptr) ? (int)header_->slotcount : 0;
+}
+
+
+const SharedRingHeader* SharedRingReader::getHeader() {
+    return header_;
+}
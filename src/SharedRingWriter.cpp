@@ -0,0 +1,155 @@
+#include "SharedRingWriter.h"
+
+#include <string.h>
+#include <new>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "FrameClock.h"
+
+SharedRingWriter::~SharedRingWriter() {
+    close();
+}
+
+
+int SharedRingWriter::open(std::string name, int datamode, int samples, int probes, int valuesize, int slots, int64_t clockorigin, int64_t wallorigin) {
+
+    close();
+
+    name_ = name;
+    uint32_t datasize = (uint32_t)(samples * probes * valuesize);
+    uint32_t slotsize = (uint32_t)((SHAREDRING_ALIGNMENT + datasize + SHAREDRING_ALIGNMENT - 1) & ~(uint32_t)(SHAREDRING_ALIGNMENT - 1));
+    size_t headersize = (sizeof(SharedRingHeader) + SHAREDRING_ALIGNMENT - 1) & ~(size_t)(SHAREDRING_ALIGNMENT - 1);
+    size_ = headersize + (size_t)slotsize * slots;
+
+#ifdef _WIN32
+    std::string mappingname = "Local\\" + name_;
+    mapping_ = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((uint64_t)size_ >> 32), (DWORD)size_, mappingname.c_str());
+    if (mapping_ == NULL) {
+        printf("A-Mode shared ring: unable to create %s: %lu\n", mappingname.c_str(), GetLastError());
+        return -1;
+    }
+    memory_ = (char*)MapViewOfFile(mapping_, FILE_MAP_ALL_ACCESS, 0, 0, size_);
+    if (memory_ == nullptr) {
+        printf("A-Mode shared ring: unable to map %s: %lu\n", mappingname.c_str(), GetLastError());
+        CloseHandle(mapping_);
+        mapping_ = NULL;
+        return -1;
+    }
+#else
+    // a ring left over from a writer that crashed is replaced, the readers that still have it see a dead writerpid
+    std::string shmname = "/" + name_;
+    shm_unlink(shmname.c_str());
+    int fd = shm_open(shmname.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        printf("A-Mode shared ring: unable to create %s: %d\n", shmname.c_str(), errno);
+        return -1;
+    }
+    if (ftruncate(fd, (off_t)size_) != 0) {
+        printf("A-Mode shared ring: unable to resize %s: %d\n", shmname.c_str(), errno);
+        ::close(fd);
+        shm_unlink(shmname.c_str());
+        return -1;
+    }
+    void* memory = mmap(NULL, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+        printf("A-Mode shared ring: unable to map %s: %d\n", shmname.c_str(), errno);
+        shm_unlink(shmname.c_str());
+        return -1;
+    }
+    memory_ = (char*)memory;
+#endif
+
+    // everything is touched once here, so publish() doesn't take page faults
+    memset(memory_, 0, size_);
+
+    header_ = new (memory_) SharedRingHeader();
+    memcpy(header_->magic, SHAREDRING_MAGIC, sizeof(header_->magic));
+    header_->version = SHAREDRING_VERSION;
+    header_->headersize = (uint32_t)headersize;
+    header_->datamode = datamode;
+    header_->samples = samples;
+    header_->probes = probes;
+    header_->valuesize = valuesize;
+    header_->slotcount = slots;
+    header_->slotsize = slotsize;
+    header_->datasize = datasize;
+#ifdef _WIN32
+    header_->writerpid = (int64_t)GetCurrentProcessId();
+#else
+    header_->writerpid = (int64_t)getpid();
+#endif
+    header_->clockorigin = clockorigin;
+    header_->wallorigin = wallorigin;
+    for (int i = 0; i < slots; i++) new (memory_ + headersize + (size_t)slotsize * i) SharedSlotHeader();
+
+    published_ = 0;
+    header_->published.store(0);
+    header_->heartbeat.store(FrameClock::now());
+
+    // the readers check the state last, when it is open everything else is there
+    header_->state.store(SHAREDRING_STATE_OPEN, std::memory_order_release);
+    return 0;
+}
+
+
+void SharedRingWriter::publish(const FrameSlot& frame) {
+
+    if (header_ == nullptr) return;
+
+    uint64_t n = published_;
+    SharedSlotHeader* slot = (SharedSlotHeader*)(memory_ + header_->headersize + (size_t)header_->slotsize * (n % header_->slotcount));
+    uint32_t datasize = ((uint32_t)frame.datasize < header_->datasize) ? (uint32_t)frame.datasize : header_->datasize;
+
+    // odd: a reader that looks now knows the slot is changing
+    slot->sequence.store(2 * n + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot->timestamp = frame.timestamp;
+    slot->index = frame.index;
+    slot->datasize = datasize;
+    memcpy((char*)slot + SHAREDRING_ALIGNMENT, frame.data, datasize);
+
+    // even: frame n is complete
+    slot->sequence.store(2 * n + 2, std::memory_order_release);
+
+    published_ = n + 1;
+    header_->published.store(published_, std::memory_order_release);
+    header_->heartbeat.store(FrameClock::now(), std::memory_order_relaxed);
+}
+
+
+void SharedRingWriter::close() {
+
+    if (memory_ == nullptr) return;
+
+    header_->state.store(SHAREDRING_STATE_CLOSED, std::memory_order_release);
+
+#ifdef _WIN32
+    UnmapViewOfFile(memory_);
+    CloseHandle(mapping_);
+    mapping_ = NULL;
+#else
+    munmap(memory_, size_);
+    shm_unlink(("/" + name_).c_str());
+#endif
+
+    memory_ = nullptr;
+    header_ = nullptr;
+}
+
+
+bool SharedRingWriter::isOpen() {
+    return memory_ != nullptr;
+}
+
+
+uint64_t SharedRingWriter::getPublishedCount() {
+    return published_;
+}
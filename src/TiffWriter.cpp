@@ -0,0 +1,52 @@
+#include "TiffWriter.h"
+
+#include <boost/filesystem.hpp>
+
+TiffWriter::TiffWriter(int samples, int probes, int threads) : pool_(threads) {
+    samples_ = samples;
+    probes_ = probes;
+
+    workers_.resize(pool_.getThreadCount());
+    for (Worker& worker : workers_) worker.filepath.reserve(256);
+}
+
+
+void TiffWriter::setPath(std::string directory, bool usedataindex, const FrameClock& clock) {
+    directory_ = directory;
+    usedataindex_ = usedataindex;
+    clock_ = clock;
+}
+
+
+void TiffWriter::write(const std::vector<FrameRef>& batch, size_t count) {
+
+    // the frames must not go back to the pool while a thread still writes one, run() returns when all are written
+    batch_ = &batch;
+    pool_.run(count, [this](size_t i, int thread) { writeFrame(i, workers_[thread]); });
+}
+
+
+void TiffWriter::writeFrame(size_t i, Worker& worker) {
+
+    const FrameRef& frame = (*batch_)[i];
+
+    // the same name as the recorder always gave them, <timestamp>_<index>.tiff or <timestamp>.tiff,
+    // the name says which frame it is, not the order in which the files appear
+    std::string filename = std::to_string(clock_.toWallSeconds(frame->timestamp));
+    if (usedataindex_) filename += "_" + std::to_string((int16_t)frame->index);
+    worker.filepath = (boost::filesystem::path(directory_) / (filename + ".tiff")).string();
+
+    // only the header of the worker is set to the frame, one row for each probe
+    worker.image = cv::Mat(probes_, samples_, CV_16UC1, (void*)frame->data);
+    if (!cv::imwrite(worker.filepath, worker.image)) countfailed_++;
+}
+
+
+long TiffWriter::getFailCount() {
+    return countfailed_;
+}
+
+
+int TiffWriter::getThreadCount() {
+    return pool_.getThreadCount();
+}
@@ -0,0 +1,78 @@
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool(int threads) {
+
+    // the calling thread is the last one, it doesn't need a std::thread
+    if (threads < 1) threads = 1;
+    for (int t = 0; t < threads - 1; t++) threads_.emplace_back(&WorkerPool::workLoop, this, t);
+}
+
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& thread : threads_) thread.join();
+}
+
+
+void WorkerPool::run(size_t count, const std::function<void(size_t, int)>& function) {
+
+    if (count == 0) return;
+
+    {
+        // the run before can be over while a helper that woke up late still counts itself in, it finds no item
+        // but it must not find the items of this run half set
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] { return active_ == 0; });
+
+        function_ = &function;
+        count_ = count;
+        next_ = 0;
+        generation_++;
+    }
+    if (!threads_.empty()) wake_.notify_all();
+
+    takeItems((int)threads_.size());
+
+    // the last items can still be on a helper, the caller reads their results after this
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return active_ == 0; });
+}
+
+
+int WorkerPool::getThreadCount() {
+    return (int)threads_.size() + 1;
+}
+
+
+void WorkerPool::workLoop(int thread) {
+
+    uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this, seen] { return stop_ || generation_ != seen; });
+            if (stop_) return;
+            seen = generation_;
+            active_++;
+        }
+
+        takeItems(thread);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            active_--;
+        }
+        done_.notify_one();
+    }
+}
+
+
+void WorkerPool::takeItems(int thread) {
+
+    size_t i;
+    while ((i = next_.fetch_add(1)) < count_) (*function_)(i, thread);
+}
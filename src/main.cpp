@@ -1,5 +1,7 @@
 // core cpp library
 #include <iostream>
+#include <thread>
+#include <atomic>
 
 // dependencies
 #include <tclap/CmdLine.h>
@@ -92,12 +94,29 @@ int main(int argc, char** argv)
 	amodeUSConnection.useDataIndex(true);
 	amodeUSConnection.setDirectory("D:\\amodestream\\log");
 
+	// ctrl+c stops the streaming, the files are still closed properly
+	synch::installSignalHandler();
+
 	// The A-mode class supports thread, so that later in the future we can expand this code if we
 	// want to combine it with other device
 	std::thread threadAMode(std::ref(amodeUSConnection));
 
+	// the control thread waits for ctrl+c (or ESC on windows), the A-mode thread never polls for it,
+	// and stop() ends the A-mode even if the machine doesn't send anything anymore
+	std::atomic<bool> finished{ false };
+	std::thread threadControl([&amodeUSConnection, &finished] {
+		while (!finished && !synch::waitStop(0.05)) {
+#ifdef _WIN32
+			if (GetAsyncKeyState(VK_ESCAPE) & 0x8000) synch::setStop(true);
+#endif
+		}
+		amodeUSConnection.stop();
+	});
+
 	// join "all" threads
 	threadAMode.join();
+	finished = true;
+	threadControl.join();
 
 
 	return 0;
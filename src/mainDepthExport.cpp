@@ -0,0 +1,165 @@
+// core cpp library
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+
+// dependencies
+#include <tclap/CmdLine.h>
+#include <boost/filesystem.hpp>
+
+// reads the depth log, writes the text
+#include "DepthLogReader.h"
+#include "CsvFormatter.h"
+
+// function for parsing arguments
+void commandLineOptions(const int& argc, char** argv, std::string& directory, std::string& name, std::string& output, int& threads, bool& index) {
+
+	// see TCLAP (Templatized C++ Command Line Parser Manual) documentation
+	// can be found in: http://tclap.sourceforge.net/manual.html
+	try {
+		TCLAP::CmdLine cmd("Exports an A-mode depth log (.amodedepth) to a .csv, one line per frame like RECORD_CSV", ' ', "1.0");
+
+		TCLAP::ValueArg<std::string> nameargDirectory("d", "directory", "Directory of the depth log.", false, ".", "string");
+		TCLAP::ValueArg<std::string> nameargName("n", "name", "Name of the depth log, without extension.", true, "", "string");
+		TCLAP::ValueArg<std::string> nameargOutput("o", "output", "The .csv, <directory>/<name>.csv if not given.", false, "", "string");
+		TCLAP::ValueArg<int> nameargThreads("j", "threads", "Threads formatting the blocks, 0 for one per core.", false, 0, "int");
+		TCLAP::SwitchArg nameargIndex("i", "index", "Index of the machine in the second column (useDataIndex()).", false);
+
+		cmd.add(nameargDirectory);
+		cmd.add(nameargName);
+		cmd.add(nameargOutput);
+		cmd.add(nameargThreads);
+		cmd.add(nameargIndex);
+
+		cmd.parse(argc, argv);
+
+		directory = nameargDirectory.getValue();
+		name = nameargName.getValue();
+		output = nameargOutput.getValue();
+		threads = nameargThreads.getValue();
+		index = nameargIndex.getValue();
+	}
+	catch (TCLAP::ArgException& e)  // catch exceptions
+	{
+		std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
+	}
+
+}
+
+// the text of one block, same lines as the recorder writes with RECORD_CSV
+void formatBlock(DepthLogReader& reader, const DepthLogBlock& block, bool index, CsvFormatter& text) {
+
+	int columns = reader.getColumnCount();
+	for (uint32_t f = 0; f < block.framecount; f++) {
+		text.addTime(reader.toWallTime(block.timestamp[f]));
+		if (index) text.addInteger(block.index[f]);
+		for (int c = 0; c < columns; c++) text.addDouble(block.column(c)[f]);
+		text.endLine();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string directory = ".";
+	std::string name;
+	std::string output;
+	int threads = 0;
+	bool index = false;
+
+	commandLineOptions(argc, argv, directory, name, output, threads, index);
+
+	DepthLogReader reader;
+	if (reader.open(directory, name) != 0) return 1;
+
+	if (output.empty()) output = (boost::filesystem::path(directory) / (name + ".csv")).string();
+	FILE* file = fopen(output.c_str(), "wb");
+	if (file == nullptr) {
+		std::cerr << "Unable to create " << output << std::endl;
+		return 1;
+	}
+
+	if (threads <= 0) threads = (int)std::thread::hardware_concurrency();
+	if (threads <= 0) threads = 1;
+	int blockcount = reader.getBlockCount();
+
+	// every block is formatted into a slot by any thread, this thread writes the slots in the order of the blocks,
+	// a thread can only be a few blocks ahead of the writing, so the memory doesn't grow with the file
+	struct Slot
+	{
+		CsvFormatter text;                  //!< Text of the block, without a file
+		int block = -1;                     //!< Block whose text is ready in the slot
+	};
+	std::vector<std::unique_ptr<Slot>> slots;
+	for (int s = 0; s < 2 * threads; s++) slots.emplace_back(new Slot());
+
+	std::atomic<int> next{ 0 };
+	std::mutex mutex;
+	std::condition_variable changed;
+	int written = 0;
+	bool failed = false;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; t++) {
+		workers.emplace_back([&] {
+			int b;
+			while ((b = next.fetch_add(1)) < blockcount) {
+				Slot& slot = *slots[b % slots.size()];
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					changed.wait(lock, [&] { return b < written + (int)slots.size(); });
+				}
+
+				formatBlock(reader, reader.getBlock(b), index, slot.text);
+
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					slot.block = b;
+				}
+				changed.notify_all();
+			}
+		});
+	}
+
+	uint64_t bytes = 0;
+	for (int b = 0; b < blockcount; b++) {
+		Slot& slot = *slots[b % slots.size()];
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			changed.wait(lock, [&] { return slot.block == b; });
+		}
+
+		// nobody touches the slot until written moves on
+		if (!failed && fwrite(slot.text.data(), 1, slot.text.size(), file) != slot.text.size()) failed = true;
+		bytes += slot.text.size();
+		slot.text.clear();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			written++;
+		}
+		changed.notify_all();
+	}
+
+	for (std::thread& worker : workers) worker.join();
+	if (fclose(file) != 0) failed = true;
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (failed) {
+		std::cerr << "Writing " << output << " failed" << std::endl;
+		return 1;
+	}
+
+	std::cout << "A-Mode depth export: " << reader.getFrameCount() << " frames, " << reader.getProbes() << " probes x "
+		<< reader.getValues() << " values, " << blockcount << " blocks\n"
+		<< output << ": " << bytes / 1e6 << " MB in " << seconds << " s (" << bytes / 1e6 / seconds << " MB/s, "
+		<< threads << " threads)" << std::endl;
+
+	return 0;
+}
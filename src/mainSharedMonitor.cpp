@@ -0,0 +1,113 @@
+// core cpp library
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <vector>
+
+// dependencies
+#include <tclap/CmdLine.h>
+
+// reads the frames another process publishes
+#include "SharedRingReader.h"
+#include "FrameClock.h"
+
+// function for parsing arguments
+void commandLineOptions(const int& argc, char** argv, std::string& name, bool& copy) {
+
+	// see TCLAP (Templatized C++ Command Line Parser Manual) documentation
+	// can be found in: http://tclap.sourceforge.net/manual.html
+	try {
+		TCLAP::CmdLine cmd("Reads the frames of an A-mode connection from shared memory and prints rate, loss and latency", ' ', "1.0");
+
+		TCLAP::ValueArg<std::string> nameargName("s", "shared", "Name of the shared memory ring (setSharedRing())", false, "amode", "string");
+		TCLAP::SwitchArg nameargCopy("", "copy", "Copy every frame out of the ring instead of looking at it in place", false);
+
+		cmd.add(nameargName);
+		cmd.add(nameargCopy);
+
+		cmd.parse(argc, argv);
+
+		name = nameargName.getValue();
+		copy = nameargCopy.getValue();
+	}
+	catch (TCLAP::ArgException& e)  // catch exceptions
+	{
+		std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
+	}
+
+}
+
+int main(int argc, char** argv)
+{
+	std::string name = "amode";
+	bool copy = false;
+
+	commandLineOptions(argc, argv, name, copy);
+
+	// wait until the connection created the ring
+	SharedRingReader reader;
+	while (reader.open(name) != 0) std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	std::cout << "A-Mode shared monitor: " << name << ", " << reader.getProbes() << " probes x " << reader.getSamples()
+		<< " samples, " << reader.getSlotCount() << " slots" << std::endl;
+
+	std::vector<char> buffer(reader.getHeader()->datasize);
+	SharedFrame frame;
+	long countframe = 0;
+	long countinvalid = 0;
+	double latency = 0.0;
+	double maxlatency = 0.0;
+	int64_t lastprint = FrameClock::now();
+	int64_t lastframe = lastprint;
+
+	while (true) {
+		int status = reader.next(frame);
+
+		if (status == SHAREDRING_FRAME) {
+			// the timestamps are the monotonic clock of the writer, which is the same clock on this PC
+			double delay = (FrameClock::now() - frame.timestamp) * 1e-3;
+			latency += delay;
+			if (delay > maxlatency) maxlatency = delay;
+
+			// look at the values (here only the first one), then check they were not overwritten meanwhile
+			bool valid;
+			if (copy) {
+				valid = reader.copy(frame, buffer.data());
+			}
+			else {
+				volatile char first = frame.data[0];
+				(void)first;
+				valid = reader.isValid(frame);
+			}
+			if (!valid) countinvalid++;
+			countframe++;
+			lastframe = FrameClock::now();
+		}
+
+		else if (status == SHAREDRING_CLOSED) {
+			break;
+		}
+
+		// nothing new, a writer that crashed never closes the ring
+		else {
+			if (FrameClock::now() - lastframe > 1000000000LL && !reader.isWriterAlive()) {
+				std::cout << "A-Mode shared monitor: the writer is gone" << std::endl;
+				break;
+			}
+			std::this_thread::yield();
+		}
+
+		int64_t now = FrameClock::now();
+		if (now - lastprint >= 1000000000LL) {
+			printf("frames/s %.0f, lost %ld, overwritten while reading %ld, latency %.1f us (max %.1f us)\n",
+				countframe / ((now - lastprint) * 1e-9), reader.getLostCount(), countinvalid,
+				(countframe > 0) ? latency / countframe : 0.0, maxlatency);
+			countframe = 0;
+			latency = 0.0;
+			maxlatency = 0.0;
+			lastprint = now;
+		}
+	}
+
+	printf("A-Mode shared monitor: %lu frames published, %ld lost by this reader\n", (unsigned long)reader.getPublishedCount(), reader.getLostCount());
+	return 0;
+}
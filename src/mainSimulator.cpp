@@ -0,0 +1,80 @@
+// core cpp library
+#include <iostream>
+
+// dependencies
+#include <tclap/CmdLine.h>
+
+// the simulated A-mode ultrasound machine
+#include "AModeSimulator.h"
+
+// function for parsing arguments
+void commandLineOptions(const int& argc, char** argv,
+						std::string& port, int& amodemode, int& amodesamples, int& amodeprobes,
+						double& framerate, long& framecount) {
+
+	// see TCLAP (Templatized C++ Command Line Parser Manual) documentation
+	// can be found in: http://tclap.sourceforge.net/manual.html
+	try {
+		TCLAP::CmdLine cmd("Simulates the A-mode Ultrasound Machine, streams synthetic data to one client at a time", ' ', "1.0");
+
+		TCLAP::ValueArg<std::string> nameargPort("", "port", "Port where the simulator listens", false, "6340", "string");
+		TCLAP::ValueArg<int> nameargAModeMode("m", "mode", "A-Mode data mode. Specify 0 for raw, 1 for depth.", false, 0, "int");
+		TCLAP::ValueArg<int> nameargAModeSamples("n", "samples", "Number of samples of A-Mode Signal.", false, 1500, "int");
+		TCLAP::ValueArg<int> nameargAModeProbes("p", "probes", "Number of probes of A-Mode Signal.", false, 30, "int");
+		TCLAP::ValueArg<double> nameargFrameRate("r", "rate", "Frames per second, 0 means as fast as possible.", false, 0.0, "double");
+		TCLAP::ValueArg<long> nameargFrameCount("c", "count", "Frames sent to each client before closing, 0 means forever.", false, 0, "long");
+
+		cmd.add(nameargPort);
+		cmd.add(nameargAModeMode);
+		cmd.add(nameargAModeSamples);
+		cmd.add(nameargAModeProbes);
+		cmd.add(nameargFrameRate);
+		cmd.add(nameargFrameCount);
+
+		cmd.parse(argc, argv);
+
+		port = nameargPort.getValue();
+		amodemode = nameargAModeMode.getValue();
+		amodesamples = nameargAModeSamples.getValue();
+		amodeprobes = nameargAModeProbes.getValue();
+		framerate = nameargFrameRate.getValue();
+		framecount = nameargFrameCount.getValue();
+	}
+	catch (TCLAP::ArgException& e)  // catch exceptions
+	{
+		std::cerr << "error: " << e.error() << " for arg " << e.argId() << std::endl;
+	}
+
+}
+
+int main(int argc, char** argv)
+{
+	std::cout << "A-Mode Ultrasound Machine Simulator" << std::endl;
+
+	std::string port = "6340";
+	int amodemode = 0;
+	int amodesamples = 1500;
+	int amodeprobes = 30;
+	double framerate = 0.0;
+	long framecount = 0;
+
+	commandLineOptions(argc, argv, port, amodemode, amodesamples, amodeprobes, framerate, framecount);
+
+	// depth mode always uses the geometry of the machine
+	if (amodemode == DATA_DEPTH) {
+		amodesamples = 2;
+		amodeprobes = 30;
+	}
+	AModeSimulator simulator(port, amodesamples, amodeprobes, amodemode);
+	simulator.setFrameRate(framerate);
+	simulator.setFrameCount(framecount);
+
+	if (simulator.listenTCP() != 0) return -1;
+
+	// serve the clients one after another, same as the machine which accepts a new client after disconnect
+	while (true) {
+		simulator();
+	}
+
+	return 0;
+}